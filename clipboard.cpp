@@ -210,10 +210,8 @@ void Editor::picklines(int start_line, int count)
 
     // Read lines from workspace segments
     std::vector<std::string> lines;
-    auto total = wksp_->total_line_count();
-    for (int i = 0; i < count && (start_line + i) < total; ++i) {
-        std::string line = wksp_->read_line(start_line + i);
-        lines.push_back(line);
+    for (int i = 0; i < count && wksp_->has_line(start_line + i); ++i) {
+        lines.emplace_back(wksp_->read_line_view(start_line + i));
     }
 
     // Store in clipboard
@@ -235,8 +233,7 @@ void Editor::paste(int after_line, int at_col)
 
     if (clipboard_.is_rectangular()) {
         // Paste as rectangular block - insert at column position
-        auto total = wksp_->total_line_count();
-        for (size_t i = 0; i < clip_lines.size() && (after_line + (int)i) < total; ++i) {
+        for (size_t i = 0; i < clip_lines.size() && wksp_->has_line(after_line + (int)i); ++i) {
             get_line(after_line + i);
             if (at_col < (int)current_line_.size()) {
                 current_line_.insert(at_col, clip_lines[i]);
@@ -272,17 +269,16 @@ void Editor::pickspaces(int line, int col, int number, int nl)
 
     // Read lines from workspace and extract rectangular block
     std::vector<std::string> lines;
-    auto total = wksp_->total_line_count();
-    for (int i = 0; i < nl && (line + i) < total; ++i) {
-        std::string full_line = wksp_->read_line(line + i);
-        std::string block;
+    for (int i = 0; i < nl && wksp_->has_line(line + i); ++i) {
+        std::string_view full_line = wksp_->read_line_view(line + i);
+        std::string_view block;
 
         if (col < (int)full_line.size()) {
             int end_col = std::min(col + number, (int)full_line.size());
             block       = full_line.substr(col, end_col - col);
         }
 
-        lines.push_back(block);
+        lines.emplace_back(block);
     }
 
     // Store rectangular block in clipboard
@@ -299,9 +295,8 @@ void Editor::closespaces(int line, int col, int number, int nl)
 
     // Now delete the rectangular area using get_line/put_line pattern
     put_line();
-    auto total = wksp_->total_line_count();
     for (int i = 0; i < nl; ++i) {
-        if (line + i < total) {
+        if (wksp_->has_line(line + i)) {
             get_line(line + i);
             if (col < (int)current_line_.size()) {
                 int end_pos = std::min(col + number, (int)current_line_.size());
@@ -321,9 +316,8 @@ void Editor::openspaces(int line, int col, int number, int nl)
 {
     // Insert spaces in rectangular area using get_line/put_line pattern
     put_line();
-    auto total = wksp_->total_line_count();
     for (int i = 0; i < nl; ++i) {
-        if (line + i < total) {
+        if (wksp_->has_line(line + i)) {
             get_line(line + i);
             if (col <= (int)current_line_.size()) {
                 current_line_.insert(col, number, ' ');
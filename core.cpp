@@ -56,6 +56,9 @@ void Editor::startup(int restart)
     noecho();
     keypad(stdscr, true);
 
+    // Scrolling of the view is done by the terminal
+    idlok(stdscr, true);
+
     // Initialize colors if available
     if (has_colors()) {
         ::start_color();
@@ -130,23 +133,46 @@ int Editor::run(int restart, int argc, char **argv)
         int ch = journal_read_key();
         if (ch == ERR) {
             // no input, still render
+            tempfile_.flush_if_expired();
+            compact_tempfile();
+            wksp_->poll_index();
+            poll_saves();
+            if (cmd_mode_) {
+                // Search for the text typed ahead
+                incremental_search();
+            }
             draw();
         } else {
             if (inputfile_ == 0 && journal_fd_ >= 0) {
                 // Record keystroke to journal in normal mode
                 journal_write_key(ch);
             }
+            // Changes made by one key are undone together
+            wksp_->undo_checkpoint();
+
             // Route key to appropriate handler based on mode.
             if (cmd_mode_) {
                 handle_key_cmd(ch);
             } else {
                 handle_key_edit(ch);
             }
+
+            // Commit edited line once the cursor leaves it
+            if (current_line_modified_ && current_line_no_ != wksp_->view.topline + cursor_line_) {
+                put_line();
+            }
             draw();
+
+            // Text of /search is shown first, then searched
+            if (cmd_mode_) {
+                incremental_search();
+                draw();
+            }
         }
         if (quit_flag_)
             break;
     }
+    finish_saves();
 
     // Pause for a little bit to make the last status visible.
     refresh();
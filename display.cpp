@@ -2,6 +2,18 @@
 
 #include "editor.h"
 
+//
+// Format number with thousands separators, like 1,234,000.
+//
+static std::string group_digits(long value)
+{
+    std::string digits = std::to_string(value);
+    for (int pos = (int)digits.size() - 3; pos > 0; pos -= 3) {
+        digits.insert(pos, ",");
+    }
+    return digits;
+}
+
 //
 // Start status line color highlighting.
 //
@@ -40,111 +52,270 @@ void Editor::draw_status(const std::string &msg)
 }
 
 //
-// Display position of cursor.
+// Find where to show position tag in command mode.
+// Returns false when the tag is not visible.
 //
-void Editor::draw_tag()
+bool Editor::tag_position(int &row, int &col)
 {
-    if (area_selection_mode_) {
-        int r, c;
-        params_.get_opposite_corner(cursor_line_ + wksp_->view.topline,
-                                    cursor_col_ + wksp_->view.basecol, r, c);
-        r -= wksp_->view.topline;
-        c -= wksp_->view.basecol;
-        if (r >= 0 && c >= 0 && r < nlines_ - 1 && c < ncols_) {
-            // The opposite corner is visible.
-            start_color(Color::POSITION);
-            mvaddch(r, c, '@');
-            end_color(Color::POSITION);
-        }
-    } else {
-        start_color(Color::POSITION);
-        mvaddch(cursor_line_, cursor_col_, '@');
-        end_color(Color::POSITION);
+    if (!area_selection_mode_) {
+        row = cursor_line_;
+        col = cursor_col_;
+        return true;
     }
+
+    params_.get_opposite_corner(cursor_line_ + wksp_->view.topline,
+                                cursor_col_ + wksp_->view.basecol, row, col);
+    row -= wksp_->view.topline;
+    col -= wksp_->view.basecol;
+
+    // The opposite corner may be off screen.
+    return row >= 0 && col >= 0 && row < nlines_ - 1 && col < ncols_;
 }
 
 //
-// Redraw entire screen and status bar.
+// Display position of cursor.
+//
+void Editor::draw_tag(int row, int col)
+{
+    start_color(Color::POSITION);
+    mvaddch(row, col, '@');
+    end_color(Color::POSITION);
+}
+
+//
+// Update the screen and status bar.
+// Only rows which changed since the previous call are repainted,
+// and when nothing changed, the terminal is not touched at all.
 //
 void Editor::draw()
 {
-    wksp_redraw();
+    // Tag is erased by repainting its row
+    int tag_row = -1, tag_col = -1;
+    if (cmd_mode_ && !tag_position(tag_row, tag_col)) {
+        tag_row = -1;
+    }
+    int stale_row = (tag_row != drawn_tag_row_ || tag_col != drawn_tag_col_) ? drawn_tag_row_ : -1;
+
+    // Status line is lost when the screen is cleared or resized
+    bool resized = !screen_valid_ || drawn_nlines_ != nlines_ || drawn_ncols_ != ncols_;
+    bool changed = wksp_redraw(stale_row);
 
     // Build status line dynamically
+    std::string s;
     if (cmd_mode_) {
         if (area_selection_mode_) {
-            draw_status(status_);
+            s = status_;
         } else {
-            std::string s = std::string("Cmd: ") + cmd_;
-            draw_status(s);
+            s = std::string("Cmd: ") + cmd_;
         }
-        draw_tag();
     } else if (!status_.empty()) {
         // Draw status once.
-        draw_status(status_);
+        s       = status_;
         status_ = "";
     } else {
         std::string mode_str = insert_mode_ ? "INSERT" : "OVERWRITE";
-        std::string s        = std::string("Line=") +
-                        std::to_string(wksp_->view.topline + cursor_line_ + 1) +
-                        "    Col=" + std::to_string(wksp_->view.basecol + cursor_col_ + 1) +
-                        "    " + mode_str + "    \"" + filename_ + "\"";
+        s = std::string("Line=") + std::to_string(wksp_->view.topline + cursor_line_ + 1) +
+            "    Col=" + std::to_string(wksp_->view.basecol + cursor_col_ + 1) + "    " +
+            mode_str + "    \"" + filename_ + "\"";
+        long rank, total;
+        if (!last_search_.empty() && !current_line_modified_ &&
+            wksp_->match_rank(wksp_->view.topline + cursor_line_,
+                              wksp_->view.basecol + cursor_col_, rank, total)) {
+            // Cursor is at a match of the last search
+            s += "    match " + group_digits(rank) + " of " + group_digits(total);
+        }
+        if (wksp_->is_indexing()) {
+            // Line count is growing while file is indexed in background
+            s += "    >=" + group_digits(wksp_->total_line_count()) + " lines";
+        }
+        if (wksp_->is_saving() && wksp_->save_size() > 0) {
+            // Percent of file written by background save
+            s += "    Saving " +
+                 std::to_string((int)(100.0 * wksp_->save_progress() / wksp_->save_size())) + "%";
+        }
+    }
+    if (resized || s != drawn_status_) {
         draw_status(s);
+        drawn_status_ = s;
+        changed       = true;
+    }
+    if (tag_row >= 0 && (changed || stale_row >= 0 || tag_row != drawn_tag_row_)) {
+        draw_tag(tag_row, tag_col);
+        changed = true;
     }
+    drawn_tag_row_ = tag_row;
+    drawn_tag_col_ = tag_col;
 
     // Position cursor at current line and column before reading input
+    int row = cursor_line_, col = cursor_col_;
     if (cmd_mode_ && !area_selection_mode_) {
-        move(nlines_ - 1, 5 + cmd_.size());
-    } else {
-        move(cursor_line_, cursor_col_);
+        row = nlines_ - 1;
+        col = 5 + cmd_.size();
+    }
+    if (changed || row != drawn_cursor_row_ || col != drawn_cursor_col_) {
+        move(row, col);
+        refresh();
+        drawn_cursor_row_ = row;
+        drawn_cursor_col_ = col;
     }
-    refresh();
 }
 
 //
-// Refresh visible lines in the workspace.
+// Repaint the whole screen on next draw(), clearing the terminal.
+//
+void Editor::redraw_screen()
+{
+    screen_valid_ = false;
+    clearok(curscr, true);
+}
+
+//
+// Refresh visible lines in the workspace which changed since the previous call:
+// lines modified in workspace, the line being edited, and rows given by stale_row.
+// Scrolling moves rows which are still visible, instead of repainting them.
+// Returns true when anything was repainted.
 //
-void Editor::wksp_redraw()
+bool Editor::wksp_redraw(int stale_row)
 {
-    auto total = wksp_->total_line_count();
-    for (int r = 0; r < nlines_ - 1; ++r) {
-        mvhline(r, 0, ' ', ncols_);
-        std::string line_text;
-        if (r + wksp_->view.topline < total) {
-            line_text = wksp_->read_line(r + wksp_->view.topline);
-            // horizontal offset and continuation markers
-            bool clipped   = false;
-            bool truncated = false;
-            if (wksp_->view.basecol > 0 && (int)line_text.size() > wksp_->view.basecol) {
-                line_text.erase(0, (size_t)wksp_->view.basecol);
-                clipped = true;
-            } else if (wksp_->view.basecol > 0 && (int)line_text.size() <= wksp_->view.basecol) {
-                // Beyond line content - show blank spaces (virtual column position)
-                line_text.clear();
-                clipped = true;
-            }
-            if ((int)line_text.size() > ncols_ - 1) {
-                truncated = true;
-                line_text.resize((size_t)(ncols_ - 1));
-            }
-            mvaddnstr(r, 0, line_text.c_str(), ncols_ - 1);
-            if (truncated) {
-                start_color(Color::TRUNCATION);
-                mvaddch(r, ncols_ - 2, '~');
-                end_color(Color::TRUNCATION);
-            }
-            if (clipped) {
-                start_color(Color::TRUNCATION);
-                mvaddch(r, 0, '<');
-                end_color(Color::TRUNCATION);
-            }
+    const int rows = nlines_ - 1;
+    const int top  = wksp_->view.topline;
+
+    // Whole screen is repainted after resize, horizontal scroll or switch of workspace
+    long damage_first, damage_last;
+    bool damaged = wksp_->take_damage(damage_first, damage_last);
+    bool full    = !screen_valid_ || drawn_wksp_ != wksp_.get() || drawn_nlines_ != nlines_ ||
+                drawn_ncols_ != ncols_ || drawn_basecol_ != wksp_->view.basecol;
+
+    // File descriptors of another workspace or of a closed file mean other lines
+    if (drawn_wksp_ != wksp_.get() || drawn_generation_ != wksp_->generation()) {
+        line_cache_.clear();
+    }
+
+    // Rows [fresh_first, fresh_last) came into view by scrolling
+    int fresh_first = 0, fresh_last = 0;
+    int shift = top - drawn_topline_;
+    if (full || shift >= rows || shift <= -rows) {
+        full = true;
+    } else if (shift != 0) {
+        setscrreg(0, rows - 1);
+        scrollok(stdscr, true);
+        scrl(shift);
+        scrollok(stdscr, false);
+        setscrreg(0, nlines_ - 1);
+
+        fresh_first = (shift > 0) ? rows - shift : 0;
+        fresh_last  = (shift > 0) ? rows : -shift;
+        drawn_edit_row_ -= shift;
+        if (stale_row >= 0)
+            stale_row -= shift;
+    }
+
+    bool changed = full || shift != 0;
+    int edit_row = -1;
+    for (int r = 0; r < rows; ++r) {
+        int lno     = r + top;
+        bool edited = (lno == current_line_no_ && current_line_modified_);
+        bool dirty  = full || (r >= fresh_first && r < fresh_last) || r == stale_row ||
+                     (damaged && lno >= damage_first && lno < damage_last);
+        if (edited) {
+            // Line buffer is compared with what was shown
+            edit_row = r;
+            dirty    = dirty || r != drawn_edit_row_ || current_line_ != drawn_edit_line_;
         } else {
-            // Beyond end of file - show virtual line marker
-            start_color(Color::EMPTY);
-            mvaddch(r, 0, '~');
-            end_color(Color::EMPTY);
+            dirty = dirty || r == drawn_edit_row_;
+        }
+        if (dirty) {
+            draw_row(r, edited);
+            changed = true;
         }
     }
+
+    // Keep one screen above and below
+    line_cache_.trim(top - rows, top + 2 * rows, 3 * rows);
+
+    drawn_edit_row_ = edit_row;
+    if (edit_row >= 0) {
+        drawn_edit_line_ = current_line_;
+    }
+    drawn_wksp_       = wksp_.get();
+    drawn_generation_ = wksp_->generation();
+    drawn_nlines_     = nlines_;
+    drawn_ncols_      = ncols_;
+    drawn_topline_    = top;
+    drawn_basecol_    = wksp_->view.basecol;
+    screen_valid_     = true;
+    return changed;
+}
+
+//
+// Paint one row of the workspace.
+// Line being edited is shown from the line buffer, possibly beyond end of file.
+// Lines not indexed yet are not waited for: the row is painted again later.
+//
+void Editor::draw_row(int r, bool edited)
+{
+    int lno = r + wksp_->view.topline;
+
+    mvhline(r, 0, ' ', ncols_);
+    if (!edited && !wksp_->is_indexed(lno)) {
+        // Not indexed yet - repainted when background indexing gets there
+        start_color(Color::EMPTY);
+        mvaddstr(r, 0, "...");
+        end_color(Color::EMPTY);
+    } else if (edited || wksp_->has_line(lno)) {
+        std::string_view line_text = edited ? current_line_ : visible_line(lno);
+        // horizontal offset and continuation markers
+        bool clipped   = false;
+        bool truncated = false;
+        if (wksp_->view.basecol > 0 && (int)line_text.size() > wksp_->view.basecol) {
+            line_text.remove_prefix((size_t)wksp_->view.basecol);
+            clipped = true;
+        } else if (wksp_->view.basecol > 0 && (int)line_text.size() <= wksp_->view.basecol) {
+            // Beyond line content - show blank spaces (virtual column position)
+            line_text = {};
+            clipped   = true;
+        }
+        if ((int)line_text.size() > ncols_ - 1) {
+            truncated = true;
+            line_text = line_text.substr(0, (size_t)(ncols_ - 1));
+        }
+        if (!line_text.empty()) {
+            mvaddnstr(r, 0, line_text.data(), (int)line_text.size());
+        }
+        if (truncated) {
+            start_color(Color::TRUNCATION);
+            mvaddch(r, ncols_ - 2, '~');
+            end_color(Color::TRUNCATION);
+        }
+        if (clipped) {
+            start_color(Color::TRUNCATION);
+            mvaddch(r, 0, '<');
+            end_color(Color::TRUNCATION);
+        }
+    } else {
+        // Beyond end of file - show virtual line marker
+        start_color(Color::EMPTY);
+        mvaddch(r, 0, '~');
+        end_color(Color::EMPTY);
+    }
+}
+
+//
+// Get text of line to show, from the line cache when possible.
+// Lines are cached by location of their bytes, which is found without reading them.
+//
+std::string_view Editor::visible_line(int lno)
+{
+    int fd;
+    long offset;
+    if (!wksp_->locate_line(lno, fd, offset)) {
+        // Blank line
+        return wksp_->read_line_view(lno);
+    }
+    if (const std::string *text = line_cache_.find(fd, offset, lno)) {
+        return *text;
+    }
+    return line_cache_.insert(fd, offset, lno, wksp_->read_line_view(lno));
 }
 
 //
@@ -1,15 +1,19 @@
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "clipboard.h"
+#include "line_cache.h"
 #include "macro.h"
 #include "parameters.h"
 #include "segment.h"
 #include "tempfile.h"
+#include "text_search.h"
 #include "workspace.h"
 
 class Editor {
@@ -28,6 +32,24 @@ private:
     int cursor_col_{};
     int cursor_line_{};
     std::string status_;
+
+    // Screen as it was last drawn, to repaint only what changed
+    bool screen_valid_{ false };             // screen matches the fields below
+    const Workspace *drawn_wksp_{ nullptr }; // workspace shown
+    int drawn_nlines_{ 0 };                  // screen height
+    int drawn_ncols_{ 0 };                   // screen width
+    int drawn_topline_{ 0 };                 // first line shown
+    int drawn_basecol_{ 0 };                 // first column shown
+    int drawn_edit_row_{ -1 };               // row of line buffer, or -1
+    std::string drawn_edit_line_;            // contents of line buffer shown
+    int drawn_tag_row_{ -1 };                // row of position tag, or -1
+    int drawn_tag_col_{ -1 };                // column of position tag
+    int drawn_cursor_row_{ -1 };             // cursor row
+    int drawn_cursor_col_{ -1 };             // cursor column
+    std::string drawn_status_;               // status line shown
+    unsigned drawn_generation_{ 0 };         // generation of workspace shown
+    LineCache line_cache_;                   // text of rows shown, and around them
+
     std::string filename_{ "untitled" };
     bool cmd_mode_{ false };
     bool quit_flag_{ false };
@@ -45,13 +67,32 @@ private:
     Parameters params_;
     std::string last_search_; // last search needle
     bool last_search_forward_{ true };
+    bool regex_search_{ false };                    // needle is a regular expression (^X r)
+    std::unique_ptr<SearchPattern> search_pattern_; // compiled needle, reused by n
+    std::string search_pattern_text_;               // needle of search_pattern_
+    bool search_pattern_regex_{ false };            // search_pattern_ is a regular expression
+
+    // Incremental search, while /text or ?text is typed
+    struct IsearchStep {
+        std::string needle; // text searched
+        bool found;         // position of the match is valid
+        int line;
+        int col;
+    };
+    bool isearch_active_{ false };           // view was moved by incremental search
+    int isearch_topline_{ 0 };               // view where the search started
+    int isearch_basecol_{ 0 };
+    int isearch_cursor_line_{ 0 };
+    int isearch_cursor_col_{ 0 };
+    std::vector<IsearchStep> isearch_steps_; // searches done for prefixes of the text
+
     std::vector<std::string> clipboard_lines_; // simple line clipboard (F5/F6)
     bool quote_next_{ false };                 // ^P - quote next character literally
     bool ctrlx_state_{ false };                // ^X prefix state
     bool insert_mode_{ true };                 // insert vs overwrite mode
 
     // Signal handling
-    bool interrupt_flag_{ false }; // interrupt signal occurred
+    std::atomic<bool> interrupt_flag_{ false }; // interrupt signal occurred, checked by search
 
     // Temporary file management (shared by all workspaces)
     Tempfile tempfile_;
@@ -60,6 +101,7 @@ private:
     std::unique_ptr<Workspace> wksp_;
     std::unique_ptr<Workspace> alt_wksp_;
     std::string alt_filename_;
+    const Workspace *save_as_wksp_{ nullptr }; // renamed when its save succeeds
 
     // Enhanced clipboard (supports line ranges)
     Clipboard clipboard_;
@@ -87,8 +129,12 @@ private:
     void startup(int restart);
     void draw();
     void draw_status(const std::string &msg);
-    void draw_tag();
-    void wksp_redraw();
+    bool tag_position(int &row, int &col);
+    void draw_tag(int row, int col);
+    bool wksp_redraw(int stale_row = -1);
+    void draw_row(int row, bool edited);
+    std::string_view visible_line(int lno);
+    void redraw_screen();
 
     // Colors
     enum class Color {
@@ -107,6 +153,12 @@ private:
     void open_initial(int argc, char **argv);
     void save_file();
     void save_as(const std::string &filename);
+
+    // Report background saves which have completed, or wait for all of them
+    void poll_saves();
+    void finish_saves();
+    void report_save(Workspace *wksp, bool ok);
+    bool is_saving() const;
     void handle_key_cmd(int ch);
     void handle_key_edit(int ch);
     void move_left();
@@ -123,6 +175,10 @@ private:
     void get_line(int lno); // load line from workspace into current_line buffer
     void put_line();        // write current_line back to workspace if modified
 
+    // Reclaim space of temp file, one step per idle tick
+    void compact_tempfile();
+    void collect_temp_segments(std::vector<Segment *> &segments);
+
     // Session state
     void save_state();
     void load_state_if_requested(int restart, int argc, char **argv);
@@ -131,10 +187,18 @@ private:
     int current_line_length() const;
     size_t get_actual_col() const; // Get actual column position in line (basecol + cursor_col)
     void goto_line(int line_number);
+    void goto_offset(long offset);
     bool search_forward(const std::string &needle);
     bool search_next();
     bool search_backward(const std::string &needle);
+    const SearchPattern *compile_search(const std::string &needle, bool index = true);
+    bool show_match(bool found, int line, int col, const std::string &needle);
     bool search_prev();
+    bool search_again(bool forward);
+    void substitute(const std::string &old_text, const std::string &new_text, bool global);
+    void incremental_search();
+    void finish_incremental_search(bool accept);
+    void show_isearch_step(const IsearchStep &step);
     int total_lines() const;
 
     // External filter execution
@@ -186,6 +250,7 @@ private:
     // Journaling
     void journal_write_key(int ch);
     int journal_read_key();
+    bool input_pending(); // more keys were typed ahead
 
     // Clipboard operations
     void picklines(int start_line, int count);
@@ -200,6 +265,7 @@ private:
     void edit_enter();              // Handle enter/newline operation
     void edit_tab();                // Handle tab insertion
     void edit_insert_char(char ch); // Handle character insertion/overwrite
+    void edit_undo(bool redo);      // Handle undo or redo of the last change
 };
 
 #endif
@@ -9,18 +9,20 @@
 
 //
 // Load line from workspace into current line buffer.
+// Edits are kept in the buffer until another line is loaded,
+// or put_line() is called explicitly.
 //
 void Editor::get_line(int lno)
 {
-    if (current_line_no_ == lno) {
-        // We already have this line.
+    if (current_line_no_ == lno && current_line_modified_) {
+        // We already have this line, with uncommitted edits.
         return;
     }
 
     // Save any unsaved modifications
     put_line();
 
-    current_line_          = wksp_->read_line(lno);
+    current_line_          = wksp_->read_line_view(lno); // reuses capacity of the buffer
     current_line_no_       = lno;
     current_line_modified_ = false;
 }
@@ -36,6 +38,60 @@ void Editor::put_line()
     current_line_modified_ = false;
 }
 
+//
+// Collect segments which reference data in temp file, from both workspaces,
+// including those kept by undo and redo history.
+//
+void Editor::collect_temp_segments(std::vector<Segment *> &segments)
+{
+    wksp_->find_segments(tempfile_.fd(), segments);
+    if (alt_wksp_) {
+        alt_wksp_->find_segments(tempfile_.fd(), segments);
+    }
+}
+
+//
+// Reclaim space of temp file taken by deleted and replaced lines.
+// Runs incrementally: each call copies a limited amount of live data,
+// so that input is not stalled. Clipboard keeps text in memory, so
+// the temp file is referred to by segments of the workspaces and of
+// their undo and redo history, which all must be collected and moved.
+//
+void Editor::compact_tempfile()
+{
+    std::vector<Segment *> segments;
+
+    if (is_saving()) {
+        // Background save reads the temp file by offsets
+        return;
+    }
+
+    if (!tempfile_.is_compacting()) {
+        if (!tempfile_.compaction_check_due()) {
+            return;
+        }
+        collect_temp_segments(segments);
+        std::vector<Tempfile::Extent> live;
+        for (const Segment *seg : segments) {
+            live.push_back({ seg->file_offset, seg->total_byte_count() });
+        }
+        tempfile_.begin_compaction(std::move(live));
+        return;
+    }
+
+    if (tempfile_.compaction_step(4 * 1024 * 1024)) {
+        collect_temp_segments(segments);
+        tempfile_.finish_compaction(segments);
+
+        // Lines of temp file have moved to other offsets
+        line_cache_.clear();
+        for (Workspace *wksp : { wksp_.get(), alt_wksp_.get() }) {
+            if (wksp)
+                wksp->forget_temp_matches();
+        }
+    }
+}
+
 //
 // Open initial file from command line arguments.
 //
@@ -61,6 +117,8 @@ void Editor::open_initial(int argc, char **argv)
 //
 bool Editor::load_file_segments(const std::string &path)
 {
+    put_line(); // Commit pending edit to the old contents
+
     // Open file for reading
     int fd = open(path.c_str(), O_RDONLY);
     if (fd < 0) {
@@ -68,8 +126,8 @@ bool Editor::load_file_segments(const std::string &path)
         return false;
     }
 
-    // Use workspace's load_file_to_segments to properly set up segments.
-    wksp_->load_file(fd);
+    // Index large file in background, to show the first screen early
+    wksp_->load_file_in_background(fd);
 
     // Note: we keep the fd open because segments reference it via file_descriptor
     return true;
@@ -81,6 +139,10 @@ bool Editor::load_file_segments(const std::string &path)
 void Editor::save_file()
 {
     put_line(); // Save any unsaved line modifications
+    if (wksp_->is_saving()) {
+        // Previous save as may rename the file
+        report_save(wksp_.get(), wksp_->wait_save());
+    }
 
     // Create backup file if not already done and file exists
     if (!wksp_->file_state.backup_done && filename_ != "untitled") {
@@ -102,14 +164,10 @@ void Editor::save_file()
         unlink(filename_.c_str());
     }
 
-    // Use workspace's write_file
-    bool saved = wksp_->write_file(filename_);
-    if (saved) {
-        status_                    = std::string("Saved: ") + filename_;
-        wksp_->file_state.modified = false; // Clear modified flag after save
-    } else {
-        status_ = std::string("Cannot write: ") + filename_;
-    }
+    // Write in background; editing continues meanwhile
+    wksp_->start_save(filename_);
+    wksp_->file_state.modified = false; // Later edits set it again
+    status_                    = std::string("Saving: ") + filename_;
 }
 
 //
@@ -118,16 +176,75 @@ void Editor::save_file()
 void Editor::save_as(const std::string &new_filename)
 {
     put_line(); // Save any unsaved line modifications
+    if (wksp_->is_saving()) {
+        report_save(wksp_.get(), wksp_->wait_save());
+    }
 
     // Unlink the original file to ensure backup is not affected by the write
     unlink(new_filename.c_str());
 
-    // Use workspace's write_file
-    if (wksp_->write_file(new_filename)) {
-        // Update filename
-        filename_ = new_filename;
-        status_   = std::string("Saved as: ") + new_filename;
+    // Write in background; editing continues meanwhile.
+    // File is renamed when the save succeeds.
+    wksp_->start_save(new_filename);
+    save_as_wksp_ = wksp_.get();
+    status_       = std::string("Saving as: ") + new_filename;
+}
+
+//
+// Report background save of workspace which has completed.
+// On success a save as renames the file; on failure the workspace
+// is marked modified again.
+//
+void Editor::report_save(Workspace *wksp, bool ok)
+{
+    bool renamed = (wksp == save_as_wksp_);
+    if (renamed)
+        save_as_wksp_ = nullptr;
+
+    if (ok) {
+        status_ = std::string("Saved: ") + wksp->save_path();
+        if (renamed) {
+            (wksp == wksp_.get() ? filename_ : alt_filename_) = wksp->save_path();
+        }
     } else {
-        status_ = std::string("Cannot write: ") + new_filename;
+        status_                   = std::string("Cannot write: ") + wksp->save_path();
+        wksp->file_state.modified = true;
+    }
+}
+
+//
+// Report background saves which have completed.
+//
+void Editor::poll_saves()
+{
+    for (Workspace *wksp : { wksp_.get(), alt_wksp_.get() }) {
+        bool ok;
+        if (wksp && wksp->poll_save(ok)) {
+            report_save(wksp, ok);
+        }
     }
 }
+
+//
+// Wait for background saves to complete, before exit.
+//
+void Editor::finish_saves()
+{
+    if (is_saving()) {
+        status_ = "Waiting for save to complete...";
+        draw();
+    }
+    for (Workspace *wksp : { wksp_.get(), alt_wksp_.get() }) {
+        if (wksp && wksp->is_saving()) {
+            report_save(wksp, wksp->wait_save());
+        }
+    }
+}
+
+//
+// Check whether any workspace is being saved in background.
+//
+bool Editor::is_saving() const
+{
+    return (wksp_ && wksp_->is_saving()) || (alt_wksp_ && alt_wksp_->is_saving());
+}
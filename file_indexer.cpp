@@ -0,0 +1,225 @@
+#include "file_indexer.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "io_backend.h"
+#include "newline_scanner.h"
+
+namespace {
+
+const size_t BLOCK_SIZE = 1024 * 1024; // bytes per read
+
+//
+// Collects line lengths into segments of limited size.
+//
+class SegmentBuilder {
+public:
+    SegmentBuilder(int fd, std::list<Segment> &segments) : fd_(fd), segments_(segments) {}
+
+    // Append line which starts at given offset, with length including newline.
+    void add_line(long offset, long len)
+    {
+        if (!lengths_.empty() &&
+            offset / FileIndexer::STRIPE_SIZE != seg_offset_ / FileIndexer::STRIPE_SIZE) {
+            // Line starts in next stripe
+            finish();
+        }
+        if (lengths_.empty()) {
+            seg_offset_ = offset;
+        }
+        lengths_.push_back(len);
+
+        if (lengths_.size() >= Segment::MAX_LINES || lengths_.total() >= Segment::MAX_BYTES) {
+            finish();
+        }
+    }
+
+    // Create segment from collected lines.
+    void finish()
+    {
+        if (lengths_.empty())
+            return;
+
+        unsigned line_count = lengths_.size();
+        lengths_.shrink_to_fit();
+        segments_.emplace_back(fd_, line_count, seg_offset_, std::move(lengths_));
+    }
+
+private:
+    int fd_;
+    std::list<Segment> &segments_;
+    LineLengths lengths_;  // lines of segment being built
+    long seg_offset_{ 0 }; // file offset of segment being built
+};
+
+} // namespace
+
+//
+// Index the whole file, appending segments to the list.
+//
+void FileIndexer::index(std::list<Segment> &segments) const
+{
+    struct stat st;
+    unsigned threads = threads_ ? threads_ : std::thread::hardware_concurrency();
+
+    if (fstat(fd_, &st) < 0 || !S_ISREG(st.st_mode)) {
+        index_sequential(segments);
+    } else if (threads > 1 && st.st_size > STRIPE_SIZE) {
+        index_parallel(st.st_size, segments);
+    } else {
+        index_range(0, LONG_MAX, segments);
+    }
+}
+
+//
+// Index the whole file by read(), in large blocks.
+// Line which spans blocks is accumulated across reads. Incomplete last line
+// is treated as complete, with trailing newline added.
+//
+void FileIndexer::index_sequential(std::list<Segment> &segments) const
+{
+    NewlineScanner scanner;
+    SegmentBuilder builder(fd_, segments);
+    std::vector<char> buf(BLOCK_SIZE);
+    std::vector<unsigned> newlines;
+    long offset     = 0; // file offset of the block
+    long line_start = 0; // file offset of current line
+
+    for (;;) {
+        ssize_t nread = read(fd_, buf.data(), buf.size());
+        if (nread <= 0) {
+            // EOF - treat incomplete line as complete
+            if (offset > line_start) {
+                builder.add_line(line_start, offset - line_start + 1);
+            }
+            break;
+        }
+
+        // Find all newlines in the block
+        newlines.clear();
+        scanner.scan(buf.data(), nread, newlines);
+        for (unsigned pos : newlines) {
+            long line_end = offset + pos + 1;
+            builder.add_line(line_start, line_end - line_start);
+            line_start = line_end;
+        }
+        offset += nread;
+    }
+    builder.finish();
+}
+
+//
+// Index regular file of given size by stripes on worker threads.
+//
+void FileIndexer::index_parallel(long file_size, std::list<Segment> &segments) const
+{
+    index_stripes(0, file_size,
+                  [&segments](std::list<Segment> &part) { segments.splice(segments.end(), part); });
+}
+
+//
+// Index lines of regular file which start at or after given offset.
+// Workers take ranges in order. Whoever completes the next range due
+// passes it to consumer, together with the following completed ranges.
+//
+void FileIndexer::index_stripes(long start, long file_size, const Consumer &consumer,
+                                const std::atomic<bool> *cancel) const
+{
+    // First range ends at stripe boundary, the rest are whole stripes
+    std::vector<long> bounds{ start };
+    for (long pos = (start / STRIPE_SIZE + 1) * STRIPE_SIZE; pos < file_size; pos += STRIPE_SIZE) {
+        bounds.push_back(pos);
+    }
+    bounds.push_back(std::max(start + 1, file_size));
+
+    size_t nranges   = bounds.size() - 1;
+    unsigned threads = threads_ ? threads_ : std::thread::hardware_concurrency();
+    threads          = std::max(1u, std::min<unsigned>(threads, nranges));
+
+    std::vector<std::list<Segment>> parts(nranges);
+    std::vector<bool> done(nranges);
+    std::atomic<size_t> next_range{ 0 };
+    size_t next_consumed = 0;
+    std::mutex mutex;
+
+    auto worker = [&]() {
+        for (size_t i = next_range++; i < nranges; i = next_range++) {
+            if (cancel && *cancel)
+                return;
+            index_range(bounds[i], bounds[i + 1], parts[i]);
+
+            // Pass completed ranges in order
+            std::lock_guard<std::mutex> lock(mutex);
+            done[i] = true;
+            while (next_consumed < nranges && done[next_consumed]) {
+                consumer(parts[next_consumed++]);
+            }
+        }
+    };
+
+    // Current thread works as well
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+//
+// Index lines which start in byte range [start, end) of regular file.
+// Reads by current I/O backend, which uses positioned reads,
+// so that several ranges can be indexed at once.
+//
+void FileIndexer::index_range(long start, long end, std::list<Segment> &segments) const
+{
+    NewlineScanner scanner;
+    SegmentBuilder builder(fd_, segments);
+    std::vector<unsigned> newlines;
+    long offset     = start; // file offset of the block
+    long line_start = start; // file offset of current line, or -1 when not found yet
+
+    if (start > 0) {
+        // Range starts in the middle of a line, unless preceded by newline
+        char prev;
+        if (pread(fd_, &prev, 1, start - 1) != 1)
+            return;
+        if (prev != '\n')
+            line_start = -1;
+    }
+
+    IoBackend::get().read(fd_, start, -1, [&](const char *data, size_t nread) {
+        // Find all newlines in the block
+        newlines.clear();
+        scanner.scan(data, nread, newlines);
+        for (unsigned pos : newlines) {
+            long line_end = offset + pos + 1;
+            if (line_start >= 0) {
+                builder.add_line(line_start, line_end - line_start);
+            }
+            line_start = line_end;
+            if (line_start >= end)
+                break;
+        }
+        offset += nread;
+
+        // Stop when the last line is complete, or no line starts in this range
+        return line_start >= 0 ? line_start < end : offset < end;
+    });
+
+    if (line_start >= 0 && line_start < end && offset > line_start) {
+        // EOF - treat incomplete line as complete
+        builder.add_line(line_start, offset - line_start + 1);
+    }
+    builder.finish();
+}
@@ -0,0 +1,60 @@
+#ifndef FILE_INDEXER_H
+#define FILE_INDEXER_H
+
+#include <atomic>
+#include <functional>
+#include <list>
+
+#include "segment.h"
+
+//
+// FileIndexer class - builds segments for unmodified text of a file.
+//
+// Segments are limited by Segment::MAX_LINES and Segment::MAX_BYTES,
+// and never cross a stripe boundary: the first line which starts in a new
+// stripe begins a new segment. Thus stripes of a regular file can be indexed
+// independently on worker threads, giving exactly the same segments
+// as one sequential pass.
+//
+class FileIndexer {
+public:
+    static constexpr long STRIPE_SIZE = 16 * 1024 * 1024;
+
+    // Receives segments of consecutive ranges, in file order.
+    using Consumer = std::function<void(std::list<Segment> &segments)>;
+
+    // File descriptor is not owned.
+    explicit FileIndexer(int fd) : fd_(fd) {}
+
+    // Set number of worker threads; 0 means one per processor core.
+    void set_threads(unsigned threads) { threads_ = threads; }
+
+    // Index the whole file, appending segments to the list.
+    // Regular files are read by current I/O backend, and those larger
+    // than one stripe are indexed in parallel.
+    void index(std::list<Segment> &segments) const;
+
+    // Index the whole file by read() from current position.
+    // Works for pipes and devices as well.
+    void index_sequential(std::list<Segment> &segments) const;
+
+    // Index regular file of given size by stripes on worker threads.
+    void index_parallel(long file_size, std::list<Segment> &segments) const;
+
+    // Index lines of regular file which start at or after given offset.
+    // Ranges up to stripe boundaries are indexed on worker threads, and passed
+    // to consumer in file order as soon as available. Stops early when cancel is set.
+    void index_stripes(long start, long file_size, const Consumer &consumer,
+                       const std::atomic<bool> *cancel = nullptr) const;
+
+    // Index lines which start in byte range [start, end) of regular file.
+    // Line which started before the range is skipped; last line is followed
+    // past the end of range until its newline.
+    void index_range(long start, long end, std::list<Segment> &segments) const;
+
+private:
+    int fd_;                // file to index
+    unsigned threads_{ 0 }; // number of worker threads, 0 for default
+};
+
+#endif // FILE_INDEXER_H
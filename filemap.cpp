@@ -0,0 +1,172 @@
+#include "filemap.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+
+namespace {
+
+//
+// Registry of active mappings, visible to the signal handler.
+// Only lock-free atomics are touched from the handler.
+//
+struct MappedRegion {
+    std::atomic<char *> start{ nullptr };
+    std::atomic<size_t> size{ 0 };
+    std::atomic<bool> stale{ false };
+};
+
+const int MAX_REGIONS = 16;
+MappedRegion regions[MAX_REGIONS];
+
+// Start of a slot taken by a thread which is still mapping the file.
+// Its size is 0, so the signal handler never matches it.
+char *const CLAIMED = reinterpret_cast<char *>(1);
+
+struct sigaction prev_sigbus_action; // handler to call for faults outside mappings
+long page_size = 4096;
+
+} // namespace
+
+Filemap::~Filemap()
+{
+    unmap();
+}
+
+//
+// Map the whole file for reading.
+// Returns false for special files, empty files, or when out of registry slots.
+//
+bool Filemap::map(int fd)
+{
+    unmap();
+
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        return false;
+    }
+
+    // Claim free slot in registry: files are mapped by several threads at once
+    int slot = -1;
+    for (int i = 0; i < MAX_REGIONS; ++i) {
+        char *expected = nullptr;
+        if (regions[i].start.compare_exchange_strong(expected, CLAIMED)) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return false;
+    }
+
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        regions[slot].start.store(nullptr);
+        return false;
+    }
+    install_sigbus_guard();
+
+    fd_   = fd;
+    data_ = static_cast<char *>(addr);
+    size_ = st.st_size;
+    slot_ = slot;
+    regions[slot].stale.store(false);
+    regions[slot].size.store(size_);
+    regions[slot].start.store(data_);
+    return true;
+}
+
+//
+// Remove the mapping.
+//
+void Filemap::unmap()
+{
+    if (!data_) {
+        return;
+    }
+    // Slot is free for other threads once start is cleared
+    regions[slot_].size.store(0);
+    regions[slot_].start.store(nullptr);
+    munmap(data_, size_);
+
+    fd_   = -1;
+    data_ = nullptr;
+    size_ = 0;
+    slot_ = -1;
+}
+
+//
+// Pointer to the mapped bytes at given offset, or nullptr when out of range.
+//
+const char *Filemap::bytes(long offset, size_t len) const
+{
+    if (!data_ || offset < 0 || (size_t)offset > size_ || len > size_ - offset) {
+        return nullptr;
+    }
+    return data_ + offset;
+}
+
+//
+// Check whether the file was truncated under the mapping.
+//
+bool Filemap::is_stale() const
+{
+    return slot_ >= 0 && regions[slot_].stale.load();
+}
+
+//
+// Install SIGBUS handler, chaining to the previously installed one.
+//
+void Filemap::install_sigbus_guard()
+{
+    struct sigaction current;
+    if (sigaction(SIGBUS, nullptr, &current) == 0 && (current.sa_flags & SA_SIGINFO) &&
+        current.sa_sigaction == sigbus_handler) {
+        return; // Already on top
+    }
+
+    struct sigaction action {};
+    action.sa_sigaction = sigbus_handler;
+    action.sa_flags     = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+
+    page_size = sysconf(_SC_PAGESIZE);
+    sigaction(SIGBUS, &action, &prev_sigbus_action);
+}
+
+//
+// Handle SIGBUS raised by access to a truncated mapping.
+// Pages past the fault are replaced with zeroes, and the faulting
+// instruction is restarted. Other faults go to the previous handler.
+//
+void Filemap::sigbus_handler(int sig, siginfo_t *info, void *context)
+{
+    char *addr = static_cast<char *>(info->si_addr);
+
+    for (auto &region : regions) {
+        char *start = region.start.load();
+        size_t size = region.size.load();
+        if (start && start != CLAIMED && addr >= start && addr < start + size) {
+            char *from = start + (addr - start) / page_size * page_size;
+            if (mmap(from, start + size - from, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                     -1, 0) != MAP_FAILED) {
+                region.stale.store(true);
+                return;
+            }
+            break;
+        }
+    }
+
+    // Not our mapping: pass to the previous handler.
+    if (prev_sigbus_action.sa_flags & SA_SIGINFO) {
+        prev_sigbus_action.sa_sigaction(sig, info, context);
+    } else if (prev_sigbus_action.sa_handler == SIG_DFL ||
+               prev_sigbus_action.sa_handler == SIG_IGN) {
+        // Restore default action: the fault repeats and terminates the process.
+        signal(sig, SIG_DFL);
+    } else {
+        prev_sigbus_action.sa_handler(sig);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef FILEMAP_H
+#define FILEMAP_H
+
+#include <signal.h>
+
+#include <cstddef>
+
+//
+// Filemap class - read-only memory mapping of an original file.
+// Lines of unmodified segments are served straight from the mapping,
+// avoiding a system call per line. Special files (pipes, devices) and
+// empty files are not mapped; callers fall back to pread() then.
+//
+// When the file is truncated by another process while mapped, access
+// beyond the new end raises SIGBUS. A signal guard replaces the missing
+// pages with zero pages and marks the mapping stale, so that the editor
+// keeps running and further reads go through pread().
+//
+class Filemap {
+public:
+    Filemap() = default;
+    ~Filemap();
+
+    // No copying
+    Filemap(const Filemap &)            = delete;
+    Filemap &operator=(const Filemap &) = delete;
+
+    // Map the whole file for reading. File descriptor is not owned.
+    // Returns false when file cannot be mapped.
+    bool map(int fd);
+
+    // Remove the mapping.
+    void unmap();
+
+    // Check whether the mapping can serve the given file descriptor.
+    bool covers(int fd) const { return data_ != nullptr && fd == fd_ && !is_stale(); }
+
+    // Pointer to the mapped bytes at given offset, or nullptr when out of range.
+    const char *bytes(long offset, size_t len) const;
+
+    // Length of the mapping.
+    size_t size() const { return size_; }
+
+    // Check whether the file was truncated under the mapping.
+    bool is_stale() const;
+
+    // Install SIGBUS handler, chaining to the previously installed one.
+    // Safe to call more than once.
+    static void install_sigbus_guard();
+
+private:
+    // Handle SIGBUS raised by access to a truncated mapping.
+    static void sigbus_handler(int sig, siginfo_t *info, void *context);
+
+    int fd_{ -1 };          // mapped file descriptor
+    char *data_{ nullptr }; // start of the mapping
+    size_t size_{ 0 };      // length of the mapping
+    int slot_{ -1 };        // index in registry of mappings, for the signal handler
+};
+
+#endif // FILEMAP_H
@@ -20,14 +20,15 @@
 bool Editor::execute_external_filter(const std::string &command, int start_line, int num_lines)
 {
     // Validate parameters
-    auto total = wksp_->total_line_count();
-    if (start_line < 0 || start_line >= total) {
+    if (!wksp_->has_line(start_line)) {
         return false;
     }
 
     // Limit num_lines to available lines
-    int end_line = std::min(start_line + num_lines, total);
-    num_lines    = end_line - start_line;
+    if (num_lines > 0 && !wksp_->has_line((long)start_line + num_lines - 1)) {
+        num_lines = wksp_->total_line_count() - start_line;
+    }
+    int end_line = start_line + num_lines;
 
     if (num_lines <= 0) {
         return false;
@@ -46,8 +47,7 @@ bool Editor::execute_external_filter(const std::string &command, int start_line,
     }
 
     for (int i = start_line; i < end_line; ++i) {
-        std::string line = wksp_->read_line(i);
-        input_stream << line;
+        input_stream << wksp_->read_line_view(i);
         if (i < end_line - 1) {
             input_stream << '\n';
         }
@@ -133,6 +133,10 @@ void Editor::switch_to_alternative_workspace()
         create_alternative_workspace();
     }
 
+    // Commit pending edit to the workspace it belongs to
+    put_line();
+    current_line_no_ = -1;
+
     // Swap workspaces
     std::swap(wksp_, alt_wksp_);
 
@@ -220,12 +224,15 @@ bool Editor::create_builtin_help()
         "  F5          - Copy line\n"
         "  F6          - Paste line\n"
         "  F7          - Search\n"
+        "  ^X r        - Toggle regex search\n"
         "  F8          - Go to line\n"
         "\n"
         "COMMAND MODE:\n"
         "  qa          - Quit all\n"
         "  o<file>     - Open file\n"
         "  <number>    - Go to line\n"
+        "  b<offset>   - Go to byte offset\n"
+        "  c/old/new/g - Replace old by new\n"
         "\n"
         "MOVEMENT:\n"
         "  Arrow keys  - Move cursor\n"
@@ -238,6 +245,8 @@ bool Editor::create_builtin_help()
         "  ^C          - Copy line\n"
         "  ^V          - Paste line\n"
         "  ^O          - Insert line\n"
+        "  ^U          - Undo\n"
+        "  ^R          - Redo\n"
         "\n"
         "Press ^N to return to your file.\n";
 
@@ -0,0 +1,580 @@
+#include "io_backend.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#include "filemap.h"
+
+#if defined(__linux__) && __has_include(<linux/fs.h>)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#define HAVE_KERNEL_COPY 1
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define HAVE_IO_URING 1
+#endif
+
+namespace {
+
+const size_t READ_SIZE   = 1024 * 1024;      // bytes per read
+const long WINDOW_SIZE   = 16 * 1024 * 1024; // granularity of drop behind on output
+const unsigned QUEUE_LEN = 4;                // reads in flight for io_uring
+
+//
+// Size of regular file, or -1.
+//
+long file_size(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        return -1;
+    }
+    return st.st_size;
+}
+
+//
+// Blocking reads by pread() into a large buffer.
+//
+class PreadBackend : public IoBackend {
+public:
+    const char *name() const override { return "pread"; }
+
+    bool read(int fd, long offset, long len, const Consumer &consumer) const override
+    {
+        long end = (len < 0) ? LONG_MAX : offset + len;
+        std::vector<char> buf(std::min<long>(READ_SIZE, end - offset));
+
+        advise_sequential(fd, offset, len);
+        while (offset < end) {
+            ssize_t nread = pread(fd, buf.data(), std::min<long>(buf.size(), end - offset), offset);
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread < 0)
+                return false;
+            if (nread == 0)
+                break;
+            if (!consumer(buf.data(), nread))
+                break;
+            drop_behind(fd, offset, nread);
+            offset += nread;
+        }
+        return true;
+    }
+};
+
+const PreadBackend pread_backend;
+
+//
+// Reads through a mapping of the whole file.
+// Truncation of the file while reading is caught by the SIGBUS guard of Filemap.
+//
+class MmapBackend : public IoBackend {
+public:
+    const char *name() const override { return "mmap"; }
+
+    bool read(int fd, long offset, long len, const Consumer &consumer) const override
+    {
+        Filemap map;
+        if (!map.map(fd)) {
+            // Not a regular file, or out of mapping slots
+            return pread_backend.read(fd, offset, len, consumer);
+        }
+        long end = std::min<long>(map.size(), (len < 0) ? LONG_MAX : offset + len);
+
+        advise_sequential(fd, offset, len);
+        while (offset < end) {
+            size_t n         = std::min<long>(READ_SIZE, end - offset);
+            const char *data = map.bytes(offset, n);
+            if (!data || !consumer(data, n))
+                break;
+            if (map.is_stale())
+                return false;
+            drop_behind(fd, offset, n);
+            offset += n;
+        }
+        return true;
+    }
+};
+
+const MmapBackend mmap_backend;
+
+#ifdef HAVE_IO_URING
+//
+// Minimal io_uring instance, driven by raw system calls.
+//
+class Uring {
+public:
+    // Request completed by the kernel.
+    struct Completion {
+        unsigned long tag; // user data of the request
+        int result;        // bytes read, or negative errno
+    };
+
+    ~Uring()
+    {
+        if (sqes_)
+            munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_)
+            munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_)
+            munmap(sq_ring_, sq_ring_size_);
+        if (fd_ >= 0)
+            close(fd_);
+    }
+
+    // Create queue of given depth. Returns false when io_uring is not available.
+    bool init(unsigned entries)
+    {
+        struct io_uring_params params {};
+        fd_ = syscall(__NR_io_uring_setup, entries, &params);
+        if (fd_ < 0)
+            return false;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+        sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+        if (!sq_ring_)
+            return false;
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring_ = sq_ring_;
+        } else {
+            cq_ring_ = map(cq_ring_size_, IORING_OFF_CQ_RING);
+            if (!cq_ring_)
+                return false;
+        }
+        sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_      = static_cast<struct io_uring_sqe *>(map(sqes_size_, IORING_OFF_SQES));
+        if (!sqes_)
+            return false;
+
+        sq_tail_  = field(sq_ring_, params.sq_off.tail);
+        sq_mask_  = *field(sq_ring_, params.sq_off.ring_mask);
+        sq_array_ = field(sq_ring_, params.sq_off.array);
+        cq_head_  = field(cq_ring_, params.cq_off.head);
+        cq_tail_  = field(cq_ring_, params.cq_off.tail);
+        cq_mask_  = *field(cq_ring_, params.cq_off.ring_mask);
+        cqes_     = reinterpret_cast<struct io_uring_cqe *>(static_cast<char *>(cq_ring_) +
+                                                        params.cq_off.cqes);
+        return true;
+    }
+
+    // Queue read request and submit it to the kernel.
+    bool submit_read(int fd, char *buf, unsigned len, long offset, unsigned long tag)
+    {
+        unsigned tail = *sq_tail_;
+        unsigned idx  = tail & sq_mask_;
+
+        struct io_uring_sqe *sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = fd;
+        sqe->addr      = reinterpret_cast<unsigned long>(buf);
+        sqe->len       = len;
+        sqe->off       = offset;
+        sqe->user_data = tag;
+        sq_array_[idx] = idx;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+        return enter(1, 0) == 1;
+    }
+
+    // Wait for at least one completion.
+    bool wait(Completion &done)
+    {
+        for (;;) {
+            unsigned head = *cq_head_;
+            if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+                const struct io_uring_cqe &cqe = cqes_[head & cq_mask_];
+                done.tag                       = cqe.user_data;
+                done.result                    = cqe.res;
+                __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            if (enter(0, 1) < 0 && errno != EINTR)
+                return false;
+        }
+    }
+
+private:
+    int fd_{ -1 };
+    void *sq_ring_{ nullptr };
+    void *cq_ring_{ nullptr };
+    size_t sq_ring_size_{ 0 };
+    size_t cq_ring_size_{ 0 };
+    struct io_uring_sqe *sqes_{ nullptr };
+    size_t sqes_size_{ 0 };
+    unsigned *sq_tail_{ nullptr };
+    unsigned *sq_array_{ nullptr };
+    unsigned sq_mask_{ 0 };
+    unsigned *cq_head_{ nullptr };
+    unsigned *cq_tail_{ nullptr };
+    unsigned cq_mask_{ 0 };
+    struct io_uring_cqe *cqes_{ nullptr };
+
+    void *map(size_t size, unsigned long offset)
+    {
+        void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                          offset);
+        return (addr == MAP_FAILED) ? nullptr : addr;
+    }
+
+    static unsigned *field(void *ring, unsigned offset)
+    {
+        return reinterpret_cast<unsigned *>(static_cast<char *>(ring) + offset);
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete)
+    {
+        unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+        return syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, nullptr, 0);
+    }
+};
+
+//
+// Per-thread io_uring instance with its read buffers, kept between calls.
+//
+struct UringReader {
+    // Slot per request in flight
+    struct Slot {
+        std::vector<char> buf;
+        long offset{ -1 }; // file offset, or -1 when free
+        unsigned len{ 0 }; // bytes requested
+        int result{ 0 };   // bytes read, or negative errno
+        bool done{ false };
+    };
+
+    Uring ring;
+    bool available;          // false when io_uring is not supported, or broken
+    std::vector<Slot> slots; // QUEUE_LEN entries
+
+    UringReader() : available(ring.init(QUEUE_LEN)), slots(QUEUE_LEN) {}
+};
+#endif // HAVE_IO_URING
+
+//
+// Reads by io_uring, with several blocks in flight.
+// Falls back to pread() when io_uring is not supported by the kernel.
+//
+class UringBackend : public IoBackend {
+public:
+    const char *name() const override { return "uring"; }
+
+    bool read(int fd, long offset, long len, const Consumer &consumer) const override
+    {
+#ifdef HAVE_IO_URING
+        thread_local UringReader reader;
+        if (!reader.available) {
+            return pread_backend.read(fd, offset, len, consumer);
+        }
+        Uring &ring = reader.ring;
+        auto &slots = reader.slots;
+        long end    = (len < 0) ? LONG_MAX : offset + len;
+
+        unsigned in_flight = 0;
+        long next_submit   = offset; // offset of next request
+        long next_deliver  = offset; // offset of next block to pass to consumer
+        bool eof           = false;
+
+        // Wait for completion of all requests, and discard them
+        auto drain = [&]() {
+            Uring::Completion done;
+            while (in_flight > 0 && ring.wait(done)) {
+                --in_flight;
+            }
+            for (auto &slot : slots) {
+                slot.offset = -1;
+                slot.done   = false;
+            }
+            next_submit = next_deliver;
+        };
+
+        advise_sequential(fd, offset, len);
+        for (;;) {
+            // Keep the queue full
+            for (unsigned i = 0; i < QUEUE_LEN && !eof && next_submit < end; ++i) {
+                auto &slot = slots[i];
+                if (slot.offset >= 0)
+                    continue;
+                slot.buf.resize(READ_SIZE);
+                slot.offset = next_submit;
+                slot.len    = std::min<long>(READ_SIZE, end - next_submit);
+                slot.done   = false;
+                if (!ring.submit_read(fd, slot.buf.data(), slot.len, slot.offset, i)) {
+                    slot.offset = -1;
+                    break;
+                }
+                next_submit += slot.len;
+                ++in_flight;
+            }
+            if (in_flight == 0)
+                break;
+
+            Uring::Completion done;
+            if (!ring.wait(done)) {
+                // Requests may still be in flight: never reuse the buffers
+                reader.available = false;
+                return false;
+            }
+            --in_flight;
+            slots[done.tag].result = done.result;
+            slots[done.tag].done   = true;
+
+            // Pass completed blocks in file order
+            for (bool found = true; found;) {
+                found = false;
+                for (auto &slot : slots) {
+                    if (slot.offset != next_deliver || !slot.done)
+                        continue;
+                    found = true;
+                    if (slot.result < 0) {
+                        // Old kernel may not know the opcode: continue by pread()
+                        drain();
+                        long rest = (len < 0) ? -1 : end - next_deliver;
+                        return pread_backend.read(fd, next_deliver, rest, consumer);
+                    }
+                    if (slot.result > 0 && !consumer(slot.buf.data(), slot.result)) {
+                        drain();
+                        return true;
+                    }
+                    drop_behind(fd, next_deliver, slot.result);
+                    next_deliver += slot.result;
+                    slot.offset = -1;
+                    if (slot.result == 0) {
+                        eof = true;
+                    }
+                    if ((unsigned)slot.result < slot.len) {
+                        // Short read: restart the queue after it
+                        drain();
+                        found = false;
+                    }
+                    break;
+                }
+            }
+        }
+        drain();
+        return true;
+#else
+        return pread_backend.read(fd, offset, len, consumer);
+#endif
+    }
+};
+
+const UringBackend uring_backend;
+
+const IoBackend *current_backend = &pread_backend;
+bool kernel_copy_enabled         = true;
+
+#ifdef HAVE_KERNEL_COPY
+//
+// Share extents of aligned part of the range with output file by reflink.
+// Both files must be on the same filesystem which supports it, like XFS or Btrfs.
+// Returns number of bytes cloned from the start of the range, possibly 0.
+//
+long clone_range(int in_fd, long offset, long len, int out_fd, long out_pos)
+{
+    struct stat st;
+    if (fstat(out_fd, &st) < 0 || st.st_blksize <= 0)
+        return 0;
+    long block = st.st_blksize;
+    if (offset % block != 0 || out_pos % block != 0 || len < block)
+        return 0;
+
+    struct file_clone_range range {};
+    range.src_fd      = in_fd;
+    range.src_offset  = offset;
+    range.src_length  = len - len % block;
+    range.dest_offset = out_pos;
+    if (ioctl(out_fd, FICLONERANGE, &range) < 0)
+        return 0;
+
+    // Clone does not move file position
+    lseek(out_fd, range.src_length, SEEK_CUR);
+    return range.src_length;
+}
+#endif // HAVE_KERNEL_COPY
+
+} // namespace
+
+//
+// Backend in use.
+//
+const IoBackend &IoBackend::get()
+{
+    return *current_backend;
+}
+
+//
+// Select backend by name. Returns false for unknown name.
+//
+bool IoBackend::select(const std::string &name)
+{
+    for (const IoBackend *backend :
+         { (const IoBackend *)&pread_backend, (const IoBackend *)&mmap_backend,
+           (const IoBackend *)&uring_backend }) {
+        if (name == backend->name()) {
+            current_backend = backend;
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Append len bytes of in_fd from given offset to out_fd.
+// Data is copied inside the kernel when possible, and through
+// a buffer otherwise.
+//
+bool IoBackend::copy(int in_fd, long offset, long len, int out_fd) const
+{
+    long out_pos = lseek(out_fd, 0, SEEK_CUR);
+    if (out_pos >= 0 && kernel_copy_enabled) {
+        long copied = copy_in_kernel(in_fd, offset, len, out_fd, out_pos);
+        offset += copied;
+        len -= copied;
+        out_pos += copied;
+    }
+    if (len <= 0)
+        return true;
+
+    long copied = 0;
+    bool ok     = read(in_fd, offset, len, [&](const char *data, size_t n) {
+        if (!write_all(out_fd, data, n))
+            return false;
+        if (out_pos >= 0) {
+            flush_behind(out_fd, out_pos + copied, n);
+        }
+        copied += n;
+        return true;
+    });
+    return ok && copied == len;
+}
+
+//
+// Copy start of the range without passing data through user space:
+// by reflink when both offsets are aligned to filesystem blocks,
+// then by copy_file_range(). Returns number of bytes copied; stops
+// early when not supported, like between different filesystems.
+//
+long IoBackend::copy_in_kernel(int in_fd, long offset, long len, int out_fd, long out_pos)
+{
+#ifdef HAVE_KERNEL_COPY
+    long copied = clone_range(in_fd, offset, len, out_fd, out_pos);
+
+    while (copied < len) {
+        // By windows, to release pages of huge files behind
+        long chunk    = std::min(len - copied, WINDOW_SIZE);
+        loff_t in_off = offset + copied;
+        ssize_t n     = copy_file_range(in_fd, &in_off, out_fd, nullptr, chunk, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        drop_behind(in_fd, offset + copied, n);
+        flush_behind(out_fd, out_pos + copied, n);
+        copied += n;
+    }
+    return copied;
+#else
+    (void)in_fd, (void)offset, (void)len, (void)out_fd, (void)out_pos;
+    return 0;
+#endif
+}
+
+//
+// Allow copying inside the kernel; when disabled, copy() always uses a buffer.
+//
+void IoBackend::enable_kernel_copy(bool on)
+{
+    kernel_copy_enabled = on;
+}
+
+//
+// Write all data, retrying on partial writes. Returns false on error.
+//
+bool IoBackend::write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t nwritten = write(fd, data, len);
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+            return false;
+        data += nwritten;
+        len -= nwritten;
+    }
+    return true;
+}
+
+//
+// Hint kernel about sequential access to the file.
+//
+void IoBackend::advise_sequential(int fd, long offset, long len)
+{
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, offset, (len < 0) ? 0 : len, POSIX_FADV_SEQUENTIAL);
+#else
+    (void)fd, (void)offset, (void)len;
+#endif
+}
+
+//
+// Output of huge saves: after block [offset, offset + len) was written,
+// start writeback of the completed window, then wait for the previous ones
+// and release them from page cache. Thus dirty pages are limited to two windows.
+//
+void IoBackend::flush_behind(int fd, long offset, long len)
+{
+    if (offset + len < HUGE_FILE_SIZE)
+        return;
+
+    for (long w = offset / WINDOW_SIZE + 1; w * WINDOW_SIZE <= offset + len; ++w) {
+        // Window w-1 is complete; on reaching huge size, release everything before it
+        long start = (offset < HUGE_FILE_SIZE) ? 0 : std::max(0L, (w - 2) * WINDOW_SIZE);
+        long done  = (w - 1) * WINDOW_SIZE - start;
+#ifdef __linux__
+        sync_file_range(fd, (w - 1) * WINDOW_SIZE, WINDOW_SIZE, SYNC_FILE_RANGE_WRITE);
+        if (done > 0) {
+            sync_file_range(fd, start, done,
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                SYNC_FILE_RANGE_WAIT_AFTER);
+        }
+#endif
+#ifdef POSIX_FADV_DONTNEED
+        if (done > 0) {
+            posix_fadvise(fd, start, done, POSIX_FADV_DONTNEED);
+        }
+#endif
+    }
+}
+
+//
+// Release pages of huge file from page cache, after block [offset, offset + len)
+// was consumed. Pages are released by whole windows, one window behind the reader:
+// the kernel keeps pages which are still under read-ahead.
+//
+void IoBackend::drop_behind(int fd, long offset, long len)
+{
+#ifdef POSIX_FADV_DONTNEED
+    for (long w = offset / WINDOW_SIZE + 1; w * WINDOW_SIZE <= offset + len; ++w) {
+        if (w >= 2 && file_size(fd) >= HUGE_FILE_SIZE) {
+            posix_fadvise(fd, (w - 2) * WINDOW_SIZE, WINDOW_SIZE, POSIX_FADV_DONTNEED);
+        }
+    }
+#else
+    (void)fd, (void)offset, (void)len;
+#endif
+}
@@ -0,0 +1,73 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+//
+// IoBackend class - strategy for bulk file access by load and save.
+// Implementations:
+//  * pread - large buffer, with posix_fadvise() hints
+//  * mmap  - reads through a mapping of the file
+//  * uring - io_uring, with several reads in flight
+//
+// Huge files are read and written with "drop behind": pages already
+// processed are released from the page cache, so that loading or saving
+// a file of many gigabytes does not evict everything else.
+//
+// The backend is selected once at startup, by option --io=NAME.
+//
+class IoBackend {
+public:
+    // Receives consecutive blocks of data; returns false to stop reading.
+    using Consumer = std::function<bool(const char *data, size_t len)>;
+
+    // Files of this size and more are read and written with drop behind.
+    static constexpr long HUGE_FILE_SIZE = 256L * 1024 * 1024;
+
+    virtual ~IoBackend() = default;
+
+    // Name of the backend, as given to --io option.
+    virtual const char *name() const = 0;
+
+    // Read file from given offset, up to len bytes or up to end of file when len < 0.
+    // Blocks are passed to consumer in file order. Returns false on read error.
+    // Safe to call from several threads at once.
+    virtual bool read(int fd, long offset, long len, const Consumer &consumer) const = 0;
+
+    // Append len bytes of in_fd from given offset to out_fd.
+    // Uses reflink or copy_file_range() when supported, and buffered copy otherwise.
+    // Returns false on read or write error, or when the input is shorter.
+    bool copy(int in_fd, long offset, long len, int out_fd) const;
+
+    // Allow copying inside the kernel (enabled by default).
+    static void enable_kernel_copy(bool on);
+
+    // Write all data, retrying on partial writes. Returns false on error.
+    static bool write_all(int fd, const char *data, size_t len);
+
+    // Backend in use.
+    static const IoBackend &get();
+
+    // Select backend by name. Returns false for unknown name.
+    static bool select(const std::string &name);
+
+    // Names of all backends, for usage message.
+    static const char *names() { return "pread, mmap, uring"; }
+
+protected:
+    // Copy start of the range inside the kernel. Returns number of bytes copied.
+    static long copy_in_kernel(int in_fd, long offset, long len, int out_fd, long out_pos);
+
+    // Hint kernel about sequential access to the file.
+    static void advise_sequential(int fd, long offset, long len);
+
+    // Block of input was consumed: release pages behind it, when the file is huge.
+    static void drop_behind(int fd, long offset, long len);
+
+    // Block of output was written: flush and release pages behind it, when the file is huge.
+    static void flush_behind(int fd, long offset, long len);
+};
+
+#endif // IO_BACKEND_H
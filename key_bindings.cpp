@@ -48,35 +48,18 @@ void Editor::handle_key_edit(int ch)
     }
     // ^D - Delete character at cursor
     if (ch == 4) { // Ctrl-D
-        int cur_line = wksp_->view.topline + cursor_line_;
-        get_line(cur_line);
-        if (cursor_col_ < (int)current_line_.size()) {
-            current_line_.erase((size_t)cursor_col_, 1);
-            current_line_modified_ = true;
-            put_line();
-            ensure_cursor_visible();
-        } else if (cur_line + 1 < wksp_->total_line_count()) {
-            // Join with next line
-            get_line(cur_line + 1);
-            current_line_ += current_line_;
-            current_line_no_       = cur_line;
-            current_line_modified_ = true;
-            put_line();
-            // Delete next line
-            wksp_->delete_contents(cur_line + 1, cur_line + 1);
-            ensure_cursor_visible();
-        }
+        // Same as Delete key: remove character, or join with next line at end
+        edit_delete();
         return;
     }
     // ^Y - Delete current line
     if (ch == 25) { // Ctrl-Y
         int cur_line = wksp_->view.topline + cursor_line_;
-        if (cur_line >= 0 && cur_line < wksp_->total_line_count()) {
+        if (wksp_->has_line(cur_line)) {
             picklines(cur_line, 1); // Copy to clipboard_ before deleting
             wksp_->delete_contents(cur_line, cur_line);
-            auto total = wksp_->total_line_count();
-            if (cursor_line_ >= total - 1) {
-                cursor_line_ = total - 2;
+            if (!wksp_->has_line(cursor_line_ + 1)) {
+                cursor_line_ = wksp_->total_line_count() - 2;
                 if (cursor_line_ < 0)
                     cursor_line_ = 0;
             }
@@ -84,6 +67,11 @@ void Editor::handle_key_edit(int ch)
         }
         return;
     }
+    // ^U - Undo last change, ^R - Redo it
+    if (ch == 21 || ch == 18) { // Ctrl-U, Ctrl-R
+        edit_undo(ch == 18);
+        return;
+    }
     // ^C - Copy current line to clipboard_
     if (ch == 3) { // Ctrl-C
         int cur_line = wksp_->view.topline + cursor_line_;
@@ -103,7 +91,8 @@ void Editor::handle_key_edit(int ch)
     // ^O - Insert blank line
     if (ch == 15) { // Ctrl-O
         int cur_line = wksp_->view.topline + cursor_line_;
-        auto blank   = wksp_->create_blank_lines(1);
+        put_line(); // Commit pending edit before line numbers shift
+        auto blank = wksp_->create_blank_lines(1);
         wksp_->insert_contents(blank, cur_line + 1);
         ensure_cursor_visible();
         return;
@@ -166,6 +155,13 @@ void Editor::handle_key_edit(int ch)
         ctrlx_state_ = false;
         return;
     }
+    // ^X r - Toggle regular expression search
+    if (ctrlx_state_ && (ch == 'r' || ch == 'R')) {
+        regex_search_ = !regex_search_;
+        status_       = std::string("Search: ") + (regex_search_ ? "regex" : "literal");
+        ctrlx_state_  = false;
+        return;
+    }
     // ^X ^C - Exit with saving
     if (ctrlx_state_ && (ch == 3 || ch == 'c' || ch == 'C')) {
         save_file();
@@ -247,7 +243,7 @@ void Editor::handle_key_edit(int ch)
     }
     if (ch == 12 /* Ctrl-L */) {
         // Force full redraw
-        wksp_redraw();
+        redraw_screen();
         return;
     }
     if (ch == KEY_RESIZE) {
@@ -331,6 +327,7 @@ void Editor::handle_key_cmd(int ch)
             exit_command_mode(true, false);
             status_ = "Cancelled";
         } else {
+            finish_incremental_search(false);
             cmd_.clear();
             exit_command_mode(false, true);
         }
@@ -343,6 +340,7 @@ void Editor::handle_key_cmd(int ch)
             // This shouldn't happen anymore as we handle Enter above
             return;
         }
+        finish_incremental_search(true);
         execute_command(cmd_);
         exit_command_mode(true, true);
         return;
@@ -0,0 +1,45 @@
+#include "line_cache.h"
+
+//
+// Find text of line at given location.
+//
+const std::string *LineCache::find(int fd, long offset, long line_no)
+{
+    auto it = entries_.find({ fd, offset });
+    if (it == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    it->second.line_no = line_no;
+    return &it->second.text;
+}
+
+//
+// Add text of line at given location.
+// References to entries stay valid when the table grows.
+//
+const std::string &LineCache::insert(int fd, long offset, long line_no, std::string_view text)
+{
+    Entry &entry  = entries_[{ fd, offset }];
+    entry.text    = text;
+    entry.line_no = line_no;
+    return entry.text;
+}
+
+//
+// Drop lines last shown outside of the given range, when there are too many.
+//
+void LineCache::trim(long first, long last, size_t limit)
+{
+    if (entries_.size() <= limit)
+        return;
+
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (it->second.line_no < first || it->second.line_no >= last) {
+            it = entries_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
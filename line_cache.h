@@ -0,0 +1,70 @@
+#ifndef LINE_CACHE_H
+#define LINE_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+//
+// LineCache class - text of lines recently shown on screen.
+//
+// Lines are identified by location of their bytes: file descriptor and offset.
+// Bytes at a location never change: modified lines are written to new places
+// in temp file. So an edit invalidates exactly the lines it replaces, and
+// lines which only moved up or down are still found.
+//
+// Every entry remembers the line number it was last shown at, and entries
+// far from the visible rows are dropped by trim().
+//
+class LineCache {
+public:
+    // Find text of line at given location, and remember where it is shown.
+    // Returns nullptr when not cached.
+    const std::string *find(int fd, long offset, long line_no);
+
+    // Add text of line at given location.
+    const std::string &insert(int fd, long offset, long line_no, std::string_view text);
+
+    // When more than limit entries are cached, drop those last shown outside [first, last).
+    void trim(long first, long last, size_t limit);
+
+    // Forget all lines, when locations are reused.
+    void clear() { entries_.clear(); }
+
+    // Number of cached lines.
+    size_t size() const { return entries_.size(); }
+
+    // Statistics of find().
+    unsigned long hits() const { return hits_; }
+    unsigned long misses() const { return misses_; }
+
+private:
+    struct Location {
+        int fd;
+        long offset;
+
+        bool operator==(const Location &other) const
+        {
+            return fd == other.fd && offset == other.offset;
+        }
+    };
+
+    struct LocationHash {
+        size_t operator()(const Location &loc) const
+        {
+            return std::hash<long>()(loc.offset) ^ ((size_t)loc.fd << 48);
+        }
+    };
+
+    struct Entry {
+        std::string text; // line without newline
+        long line_no;     // line number where it was shown last
+    };
+
+    std::unordered_map<Location, Entry, LocationHash> entries_;
+    unsigned long hits_{ 0 };   // lines found
+    unsigned long misses_{ 0 }; // lines not found
+};
+
+#endif // LINE_CACHE_H
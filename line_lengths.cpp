@@ -0,0 +1,205 @@
+#include "line_lengths.h"
+
+#include <algorithm>
+#include <utility>
+
+LineLengths::LineLengths(LineLengths &&other) noexcept
+    : bytes_(std::move(other.bytes_)), checkpoints_(std::move(other.checkpoints_)),
+      count_(other.count_), total_(other.total_)
+{
+    other.clear();
+}
+
+LineLengths &LineLengths::operator=(LineLengths &&other) noexcept
+{
+    if (this != &other) {
+        bytes_       = std::move(other.bytes_);
+        checkpoints_ = std::move(other.checkpoints_);
+        count_       = other.count_;
+        total_       = other.total_;
+        other.clear();
+    }
+    return *this;
+}
+
+//
+// Decode one length and advance the pointer past it.
+//
+long LineLengths::decode(const unsigned char *&ptr)
+{
+    long value = 0;
+    int shift  = 0;
+    for (;;) {
+        unsigned char byte = *ptr++;
+        value |= (long)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+        shift += 7;
+    }
+}
+
+long LineLengths::const_iterator::operator*() const
+{
+    const unsigned char *ptr = ptr_;
+    return decode(ptr);
+}
+
+LineLengths::const_iterator &LineLengths::const_iterator::operator++()
+{
+    while (*ptr_ & 0x80)
+        ++ptr_;
+    ++ptr_;
+    return *this;
+}
+
+//
+// Find position in bytes_ and offset of the line at given index.
+// Index may be equal to size(), giving the end of data.
+//
+void LineLengths::seek(size_t index, size_t &pos, long &offset) const
+{
+    if (index >= count_) {
+        pos    = bytes_.size();
+        offset = total_;
+        return;
+    }
+
+    // Start from the nearest checkpoint at or before the line.
+    size_t block = index / CHECKPOINT_INTERVAL;
+    size_t line  = block * CHECKPOINT_INTERVAL;
+    pos          = 0;
+    offset       = 0;
+    if (block > 0) {
+        pos    = checkpoints_[block - 1].pos;
+        offset = checkpoints_[block - 1].offset;
+    }
+
+    const unsigned char *ptr = bytes_.data() + pos;
+    for (; line < index; ++line) {
+        offset += decode(ptr);
+    }
+    pos = ptr - bytes_.data();
+}
+
+//
+// Length of the line at given index.
+//
+long LineLengths::operator[](size_t index) const
+{
+    size_t pos;
+    long offset;
+    seek(index, pos, offset);
+    if (pos >= bytes_.size())
+        return 0;
+
+    const unsigned char *ptr = bytes_.data() + pos;
+    return decode(ptr);
+}
+
+//
+// Sum of lengths of all lines before given index.
+//
+long LineLengths::offset_of(size_t index) const
+{
+    size_t pos;
+    long offset;
+    seek(index, pos, offset);
+    return offset;
+}
+
+//
+// Index of the line containing given byte offset.
+// Binary search over checkpoints, then decode inside one block.
+//
+size_t LineLengths::line_at(long offset) const
+{
+    if (offset < 0)
+        return 0;
+    if (offset >= total_)
+        return count_;
+
+    auto cp = std::upper_bound(checkpoints_.begin(), checkpoints_.end(), offset,
+                               [](long value, const Checkpoint &c) { return value < c.offset; });
+    size_t block = cp - checkpoints_.begin();
+    size_t line  = block * CHECKPOINT_INTERVAL;
+    long start   = 0;
+    size_t pos   = 0;
+    if (block > 0) {
+        pos   = checkpoints_[block - 1].pos;
+        start = checkpoints_[block - 1].offset;
+    }
+
+    const unsigned char *ptr = bytes_.data() + pos;
+    for (;;) {
+        start += decode(ptr);
+        if (offset < start)
+            return line;
+        ++line;
+    }
+}
+
+//
+// Append one length.
+//
+void LineLengths::push_back(long len)
+{
+    if (count_ > 0 && count_ % CHECKPOINT_INTERVAL == 0) {
+        checkpoints_.push_back({ bytes_.size(), total_ });
+    }
+
+    unsigned long value = len;
+    while (value >= 0x80) {
+        bytes_.push_back((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    bytes_.push_back(value);
+
+    ++count_;
+    total_ += len;
+}
+
+//
+// Remove the last length.
+//
+void LineLengths::pop_back()
+{
+    if (count_ > 0)
+        resize(count_ - 1);
+}
+
+//
+// Truncate, or extend with lines of given length.
+//
+void LineLengths::resize(size_t count, long len)
+{
+    if (count >= count_) {
+        while (count_ < count)
+            push_back(len);
+        return;
+    }
+
+    size_t pos;
+    long offset;
+    seek(count, pos, offset);
+    bytes_.resize(pos);
+    checkpoints_.resize(count > 0 ? (count - 1) / CHECKPOINT_INTERVAL : 0);
+    count_ = count;
+    total_ = offset;
+}
+
+void LineLengths::clear()
+{
+    bytes_.clear();
+    checkpoints_.clear();
+    count_ = 0;
+    total_ = 0;
+}
+
+//
+// Release unused capacity.
+//
+void LineLengths::shrink_to_fit()
+{
+    bytes_.shrink_to_fit();
+    checkpoints_.shrink_to_fit();
+}
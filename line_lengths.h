@@ -0,0 +1,117 @@
+#ifndef LINE_LENGTHS_H
+#define LINE_LENGTHS_H
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+//
+// LineLengths class - compact sequence of line lengths for a segment.
+// Every length is stored as a variable-width integer: 7 bits per byte,
+// high bit set when more bytes follow. Lines shorter than 128 bytes take
+// one byte, and there is no upper limit on line length.
+//
+// Every CHECKPOINT_INTERVAL lines a checkpoint records position in the
+// encoded data and byte offset of the line, so that random access and
+// offset computation decode at most CHECKPOINT_INTERVAL lengths.
+//
+class LineLengths {
+public:
+    // Forward iterator decoding lengths in order.
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = long;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const long *;
+        using reference         = long;
+
+        const_iterator() = default;
+        explicit const_iterator(const unsigned char *ptr) : ptr_(ptr) {}
+
+        long operator*() const;
+        const_iterator &operator++();
+        const_iterator operator++(int)
+        {
+            auto tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const const_iterator &other) const { return ptr_ == other.ptr_; }
+        bool operator!=(const const_iterator &other) const { return ptr_ != other.ptr_; }
+
+    private:
+        const unsigned char *ptr_{ nullptr }; // first byte of current length
+    };
+    using iterator   = const_iterator;
+    using value_type = long;
+
+    LineLengths() = default;
+
+    // Moved-from object is left empty, like std::vector.
+    LineLengths(const LineLengths &)            = default;
+    LineLengths &operator=(const LineLengths &) = default;
+    LineLengths(LineLengths &&other) noexcept;
+    LineLengths &operator=(LineLengths &&other) noexcept;
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // Sum of all lengths.
+    long total() const { return total_; }
+
+    // Length of the line at given index.
+    long operator[](size_t index) const;
+
+    // Sum of lengths of all lines before given index.
+    long offset_of(size_t index) const;
+
+    // Index of the line containing given byte offset.
+    // Returns size() when offset is beyond the last line.
+    size_t line_at(long offset) const;
+
+    void push_back(long len);
+    void pop_back();
+
+    // Truncate, or extend with lines of given length.
+    void resize(size_t count, long len = 0);
+
+    void reserve(size_t count) { bytes_.reserve(count); }
+    void clear();
+
+    // Release unused capacity.
+    void shrink_to_fit();
+
+    const_iterator begin() const { return const_iterator(bytes_.data()); }
+    const_iterator end() const { return const_iterator(bytes_.data() + bytes_.size()); }
+
+    // Encoding is canonical, so equal sequences have equal bytes.
+    bool operator==(const LineLengths &other) const
+    {
+        return count_ == other.count_ && bytes_ == other.bytes_;
+    }
+    bool operator!=(const LineLengths &other) const { return !(*this == other); }
+
+    static constexpr size_t CHECKPOINT_INTERVAL = 64;
+
+private:
+    // Position of decoded data for one line.
+    struct Checkpoint {
+        size_t pos;  // index in bytes_
+        long offset; // sum of lengths of preceding lines
+    };
+
+    // Find position in bytes_ and offset of the line at given index.
+    void seek(size_t index, size_t &pos, long &offset) const;
+
+    // Decode one length and advance the pointer past it.
+    static long decode(const unsigned char *&ptr);
+
+    std::vector<unsigned char> bytes_;    // encoded lengths
+    std::vector<Checkpoint> checkpoints_; // for lines CHECKPOINT_INTERVAL, 2*CHECKPOINT_INTERVAL...
+    size_t count_{ 0 };                   // number of lines
+    long total_{ 0 };                     // sum of all lengths
+};
+
+#endif // LINE_LENGTHS_H
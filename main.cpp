@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include "editor.h"
+#include "io_backend.h"
 
 //
 // Display editor usage information.
@@ -19,6 +20,7 @@ static void print_usage(const char *progname)
     std::cout << "  -h, --help     Show this help message" << std::endl;
     std::cout << "  -v, --version  Show version information" << std::endl;
     std::cout << "  -r, --replay   Replay last session from journal" << std::endl;
+    std::cout << "  --io=NAME      File I/O backend: " << IoBackend::names() << std::endl;
     std::cout << "  (no args)      Restore last session" << std::endl;
     std::cout << std::endl;
     std::cout << "Keys:" << std::endl;
@@ -35,6 +37,7 @@ int main(int argc, char *argv[])
     static struct option long_options[] = { { "help", no_argument, 0, 'h' },
                                             { "version", no_argument, 0, 'v' },
                                             { "replay", no_argument, 0, 'r' },
+                                            { "io", required_argument, 0, 'i' },
                                             { 0, 0, 0, 0 } };
 
     int restart      = 0;
@@ -54,6 +57,13 @@ int main(int argc, char *argv[])
         case 'r':
             replay_flag = true;
             break;
+        case 'i':
+            if (!IoBackend::select(optarg)) {
+                std::cerr << "Unknown I/O backend: " << optarg << std::endl;
+                std::cerr << "Available: " << IoBackend::names() << std::endl;
+                return 1;
+            }
+            break;
         default:
             print_usage(argv[0]);
             return 1;
@@ -63,8 +73,8 @@ int main(int argc, char *argv[])
     // Determine restart mode
     if (replay_flag) {
         restart = 2; // replay
-    } else if (optind == 1 && argc == 1) {
-        // No arguments at all (original argc == 1, nothing was parsed)
+    } else if (optind == argc) {
+        // No file arguments
         restart = 1; // restore attempt
     } else {
         restart = 0; // normal
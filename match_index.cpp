@@ -0,0 +1,142 @@
+#include "match_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+//
+// Forget all matches, and start scanning segments of the original file
+// for matches of the pattern, on a background thread.
+//
+void MatchIndex::start(const SearchPattern &pattern, const std::string &name,
+                       std::vector<Key> keys, Reader reader)
+{
+    clear();
+    name_           = name;
+    pattern_        = pattern.clone();
+    worker_pattern_ = pattern.clone();
+    keys_           = std::move(keys);
+    results_.resize(keys_.size());
+
+    thread_ = std::thread([this, reader = std::move(reader)]() {
+        std::string buf;
+        for (size_t i = 0; i < keys_.size(); ++i) {
+            if (stop_)
+                return;
+            find_all(*worker_pattern_, reader(keys_[i], buf), results_[i]);
+
+            // Results before done_ belong to the main thread
+            found_ += results_[i].size();
+            done_.store(i + 1, std::memory_order_release);
+            if (found_ > MAX_MATCHES)
+                return;
+        }
+    });
+}
+
+//
+// Stop background thread and forget all matches.
+//
+void MatchIndex::clear()
+{
+    if (thread_.joinable()) {
+        stop_ = true;
+        thread_.join();
+    }
+    stop_ = false;
+    name_.clear();
+    pattern_.reset();
+    worker_pattern_.reset();
+    table_.clear();
+    count_ = 0;
+    keys_.clear();
+    results_.clear();
+    taken_ = 0;
+    done_  = 0;
+    found_ = 0;
+}
+
+//
+// Forget matches of segments in the given file.
+//
+void MatchIndex::forget_file(int fd)
+{
+    for (auto it = table_.begin(); it != table_.end();) {
+        if (it->first.fd == fd) {
+            count_ -= it->second.size();
+            it = table_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+//
+// Take matches found by background thread.
+//
+bool MatchIndex::poll()
+{
+    if (!pattern_)
+        return false;
+
+    size_t done = done_.load(std::memory_order_acquire);
+    for (; taken_ < done; ++taken_) {
+        count_ += results_[taken_].size();
+        table_[keys_[taken_]] = std::move(results_[taken_]);
+    }
+    if (done < keys_.size() || count_ > MAX_MATCHES)
+        return false;
+
+    if (thread_.joinable()) {
+        thread_.join();
+        keys_.clear();
+        results_.clear();
+        taken_ = 0;
+        done_  = 0;
+    }
+    return true;
+}
+
+//
+// Matches of segment, or nullptr when not scanned yet.
+//
+const MatchIndex::Matches *MatchIndex::find(const Key &key) const
+{
+    auto it = table_.find(key);
+    return it == table_.end() ? nullptr : &it->second;
+}
+
+//
+// Find matches of segment now.
+//
+const MatchIndex::Matches &MatchIndex::scan(const Key &key, std::string_view bytes)
+{
+    Matches &matches = table_[key];
+    count_ -= matches.size();
+    matches.clear();
+    find_all(*pattern_, bytes, matches);
+    count_ += matches.size();
+    return matches;
+}
+
+//
+// Find all matches in bytes of segment, and convert their offsets
+// to lines and columns, counting newlines between matches.
+//
+void MatchIndex::find_all(const SearchPattern &pattern, std::string_view bytes, Matches &matches)
+{
+    const char *data  = bytes.data();
+    unsigned line     = 0;
+    size_t line_start = 0;
+    size_t counted    = 0; // newlines are counted up to here
+
+    for (long pos = pattern.find_from(data, bytes.size(), 0); pos >= 0;
+         pos      = pattern.find_from(data, bytes.size(), pos + 1)) {
+        const void *nl = memrchr(data + counted, '\n', pos - counted);
+        if (nl) {
+            line += std::count(data + counted, data + pos, '\n');
+            line_start = (const char *)nl - data + 1;
+        }
+        counted = pos;
+        matches.push_back({ line, (unsigned)(pos - line_start) });
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef MATCH_INDEX_H
+#define MATCH_INDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "text_search.h"
+
+//
+// MatchIndex class - positions of all matches of a search pattern, per segment.
+//
+// Segments are identified by location of their bytes: file descriptor,
+// offset and length. Bytes at a location never change: modified lines
+// are written to new places in temp file. So an edit invalidates only
+// matches of the segments it replaces, and all the others are reused.
+//
+// Segments of the original file are scanned on a background thread,
+// in the order given by start(). New segments made by edits are scanned
+// on demand by scan(), which is cheap as they are small.
+//
+class MatchIndex {
+public:
+    // Start of a match: line in the segment and column.
+    struct Match {
+        unsigned line;
+        unsigned col;
+
+        bool operator<(const Match &other) const
+        {
+            return line < other.line || (line == other.line && col < other.col);
+        }
+    };
+    using Matches = std::vector<Match>;
+
+    // Location of segment bytes.
+    struct Key {
+        int fd;
+        long offset;
+        long len;
+
+        bool operator==(const Key &other) const
+        {
+            return fd == other.fd && offset == other.offset && len == other.len;
+        }
+    };
+
+    // Reads bytes of segment, with newlines; called on the background thread.
+    using Reader = std::function<std::string_view(const Key &key, std::string &buf)>;
+
+    // Index is abandoned when the pattern has more matches than this.
+    static constexpr size_t MAX_MATCHES = 16 * 1024 * 1024;
+
+    MatchIndex() = default;
+    ~MatchIndex() { clear(); }
+
+    // No copying
+    MatchIndex(const MatchIndex &)            = delete;
+    MatchIndex &operator=(const MatchIndex &) = delete;
+
+    // Forget all matches, and start indexing those of the pattern.
+    // Segments of given keys are scanned by background thread, with the reader.
+    void start(const SearchPattern &pattern, const std::string &name, std::vector<Key> keys,
+               Reader reader);
+
+    // Stop background thread and forget all matches.
+    void clear();
+
+    // Name of the pattern given to start(), or empty when none.
+    const std::string &name() const { return name_; }
+
+    // Forget matches of segments in the given file, when its locations are reused.
+    void forget_file(int fd);
+
+    // Take matches found by background thread. Returns true when all segments
+    // given to start() are scanned, and the number of matches is within the limit.
+    bool poll();
+
+    // Matches of segment, or nullptr when not scanned yet.
+    const Matches *find(const Key &key) const;
+
+    // Find matches of segment in its bytes, and remember them.
+    // References stay valid until the segment is forgotten.
+    const Matches &scan(const Key &key, std::string_view bytes);
+
+    // Total number of matches found, in all segments scanned so far.
+    size_t count() const { return count_; }
+
+private:
+    struct KeyHash {
+        size_t operator()(const Key &key) const
+        {
+            return std::hash<long>()(key.offset) ^ ((size_t)key.fd << 48) ^
+                   ((size_t)key.len << 24);
+        }
+    };
+
+    // Find all matches in bytes of segment.
+    static void find_all(const SearchPattern &pattern, std::string_view bytes, Matches &matches);
+
+    std::string name_;                                 // name of the pattern
+    std::unique_ptr<SearchPattern> pattern_;           // for scan()
+    std::unique_ptr<SearchPattern> worker_pattern_;    // for background thread
+    std::unordered_map<Key, Matches, KeyHash> table_;  // matches by segment
+    size_t count_{ 0 };                                // matches in table_
+    std::vector<Key> keys_;                            // segments for background thread
+    std::vector<Matches> results_;                     // matches found by background thread
+    size_t taken_{ 0 };                                // results moved into table_
+    std::atomic<size_t> done_{ 0 };                    // results ready
+    std::atomic<size_t> found_{ 0 };                   // matches found by background thread
+    std::atomic<bool> stop_{ false };                  // request to stop background thread
+    std::thread thread_;                               // background scan
+};
+
+#endif // MATCH_INDEX_H
@@ -0,0 +1,136 @@
+#include "newline_scanner.h"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+namespace {
+
+//
+// Reference implementation: one byte at a time.
+// Offsets are counted from data minus base.
+//
+void scan_scalar_from(const char *data, size_t len, size_t base, std::vector<unsigned> &positions)
+{
+    for (size_t i = 0; i < len; ++i) {
+        if (data[i] == '\n')
+            positions.push_back(base + i);
+    }
+}
+
+void scan_scalar(const char *data, size_t len, std::vector<unsigned> &positions)
+{
+    scan_scalar_from(data, len, 0, positions);
+}
+
+void scan_memchr(const char *data, size_t len, std::vector<unsigned> &positions)
+{
+    const char *end = data + len;
+    for (const char *ptr = data; ptr < end; ++ptr) {
+        ptr = static_cast<const char *>(memchr(ptr, '\n', end - ptr));
+        if (!ptr)
+            break;
+        positions.push_back(ptr - data);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+//
+// Append offsets of bits set in the mask.
+//
+inline void push_mask(unsigned mask, size_t base, std::vector<unsigned> &positions)
+{
+    while (mask) {
+        positions.push_back(base + __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+__attribute__((target("sse2"))) void scan_sse2(const char *data, size_t len,
+                                               std::vector<unsigned> &positions)
+{
+    const __m128i newline = _mm_set1_epi8('\n');
+    size_t i              = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        push_mask(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)), i, positions);
+    }
+    scan_scalar_from(data + i, len - i, i, positions);
+}
+
+__attribute__((target("avx2"))) void scan_avx2(const char *data, size_t len,
+                                               std::vector<unsigned> &positions)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    size_t i              = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        push_mask(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)), i, positions);
+    }
+    scan_scalar_from(data + i, len - i, i, positions);
+}
+#endif // HAVE_X86_SIMD
+
+} // namespace
+
+//
+// Use given method. Unsupported method falls back to memchr().
+//
+NewlineScanner::NewlineScanner(Method method) : method_(method), scan_(scan_memchr)
+{
+    if (!is_supported(method)) {
+        method_ = MEMCHR;
+    }
+    switch (method_) {
+    case SCALAR:
+        scan_ = scan_scalar;
+        break;
+#ifdef HAVE_X86_SIMD
+    case SSE2:
+        scan_ = scan_sse2;
+        break;
+    case AVX2:
+        scan_ = scan_avx2;
+        break;
+#endif
+    default:
+        scan_ = scan_memchr;
+        break;
+    }
+}
+
+//
+// Check whether the processor supports given method.
+//
+bool NewlineScanner::is_supported(Method method)
+{
+    switch (method) {
+    case SCALAR:
+    case MEMCHR:
+        return true;
+#ifdef HAVE_X86_SIMD
+    case SSE2:
+        return __builtin_cpu_supports("sse2");
+    case AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+//
+// Fastest method supported by this processor.
+//
+NewlineScanner::Method NewlineScanner::best_method()
+{
+    static const Method best = is_supported(AVX2)   ? AVX2
+                               : is_supported(SSE2) ? SSE2
+                                                    : MEMCHR;
+    return best;
+}
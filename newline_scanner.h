@@ -0,0 +1,51 @@
+#ifndef NEWLINE_SCANNER_H
+#define NEWLINE_SCANNER_H
+
+#include <cstddef>
+#include <vector>
+
+//
+// NewlineScanner class - finds positions of newline characters in a buffer,
+// many at a time. Used by the file loader to compute line lengths in bulk.
+//
+// Implementation is selected at runtime: AVX2 or SSE2 on x86 processors
+// which support them, memchr() elsewhere. Byte-by-byte scalar loop is kept
+// as a reference.
+//
+class NewlineScanner {
+public:
+    enum Method {
+        SCALAR, // one byte at a time
+        MEMCHR, // library memchr()
+        SSE2,   // 16 bytes per step
+        AVX2,   // 32 bytes per step
+    };
+
+    // Use the fastest method supported by this processor.
+    NewlineScanner() : NewlineScanner(best_method()) {}
+
+    // Use given method. Unsupported method falls back to memchr().
+    explicit NewlineScanner(Method method);
+
+    // Append offsets of all newlines in data[0..len) to positions.
+    void scan(const char *data, size_t len, std::vector<unsigned> &positions) const
+    {
+        scan_(data, len, positions);
+    }
+
+    Method method() const { return method_; }
+
+    // Check whether the processor supports given method.
+    static bool is_supported(Method method);
+
+    // Fastest method supported by this processor.
+    static Method best_method();
+
+private:
+    using ScanFunc = void (*)(const char *data, size_t len, std::vector<unsigned> &positions);
+
+    Method method_;
+    ScanFunc scan_;
+};
+
+#endif // NEWLINE_SCANNER_H
@@ -1,18 +1,60 @@
+#include <ncurses.h>
+#include <poll.h>
 #include <signal.h>
+#include <unistd.h>
+
+#include <thread>
 
 #include "editor.h"
+#include "regex_search.h"
+#include "text_search.h"
+
+//
+// Parse substitute command: c/old/new/ or c/old/new/g.
+// It has its own letter, as s/dir/name is a save to another file.
+// Backslash before slash makes it a part of the text; other escapes are kept
+// for the regular expression. Returns false when the command has another form.
+//
+static bool parse_substitute(const std::string &cmd, std::string &old_text,
+                             std::string &new_text, bool &global)
+{
+    if (cmd.size() < 4 || cmd[0] != 'c' || cmd[1] != '/')
+        return false;
+
+    std::string fields[2];
+    size_t pos = 2;
+    for (std::string &field : fields) {
+        for (; pos < cmd.size() && cmd[pos] != '/'; ++pos) {
+            if (cmd[pos] == '\\' && pos + 1 < cmd.size()) {
+                if (cmd[pos + 1] != '/')
+                    field += '\\';
+                ++pos;
+            }
+            field += cmd[pos];
+        }
+        if (pos == cmd.size())
+            return false;
+        ++pos; // skip the slash
+    }
+    std::string flags = cmd.substr(pos);
+    if (flags != "" && flags != "g")
+        return false;
+
+    old_text = fields[0];
+    new_text = fields[1];
+    global   = (flags == "g");
+    return true;
+}
 
 //
 // Navigate to specified line number.
 //
 void Editor::goto_line(int line_number)
 {
-    auto total = wksp_->total_line_count();
-
     if (line_number < 0)
         line_number = 0;
-    if (line_number >= total)
-        line_number = total - 1;
+    if (!wksp_->has_line(line_number))
+        line_number = wksp_->total_line_count() - 1;
     if (line_number < 0)
         line_number = 0;
 
@@ -23,6 +65,37 @@ void Editor::goto_line(int line_number)
     ensure_cursor_visible();
 }
 
+//
+// Navigate to specified byte offset in file.
+// Cursor is placed on the character at that offset.
+//
+void Editor::goto_offset(long offset)
+{
+    put_line(); // Offsets must account for pending modifications
+    wksp_->finish_indexing();
+
+    if (offset < 0)
+        offset = 0;
+    int line_number = wksp_->offset_to_line(offset);
+    if (line_number >= wksp_->total_line_count()) {
+        // Beyond end of file: stay at the last line
+        goto_line(line_number);
+        return;
+    }
+    long col = offset - wksp_->line_to_offset(line_number);
+
+    wksp_->view.topline = line_number;
+    cursor_line_        = 0;
+    // Only set horizontal offset if the position is far to the right
+    if (col > ncols_ - 10) {
+        wksp_->view.basecol = (int)col - (ncols_ - 10);
+    } else {
+        wksp_->view.basecol = 0;
+    }
+    cursor_col_ = (int)col - wksp_->view.basecol;
+    ensure_cursor_visible();
+}
+
 //
 // Backend editing method: Handle backspace operation.
 //
@@ -55,7 +128,6 @@ void Editor::edit_backspace()
         cursor_line_ = cursor_line_ > 0 ? cursor_line_ - 1 : 0;
         cursor_col_  = prev.size();
     }
-    put_line();
     ensure_cursor_visible();
 }
 
@@ -73,7 +145,7 @@ void Editor::edit_delete()
     if (actual_col < current_line_.size()) {
         current_line_.erase(actual_col, 1);
         current_line_modified_ = true;
-    } else if (cur_line + 1 < wksp_->total_line_count()) {
+    } else if (wksp_->has_line(cur_line + 1)) {
         // Join with next line
         // Preserve current line before loading next
         std::string curr = current_line_;
@@ -88,10 +160,36 @@ void Editor::edit_delete()
         // Place cursor at the join point (end of original current line)
         cursor_col_ = (int)actual_col;
     }
-    put_line();
     ensure_cursor_visible();
 }
 
+//
+// Backend editing method: Revert the last change, or apply it again on redo.
+// Cursor goes to the first changed line.
+//
+void Editor::edit_undo(bool redo)
+{
+    put_line(); // Pending edit of the current line is the last change
+
+    int line = redo ? wksp_->redo() : wksp_->undo();
+    if (line < 0) {
+        status_ = redo ? "Nothing to redo" : "Nothing to undo";
+        return;
+    }
+    current_line_no_ = -1; // Line buffer is stale
+
+    if (line >= wksp_->view.topline && line < wksp_->view.topline + nlines_ - 1 &&
+        wksp_->has_line(line)) {
+        // Changed line is on screen
+        cursor_line_ = line - wksp_->view.topline;
+        cursor_col_  = 0;
+        ensure_cursor_visible();
+    } else {
+        goto_line(line);
+    }
+    status_ = redo ? "Redone" : "Undone";
+}
+
 //
 // Backend editing method: Handle enter/newline operation.
 //
@@ -152,7 +250,6 @@ void Editor::edit_tab()
     current_line_.insert(actual_col, 4, ' ');
     cursor_col_ += 4;
     current_line_modified_ = true;
-    put_line();
     ensure_cursor_visible();
 }
 
@@ -193,7 +290,6 @@ void Editor::edit_insert_char(char ch)
         cursor_col_++;
     }
     current_line_modified_ = true;
-    put_line();
     ensure_cursor_visible();
 }
 
@@ -261,10 +357,14 @@ void Editor::move_down()
 int Editor::current_line_length() const
 {
     int cur_line = wksp_->view.topline + cursor_line_;
-    if (cur_line < 0 || cur_line >= wksp_->total_line_count()) {
+    if (cur_line == current_line_no_ && current_line_modified_) {
+        // Line is being edited
+        return (int)current_line_.size();
+    }
+    if (!wksp_->has_line(cur_line)) {
         return 0;
     }
-    return (int)wksp_->read_line(cur_line).size();
+    return (int)wksp_->read_line_view(cur_line).size();
 }
 
 //
@@ -277,122 +377,108 @@ size_t Editor::get_actual_col() const
 
 //
 // Search forward for text pattern.
+// Wraps around to the beginning of file.
 //
 bool Editor::search_forward(const std::string &needle)
 {
-    int start_line = wksp_->view.topline + cursor_line_;
-    int start_col  = wksp_->view.basecol + cursor_col_;
-    auto total     = wksp_->total_line_count();
-
-    // Search from current position forward
-    for (int i = start_line; i < total; ++i) {
-        std::string line = wksp_->read_line(i);
-        size_t pos       = (i == start_line) ? (size_t)start_col : 0;
-        pos              = line.find(needle, pos);
-        if (pos != std::string::npos) {
-            // Found it - position cursor
-            wksp_->view.topline = i;
-            cursor_line_        = 0;
-            // Only set horizontal offset if the match is far to the right
-            if (pos > (size_t)(ncols_ - 10)) {
-                wksp_->view.basecol = (int)pos - (ncols_ - 10);
-            } else {
-                wksp_->view.basecol = 0;
-            }
-            cursor_col_ = (int)pos - wksp_->view.basecol;
-            ensure_cursor_visible();
-            status_ = std::string("Found: ") + needle;
-            return true;
-        }
-    }
-
-    // Wrap around to beginning
-    for (int i = 0; i <= start_line; ++i) {
-        std::string line = wksp_->read_line(i);
-        size_t pos       = 0;
-        if (i == start_line) {
-            pos = line.find(needle, (size_t)start_col);
-            if (pos == std::string::npos)
-                continue;
-        } else {
-            pos = line.find(needle);
-        }
-        if (pos != std::string::npos) {
-            wksp_->view.topline = i;
-            cursor_line_        = 0;
-            // Only set horizontal offset if the match is far to the right
-            if (pos > (size_t)(ncols_ - 10)) {
-                wksp_->view.basecol = (int)pos - (ncols_ - 10);
-            } else {
-                wksp_->view.basecol = 0;
-            }
-            cursor_col_ = (int)pos - wksp_->view.basecol;
-            ensure_cursor_visible();
-            status_ = std::string("Found: ") + needle;
-            return true;
-        }
-    }
-
-    status_ = std::string("Not found: ") + needle;
-    return false;
+    put_line(); // Search must see the line being edited
+    wksp_->finish_indexing();
+
+    const SearchPattern *pattern = compile_search(needle);
+    if (!pattern)
+        return false;
+
+    // Wraps around to the start position
+    int line   = wksp_->view.topline + cursor_line_;
+    int col    = wksp_->view.basecol + cursor_col_;
+    bool found = wksp_->find_forward(*pattern, line, col, true, &interrupt_flag_);
+    return show_match(found, line, col, needle);
 }
 
 //
 // Search backward for text pattern.
+// Wraps around to the end of file.
 //
 bool Editor::search_backward(const std::string &needle)
 {
-    int start_line = wksp_->view.topline + cursor_line_;
-    int start_col  = wksp_->view.basecol + cursor_col_;
-    auto total     = wksp_->total_line_count();
+    put_line(); // Search must see the line being edited
+    wksp_->finish_indexing();
+
+    const SearchPattern *pattern = compile_search(needle);
+    if (!pattern)
+        return false;
+
+    // Wraps around to the start position
+    int line   = wksp_->view.topline + cursor_line_;
+    int col    = wksp_->view.basecol + cursor_col_;
+    bool found = wksp_->find_backward(*pattern, line, col, true, &interrupt_flag_);
+    return show_match(found, line, col, needle);
+}
 
-    // Search from current position backward
-    for (int i = start_line; i >= 0; --i) {
-        std::string line = wksp_->read_line(i);
-        size_t pos       = std::string::npos;
-        if (i == start_line) {
-            pos = line.rfind(needle, (size_t)start_col);
-        } else {
-            pos = line.rfind(needle);
-        }
-        if (pos != std::string::npos) {
-            wksp_->view.topline = i;
-            cursor_line_        = 0;
-            // Only set horizontal offset if the match is far to the right
-            if (pos > (size_t)(ncols_ - 10)) {
-                wksp_->view.basecol = (int)pos - (ncols_ - 10);
-            } else {
-                wksp_->view.basecol = 0;
+//
+// Get compiled search pattern for the needle: a regular expression
+// or a fixed string, depending on the mode. The last one is kept,
+// so that repeated searches don't compile it again.
+// Unless disabled, all matches of it are indexed in background.
+// Returns nullptr and reports the error when nothing can match.
+//
+const SearchPattern *Editor::compile_search(const std::string &needle, bool index)
+{
+    if (!search_pattern_ || needle != search_pattern_text_ ||
+        regex_search_ != search_pattern_regex_) {
+        if (regex_search_) {
+            auto regex = std::make_unique<RegexSearch>(needle);
+            if (!regex->valid()) {
+                status_ = "Bad pattern: " + regex->error();
+                search_pattern_.reset();
+                return nullptr;
             }
-            cursor_col_ = (int)pos - wksp_->view.basecol;
-            ensure_cursor_visible();
-            status_ = std::string("Found: ") + needle;
-            return true;
+            search_pattern_ = std::move(regex);
+        } else if (needle.find('\n') != std::string::npos) {
+            // Match never crosses a line
+            status_ = "Not found: " + needle;
+            search_pattern_.reset();
+            return nullptr;
+        } else {
+            search_pattern_ = std::make_unique<SubstringSearch>(needle);
         }
+        search_pattern_text_  = needle;
+        search_pattern_regex_ = regex_search_;
     }
 
-    // Wrap around to end
-    for (int i = total - 1; i > start_line; --i) {
-        std::string line = wksp_->read_line(i);
-        size_t pos       = line.rfind(needle);
-        if (pos != std::string::npos) {
-            wksp_->view.topline = i;
-            cursor_line_        = 0;
-            // Only set horizontal offset if the match is far to the right
-            if (pos > (size_t)(ncols_ - 10)) {
-                wksp_->view.basecol = (int)pos - (ncols_ - 10);
-            } else {
-                wksp_->view.basecol = 0;
-            }
-            cursor_col_ = (int)pos - wksp_->view.basecol;
-            ensure_cursor_visible();
-            status_ = std::string("Found: ") + needle;
-            return true;
-        }
+    // All matches are indexed in background, for n/N and the status line
+    if (index)
+        wksp_->index_matches(*search_pattern_, (regex_search_ ? "r:" : "l:") + needle);
+    return search_pattern_.get();
+}
+
+//
+// Position cursor at the match found, or report that there is none.
+//
+bool Editor::show_match(bool found, int line, int col, const std::string &needle)
+{
+    if (!found && interrupt_flag_) {
+        interrupt_flag_ = false;
+        status_         = "Search interrupted";
+        return false;
+    }
+    if (!found) {
+        status_ = std::string("Not found: ") + needle;
+        return false;
     }
 
-    status_ = std::string("Not found: ") + needle;
-    return false;
+    wksp_->view.topline = line;
+    cursor_line_        = 0;
+    // Only set horizontal offset if the match is far to the right
+    if (col > ncols_ - 10) {
+        wksp_->view.basecol = col - (ncols_ - 10);
+    } else {
+        wksp_->view.basecol = 0;
+    }
+    cursor_col_ = col - wksp_->view.basecol;
+    ensure_cursor_visible();
+    status_ = std::string("Found: ") + needle;
+    return true;
 }
 
 //
@@ -400,14 +486,9 @@ bool Editor::search_backward(const std::string &needle)
 //
 bool Editor::search_next()
 {
-    if (!last_search_.empty()) {
-        if (last_search_forward_) {
-            return search_forward(last_search_);
-        } else {
-            return search_backward(last_search_);
-        }
-    }
-    return false;
+    if (last_search_.empty())
+        return false;
+    return search_again(last_search_forward_);
 }
 
 //
@@ -415,14 +496,221 @@ bool Editor::search_next()
 //
 bool Editor::search_prev()
 {
-    if (!last_search_.empty()) {
-        if (last_search_forward_) {
-            return search_backward(last_search_);
+    if (last_search_.empty())
+        return false;
+    return search_again(!last_search_forward_);
+}
+
+//
+// Find the match next to the one under cursor.
+// When all matches are indexed, it is taken from the index;
+// otherwise the text is searched from the position past the cursor.
+//
+bool Editor::search_again(bool forward)
+{
+    put_line(); // Search must see the line being edited
+    wksp_->finish_indexing();
+
+    const SearchPattern *pattern = compile_search(last_search_);
+    if (!pattern)
+        return false;
+
+    int line = wksp_->view.topline + cursor_line_;
+    int col  = wksp_->view.basecol + cursor_col_;
+    bool found;
+    if (wksp_->matches_indexed()) {
+        found = wksp_->next_match(line, col, forward);
+    } else if (forward) {
+        col++;
+        found = wksp_->find_forward(*pattern, line, col, true, &interrupt_flag_);
+    } else {
+        if (col > 0) {
+            col--;
+        } else if (line > 0) {
+            line--;
+            col = INT_MAX;
         } else {
-            return search_forward(last_search_);
+            // Wrap around to the end of file
+            line = INT_MAX;
+            col  = INT_MAX;
+        }
+        found = wksp_->find_backward(*pattern, line, col, true, &interrupt_flag_);
+    }
+    return show_match(found, line, col, last_search_);
+}
+
+//
+// Replace matches of old text by new text: the first one in every line,
+// or all of them when global. With a count, as many lines from the cursor
+// are changed, otherwise the whole file.
+//
+void Editor::substitute(const std::string &old_text, const std::string &new_text, bool global)
+{
+    put_line(); // Substitute must see the line being edited
+    wksp_->finish_indexing();
+    if (old_text.empty()) {
+        status_ = "Nothing to replace";
+        return;
+    }
+    if (new_text.find('\n') != std::string::npos) {
+        // Lines are never split by substitute
+        status_ = "Cannot replace by newline";
+        return;
+    }
+    const SearchPattern *pattern = compile_search(old_text, false);
+    if (!pattern)
+        return;
+
+    long first = 0, last = wksp_->total_line_count();
+    if (params_.count > 0) {
+        first = wksp_->view.topline + cursor_line_;
+        last  = first + params_.count;
+    }
+    long replaced;
+    long lines = wksp_->substitute(*pattern, new_text, global, first, last, replaced,
+                                   &interrupt_flag_);
+    current_line_no_ = -1; // Line buffer is stale
+
+    if (interrupt_flag_) {
+        interrupt_flag_ = false;
+        status_         = "Substitute interrupted";
+    } else if (lines == 0) {
+        status_ = std::string("Not found: ") + old_text;
+    } else {
+        status_ = "Replaced " + std::to_string(replaced) + " in " + std::to_string(lines) +
+                  (lines == 1 ? " line" : " lines");
+    }
+}
+
+//
+// Move to the first match of /text or ?text being typed in command mode.
+// A longer text can only match where its prefix did, so the search
+// starts at the match found for the previous keystroke; when there
+// was none, nothing can be found now either. Regular expressions
+// are searched from the start position every time.
+// Called after every key in command mode. Search is cancelled when
+// another key is pressed, and skipped when keys were typed ahead:
+// only the last text matters.
+//
+void Editor::incremental_search()
+{
+    if (!cmd_mode_ || area_selection_mode_ || cmd_.empty() || (cmd_[0] != '/' && cmd_[0] != '?'))
+        return;
+
+    if (!isearch_active_) {
+        isearch_active_      = true;
+        isearch_topline_     = wksp_->view.topline;
+        isearch_basecol_     = wksp_->view.basecol;
+        isearch_cursor_line_ = cursor_line_;
+        isearch_cursor_col_  = cursor_col_;
+        isearch_steps_.clear();
+    }
+    std::string needle = cmd_.substr(1);
+    bool forward       = (cmd_[0] == '/');
+
+    // Forget searches for the text which was erased
+    bool erased = false;
+    while (!isearch_steps_.empty()) {
+        const std::string &prev = isearch_steps_.back().needle;
+        if (regex_search_ ? prev == needle : needle.compare(0, prev.size(), prev) == 0)
+            break;
+        isearch_steps_.pop_back();
+        erased = true;
+    }
+    if (needle.empty()) {
+        finish_incremental_search(false);
+        return;
+    }
+    if (!isearch_steps_.empty() && isearch_steps_.back().needle == needle) {
+        // Searched already
+        if (erased)
+            show_isearch_step(isearch_steps_.back());
+        return;
+    }
+    if (input_pending())
+        return;
+
+    int line, col;
+    if (isearch_steps_.empty()) {
+        line = isearch_topline_ + isearch_cursor_line_;
+        col  = isearch_basecol_ + isearch_cursor_col_;
+    } else if (!isearch_steps_.back().found) {
+        isearch_steps_.push_back({ needle, false, 0, 0 });
+        return;
+    } else {
+        line = isearch_steps_.back().line;
+        col  = isearch_steps_.back().col;
+    }
+
+    put_line(); // Search must see the line being edited
+    wksp_->finish_indexing();
+    const SearchPattern *pattern = compile_search(needle, false);
+    if (!pattern) {
+        // Regular expression is not complete yet
+        status_.clear();
+        return;
+    }
+
+    // Watch for keys pressed while searching; the pipe stops the watcher
+    std::atomic<bool> cancel{ false };
+    int wakeup[2];
+    std::thread watcher;
+    if (stdscr && inputfile_ == 0 && pipe(wakeup) == 0) {
+        watcher = std::thread([this, &cancel, &wakeup]() {
+            struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { wakeup[0], POLLIN, 0 } };
+            while (poll(fds, 2, 100) >= 0 && !fds[1].revents) {
+                if (fds[0].revents || interrupt_flag_) {
+                    cancel = true;
+                    break;
+                }
+            }
+        });
+    }
+    bool found = forward ? wksp_->find_forward(*pattern, line, col, true, &cancel)
+                         : wksp_->find_backward(*pattern, line, col, true, &cancel);
+    if (watcher.joinable()) {
+        if (write(wakeup[1], "", 1) < 0) {
+            // Watcher stops by itself on the next key
         }
+        watcher.join();
+        close(wakeup[0]);
+        close(wakeup[1]);
     }
-    return false;
+    if (cancel)
+        return;
+
+    isearch_steps_.push_back({ needle, found, line, col });
+    if (found)
+        show_isearch_step(isearch_steps_.back());
+}
+
+//
+// Leave incremental search. When accepted, the cursor is put at the match
+// of the longest text searched, so that the final search starts there.
+// Otherwise the view is restored.
+//
+void Editor::finish_incremental_search(bool accept)
+{
+    if (!isearch_active_)
+        return;
+
+    if (accept && !isearch_steps_.empty() && isearch_steps_.back().found) {
+        show_isearch_step(isearch_steps_.back());
+    } else {
+        wksp_->view.topline = isearch_topline_;
+        wksp_->view.basecol = isearch_basecol_;
+        cursor_line_        = isearch_cursor_line_;
+        cursor_col_         = isearch_cursor_col_;
+    }
+}
+
+//
+// Put cursor at the match of incremental search.
+//
+void Editor::show_isearch_step(const IsearchStep &step)
+{
+    show_match(true, step.line, step.col, step.needle);
+    status_.clear();
 }
 
 // Core line operations matching prototype behavior
@@ -514,8 +802,7 @@ void Editor::combineline(int line, int col)
     if (line < 0 || col < 0)
         return;
 
-    auto total = wksp_->total_line_count();
-    if (line + 1 >= total)
+    if (!wksp_->has_line(line + 1))
         return; // No next line to combine
 
     put_line();
@@ -596,6 +883,8 @@ void Editor::exit_command_mode(bool clear_area_selection, bool clear_filter)
     }
     cmd_.clear();
     params_.reset();
+    isearch_active_ = false;
+    isearch_steps_.clear();
 }
 
 //
@@ -663,6 +952,8 @@ void Editor::execute_command(const std::string &cmd)
 
     // Parse numeric count if command starts with a number
     std::string remaining_cmd = cmd;
+    std::string old_text, new_text;
+    bool global = false;
     if (!cmd.empty() && cmd[0] >= '0' && cmd[0] <= '9') {
         size_t i = 0;
         while (i < cmd.size() && cmd[i] >= '0' && cmd[i] <= '9') {
@@ -686,7 +977,7 @@ void Editor::execute_command(const std::string &cmd)
         status_    = "Saving changes and exiting";
     } else if (remaining_cmd == "r") {
         // Redraw screen
-        wksp_redraw();
+        redraw_screen();
         status_ = "Redrawn";
     } else if (remaining_cmd.size() >= 2 && remaining_cmd.substr(0, 2) == "w ") {
         // w + to make writable (or other w commands)
@@ -699,6 +990,9 @@ void Editor::execute_command(const std::string &cmd)
         }
     } else if (remaining_cmd == "s") {
         save_file();
+    } else if (parse_substitute(remaining_cmd, old_text, new_text, global)) {
+        // c/old/new/[g] - replace text, in given number of lines or in the whole file
+        substitute(old_text, new_text, global);
     } else if (remaining_cmd.size() > 1 && remaining_cmd[0] == 's' && remaining_cmd[1] != ' ') {
         // s<filename> - save as
         std::string new_filename = remaining_cmd.substr(1);
@@ -767,6 +1061,12 @@ void Editor::execute_command(const std::string &cmd)
         if (ln < 1)
             ln = 1;
         goto_line(ln - 1);
+    } else if (remaining_cmd.size() > 1 && remaining_cmd[0] == 'b' && remaining_cmd[1] >= '0' &&
+               remaining_cmd[1] <= '9') {
+        // goto byte offset: b<offset>
+        long offset = std::atol(remaining_cmd.c_str() + 1);
+        goto_offset(offset);
+        status_ = std::string("Goto offset ") + std::to_string(offset);
     } else if (remaining_cmd.size() > 1 && remaining_cmd[0] == '/') {
         // search: /text
         std::string needle = remaining_cmd.substr(1);
@@ -784,10 +1084,7 @@ void Editor::execute_command(const std::string &cmd)
             search_backward(needle);
         }
     } else if (remaining_cmd == "n") {
-        if (last_search_forward_)
-            search_next();
-        else
-            search_prev();
+        search_next();
     } else if (remaining_cmd.size() == 2 && remaining_cmd[0] == '>' && remaining_cmd[1] >= 'a' &&
                remaining_cmd[1] <= 'z') {
         // Save macro buffer: >x (saves current clipboard to named buffer)
@@ -0,0 +1,803 @@
+#include "regex_search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+const size_t MAX_NODES = 100000; // limit of NFA size
+const int MAX_COUNT    = 1000;   // limit of {n,m}
+
+} // namespace
+
+//
+// Compile the pattern into NFA, and find its fixed prefix.
+//
+RegexSearch::RegexSearch(const std::string &pattern) : pattern_(pattern), prefilter_("")
+{
+    Fragment whole = parse_alternation();
+    if (error_.empty() && pos_ < pattern_.size()) {
+        error_ = "Unmatched )";
+    }
+    if (error_.empty() && nodes_.size() > MAX_NODES) {
+        error_ = "Pattern too large";
+    }
+    if (!error_.empty()) {
+        nodes_.clear();
+        sets_.clear();
+        return;
+    }
+
+    nodes_[whole.end].out = add_node(Node::MATCH);
+    start_                = whole.start;
+
+    find_literal();
+    prefilter_ = SubstringSearch(literal_);
+
+    unanchored_.unanchored = true;
+    reset_dfa(anchored_);
+    reset_dfa(unanchored_);
+}
+
+//
+// alternation: concatenation ('|' concatenation)*
+//
+RegexSearch::Fragment RegexSearch::parse_alternation()
+{
+    Fragment result = parse_concatenation();
+    while (error_.empty() && pos_ < pattern_.size() && pattern_[pos_] == '|') {
+        pos_++;
+        result = alternate(result, parse_concatenation());
+    }
+    return result;
+}
+
+//
+// concatenation: repetition*
+//
+RegexSearch::Fragment RegexSearch::parse_concatenation()
+{
+    Fragment result = empty_fragment();
+    while (error_.empty() && pos_ < pattern_.size() && pattern_[pos_] != '|' &&
+           pattern_[pos_] != ')') {
+        result = concat(result, parse_repetition());
+    }
+    return result;
+}
+
+//
+// repetition: atom ('*' | '+' | '?' | '{n}' | '{n,}' | '{n,m}')*
+// Counted repetition parses the atom again for every copy.
+//
+RegexSearch::Fragment RegexSearch::parse_repetition()
+{
+    size_t atom_pos = pos_;
+    Fragment result = parse_atom();
+
+    while (error_.empty() && pos_ < pattern_.size()) {
+        char c = pattern_[pos_];
+        if (c == '*' || c == '+' || c == '?') {
+            pos_++;
+            result = repeat(result, c != '+', c != '?');
+            continue;
+        }
+        if (c != '{')
+            break;
+
+        // Counted repetition
+        pos_++;
+        int min_count = 0, max_count = 0;
+        if (!parse_count(min_count)) {
+            error_ = "Bad repetition";
+            break;
+        }
+        max_count = min_count;
+        if (pos_ < pattern_.size() && pattern_[pos_] == ',') {
+            pos_++;
+            max_count = -1;
+            if (pos_ < pattern_.size() && pattern_[pos_] != '}' && !parse_count(max_count)) {
+                error_ = "Bad repetition";
+                break;
+            }
+        }
+        if (pos_ >= pattern_.size() || pattern_[pos_] != '}' ||
+            (max_count >= 0 && max_count < min_count)) {
+            error_ = "Bad repetition";
+            break;
+        }
+        size_t end_pos = ++pos_;
+
+        // Required copies, then optional ones, or a star
+        Fragment atom = result;
+        result        = empty_fragment();
+        int copies    = std::max(min_count, max_count);
+        for (int i = 0; i < copies || (max_count < 0 && i <= min_count); ++i) {
+            if (i > 0) {
+                pos_ = atom_pos;
+                atom = parse_atom();
+            }
+            if (i >= min_count) {
+                atom = repeat(atom, true, max_count < 0);
+            }
+            result = concat(result, atom);
+            if (nodes_.size() > MAX_NODES) {
+                error_ = "Pattern too large";
+                return result;
+            }
+        }
+        pos_ = end_pos;
+    }
+    return result;
+}
+
+//
+// Parse decimal number of repetitions.
+//
+bool RegexSearch::parse_count(int &count)
+{
+    size_t start = pos_;
+    count        = 0;
+    while (pos_ < pattern_.size() && isdigit((unsigned char)pattern_[pos_])) {
+        count = count * 10 + (pattern_[pos_++] - '0');
+        if (count > MAX_COUNT)
+            return false;
+    }
+    return pos_ > start;
+}
+
+//
+// atom: '(' alternation ')' | '[' class ']' | '.' | '^' | '$' | '\' char | char
+//
+RegexSearch::Fragment RegexSearch::parse_atom()
+{
+    if (pos_ >= pattern_.size()) {
+        error_ = "Nothing to repeat";
+        return empty_fragment();
+    }
+
+    char c = pattern_[pos_++];
+    switch (c) {
+    case '(': {
+        Fragment inner = parse_alternation();
+        if (error_.empty() && (pos_ >= pattern_.size() || pattern_[pos_] != ')')) {
+            error_ = "Unmatched (";
+        }
+        pos_++;
+        return inner;
+    }
+    case '[':
+        return bytes_fragment(parse_class());
+    case '.': {
+        sets_.emplace_back(256, true);
+        sets_.back()['\n'] = false;
+        return bytes_fragment(sets_.size() - 1);
+    }
+    case '^':
+    case '$': {
+        Fragment result = empty_fragment();
+        int node        = add_node(c == '^' ? Node::BOL : Node::EOL, result.start);
+        return { node, result.end };
+    }
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+        error_ = "Nothing to repeat";
+        return empty_fragment();
+    case '\\':
+        return bytes_fragment(parse_escape(false));
+    default:
+        sets_.emplace_back(256, false);
+        sets_.back()[(unsigned char)c] = true;
+        return bytes_fragment(sets_.size() - 1);
+    }
+}
+
+//
+// Parse escape sequence after backslash, and return index of its byte set.
+//
+int RegexSearch::parse_escape(bool in_class)
+{
+    if (pos_ >= pattern_.size()) {
+        error_ = "Trailing backslash";
+        sets_.emplace_back(256, false);
+        return sets_.size() - 1;
+    }
+
+    char c = pattern_[pos_++];
+    std::vector<bool> set(256, false);
+    int (*predicate)(int) = nullptr;
+    switch (tolower(c)) {
+    case 'd':
+        predicate = isdigit;
+        break;
+    case 'w':
+        predicate = [](int ch) -> int { return isalnum(ch) || ch == '_'; };
+        break;
+    case 's':
+        predicate = isspace;
+        break;
+    }
+    if (predicate) {
+        // Upper case letter means complement
+        for (int ch = 0; ch < 256; ++ch) {
+            set[ch] = (predicate(ch) != 0) == (islower((unsigned char)c) != 0);
+        }
+    } else if (c == 't' && !in_class) {
+        set['\t'] = true;
+    } else {
+        set[(unsigned char)c] = true;
+    }
+    set['\n'] = false;
+    sets_.push_back(std::move(set));
+    return sets_.size() - 1;
+}
+
+//
+// Parse character class after '[', and return index of its byte set.
+//
+int RegexSearch::parse_class()
+{
+    std::vector<bool> set(256, false);
+    bool complement = false;
+    if (pos_ < pattern_.size() && pattern_[pos_] == '^') {
+        complement = true;
+        pos_++;
+    }
+
+    bool first = true;
+    for (;;) {
+        if (pos_ >= pattern_.size()) {
+            error_ = "Unmatched [";
+            break;
+        }
+        char c = pattern_[pos_++];
+        if (c == ']' && !first)
+            break;
+        first = false;
+
+        if (c == '\\') {
+            // Escape adds a byte or a predefined class
+            int index = parse_escape(true);
+            for (int ch = 0; ch < 256; ++ch) {
+                set[ch] = set[ch] || sets_[index][ch];
+            }
+            sets_.pop_back();
+            continue;
+        }
+        unsigned char low = c, high = c;
+        if (pos_ + 1 < pattern_.size() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']') {
+            high = pattern_[pos_ + 1];
+            pos_ += 2;
+        }
+        for (int ch = low; ch <= high; ++ch) {
+            set[ch] = true;
+        }
+    }
+
+    if (complement) {
+        set.flip();
+    }
+    set['\n'] = false;
+    sets_.push_back(std::move(set));
+    return sets_.size() - 1;
+}
+
+//
+// Find fixed string which is a part of every match: the longest run
+// of literal characters at top level of the pattern. A character followed
+// by a repetition which allows zero copies is excluded, and one followed
+// by '+' ends the run. The run at start of pattern, after optional '^',
+// is preferred when not shorter, as it gives the start of match too.
+//
+void RegexSearch::find_literal()
+{
+    std::string run, longest;
+    bool at_start = true; // run is at start of pattern
+    int depth     = 0;
+    size_t i      = (!pattern_.empty() && pattern_[0] == '^') ? 1 : 0;
+
+    auto end_run = [&]() {
+        if (at_start) {
+            literal_           = run;
+            literal_is_prefix_ = true;
+        } else if (run.size() > longest.size()) {
+            longest = run;
+        }
+        run.clear();
+        at_start = false;
+    };
+
+    while (i < pattern_.size()) {
+        char c = pattern_[i];
+        if (c == '|' && depth == 0) {
+            // Alternatives have nothing in common
+            literal_.clear();
+            literal_is_prefix_ = false;
+            return;
+        }
+        if (c == '[') {
+            // Skip class, where ']' may come first
+            i += (i + 1 < pattern_.size() && pattern_[i + 1] == '^') ? 2 : 1;
+            while (++i < pattern_.size() && pattern_[i] != ']') {
+                if (pattern_[i] == '\\')
+                    i++;
+            }
+            i++;
+            end_run();
+            continue;
+        }
+        size_t len = (c == '\\') ? 2 : 1;
+        if (depth > 0 || c == '(' || c == ')' || (c != '\\' && strchr(".*+?{}^$", c)) ||
+            (c == '\\' && (i + 1 >= pattern_.size() || strchr("dDwWsSt", pattern_[i + 1])))) {
+            // Not a literal character
+            depth += (c == '(') - (c == ')');
+            i += len;
+            if (c == '{') {
+                // Skip count of repetition
+                while (i < pattern_.size() && pattern_[i++] != '}') {
+                }
+            }
+            end_run();
+            continue;
+        }
+        if (c == '\\')
+            c = pattern_[i + 1];
+        i += len;
+
+        // Character may be repeated zero times
+        char next = (i < pattern_.size()) ? pattern_[i] : '\0';
+        if (next == '*' || next == '?' || next == '{') {
+            end_run();
+            continue;
+        }
+        run += c;
+        if (next == '+')
+            end_run();
+    }
+    end_run();
+
+    if (longest.size() > literal_.size()) {
+        literal_           = longest;
+        literal_is_prefix_ = false;
+    }
+    if (literal_.empty()) {
+        literal_is_prefix_ = false;
+    }
+}
+
+//
+// Add node to NFA, and return its index.
+//
+int RegexSearch::add_node(Node::Kind kind, int out, int out1)
+{
+    nodes_.push_back({ kind, out, out1, -1 });
+    return nodes_.size() - 1;
+}
+
+RegexSearch::Fragment RegexSearch::bytes_fragment(int set)
+{
+    int end   = add_node(Node::EMPTY);
+    int start = add_node(Node::BYTES, end);
+
+    nodes_[start].set = set;
+    return { start, end };
+}
+
+RegexSearch::Fragment RegexSearch::empty_fragment()
+{
+    int node = add_node(Node::EMPTY);
+    return { node, node };
+}
+
+RegexSearch::Fragment RegexSearch::concat(Fragment a, Fragment b)
+{
+    nodes_[a.end].out = b.start;
+    return { a.start, b.end };
+}
+
+RegexSearch::Fragment RegexSearch::alternate(Fragment a, Fragment b)
+{
+    int end   = add_node(Node::EMPTY);
+    int start = add_node(Node::SPLIT, a.start, b.start);
+
+    nodes_[a.end].out = end;
+    nodes_[b.end].out = end;
+    return { start, end };
+}
+
+//
+// Make fragment optional (?), repeated (+), or both (*).
+//
+RegexSearch::Fragment RegexSearch::repeat(Fragment a, bool optional, bool many)
+{
+    int end   = add_node(Node::EMPTY);
+    int split = add_node(Node::SPLIT, a.start, end);
+
+    nodes_[a.end].out = many ? split : end;
+    return { optional ? split : a.start, end };
+}
+
+//
+// Forget all DFA states, and build start states again.
+// State 0 is dead: no match is possible anymore.
+//
+void RegexSearch::reset_dfa(Dfa &dfa) const
+{
+    dfa.ids.clear();
+    dfa.sets.clear();
+    dfa.next.clear();
+    dfa.match.clear();
+    dfa.match_eol.clear();
+    add_state(dfa, {});
+
+    std::vector<int> bol, mid;
+    add_closure(bol, start_, true);
+    add_closure(mid, start_, false);
+    dfa.start_bol = add_state(dfa, std::move(bol));
+    dfa.start_mid = add_state(dfa, std::move(mid));
+}
+
+//
+// Add NFA node to the set, with all nodes reachable without consuming a byte.
+// Only BYTES, EOL and MATCH nodes are kept in the set.
+//
+void RegexSearch::add_closure(std::vector<int> &set, int node, bool at_bol) const
+{
+    if (node < 0 || std::find(set.begin(), set.end(), node) != set.end())
+        return;
+
+    const Node &n = nodes_[node];
+    switch (n.kind) {
+    case Node::BYTES:
+    case Node::EOL:
+    case Node::MATCH:
+        set.push_back(node);
+        break;
+    case Node::SPLIT:
+        set.push_back(node);
+        add_closure(set, n.out, at_bol);
+        add_closure(set, n.out1, at_bol);
+        break;
+    case Node::EMPTY:
+        set.push_back(node);
+        add_closure(set, n.out, at_bol);
+        break;
+    case Node::BOL:
+        if (at_bol) {
+            set.push_back(node);
+            add_closure(set, n.out, at_bol);
+        }
+        break;
+    }
+}
+
+//
+// Find or create DFA state for the set of NFA nodes.
+//
+int RegexSearch::add_state(Dfa &dfa, std::vector<int> &&set) const
+{
+    // Keep only nodes which matter for transitions
+    set.erase(std::remove_if(set.begin(), set.end(),
+                             [this](int node) {
+                                 Node::Kind kind = nodes_[node].kind;
+                                 return kind != Node::BYTES && kind != Node::EOL &&
+                                        kind != Node::MATCH;
+                             }),
+              set.end());
+    std::sort(set.begin(), set.end());
+
+    auto found = dfa.ids.find(set);
+    if (found != dfa.ids.end())
+        return found->second;
+
+    // Match now, or at end of line by following EOL nodes
+    bool match = false, match_eol = false;
+    for (int node : set) {
+        if (nodes_[node].kind == Node::MATCH) {
+            match = true;
+        } else if (nodes_[node].kind == Node::EOL) {
+            std::vector<int> after;
+            add_closure(after, nodes_[node].out, false);
+            for (int n : after) {
+                match_eol = match_eol || nodes_[n].kind == Node::MATCH;
+            }
+        }
+    }
+
+    int state = dfa.sets.size();
+    dfa.ids.emplace(set, state);
+    dfa.sets.push_back(std::move(set));
+    dfa.next.resize(dfa.next.size() + 256, -1);
+    dfa.match.push_back(match);
+    dfa.match_eol.push_back(match || match_eol);
+    return state;
+}
+
+//
+// Compute transition by byte, and keep it in the table.
+// Newline leads to the start of the next line. Transitions to match states,
+// and newlines which end a match, are not kept, so that scans find them
+// only on this slow path. When the cache is full, it is flushed,
+// and the state is built again.
+//
+int RegexSearch::next_state(Dfa &dfa, int state, unsigned char c) const
+{
+    if (dfa.sets.size() >= MAX_DFA_STATES) {
+        std::vector<int> current = dfa.sets[state];
+        reset_dfa(dfa);
+        state = add_state(dfa, std::move(current));
+    }
+
+    int target;
+    if (c == '\n') {
+        target = dfa.start_bol;
+    } else {
+        std::vector<int> set;
+        for (int node : dfa.sets[state]) {
+            const Node &n = nodes_[node];
+            if (n.kind == Node::BYTES && sets_[n.set][c]) {
+                add_closure(set, n.out, false);
+            }
+        }
+        if (dfa.unanchored) {
+            // Match may start at any position
+            add_closure(set, start_, false);
+        }
+        target = add_state(dfa, std::move(set));
+    }
+    if (!dfa.match[target] && !(c == '\n' && dfa.match_eol[state])) {
+        dfa.next[state * 256 + c] = target;
+    }
+    return target;
+}
+
+//
+// Start state for the position.
+// Blocks start at a line, so the position is at start of line when it's the first one.
+//
+int RegexSearch::start_state(const Dfa &dfa, const char *data, size_t pos) const
+{
+    return (pos == 0 || data[pos - 1] == '\n') ? dfa.start_bol : dfa.start_mid;
+}
+
+//
+// Check whether a match starts at the position, by anchored DFA.
+//
+bool RegexSearch::matches_at(const char *data, size_t len, size_t pos) const
+{
+    Dfa &dfa        = anchored_;
+    int state       = start_state(dfa, data, pos);
+    const int *next = dfa.next.data();
+    if (dfa.match[state])
+        return true;
+
+    for (; pos < len && data[pos] != '\n'; ++pos) {
+        int target = next[state * 256 + (unsigned char)data[pos]];
+        if (target < 0) {
+            target = next_state(dfa, state, data[pos]);
+            next   = dfa.next.data();
+            if (dfa.match[target])
+                return true;
+        }
+        if (target == 0)
+            return false;
+        state = target;
+    }
+    return dfa.match_eol[state];
+}
+
+//
+// Find the end of the longest match which starts at the position,
+// by anchored DFA: the last state with a match before the automaton dies.
+//
+long RegexSearch::match_end(const char *data, size_t len, size_t pos) const
+{
+    Dfa &dfa  = anchored_;
+    int state = start_state(dfa, data, pos);
+    long end  = dfa.match[state] ? (long)pos : -1;
+
+    for (; pos < len && data[pos] != '\n'; ++pos) {
+        int target = dfa.next[state * 256 + (unsigned char)data[pos]];
+        if (target < 0)
+            target = next_state(dfa, state, data[pos]);
+        if (target == 0)
+            return end;
+        state = target;
+        if (dfa.match[state])
+            end = pos + 1;
+    }
+    return dfa.match_eol[state] ? (long)pos : end;
+}
+
+//
+// Find the leftmost match start in [first, last).
+//
+long RegexSearch::first_start(const char *data, size_t len, size_t first, size_t last) const
+{
+    for (size_t pos = first; pos < last; ++pos) {
+        if (matches_at(data, len, pos))
+            return pos;
+    }
+    return -1;
+}
+
+//
+// Find the rightmost match start in [first, last).
+//
+long RegexSearch::last_start(const char *data, size_t len, size_t first, size_t last) const
+{
+    for (size_t pos = last; pos > first; --pos) {
+        if (matches_at(data, len, pos - 1))
+            return pos - 1;
+    }
+    return -1;
+}
+
+//
+// Scan lines by unanchored DFA from offset from, until a line with a match
+// is found, or until offset end. Returns position to search from in that line,
+// and sets line_end to the offset of its newline (or len).
+//
+long RegexSearch::first_line(const char *data, size_t len, size_t from, size_t end,
+                             size_t &line_end) const
+{
+    Dfa &dfa        = unanchored_;
+    int state       = start_state(dfa, data, from);
+    const int *next = dfa.next.data();
+    size_t found    = from; // position in the matching line
+
+    if (!dfa.match[state]) {
+        size_t pos = from;
+        for (; pos < end; ++pos) {
+            unsigned char c = data[pos];
+            int target      = next[state * 256 + c];
+            if (target < 0) {
+                if (c == '\n' && dfa.match_eol[state])
+                    break;
+                target = next_state(dfa, state, c);
+                next   = dfa.next.data();
+                if (dfa.match[target]) {
+                    // Match ends here, or is empty at start of the next line
+                    pos += (c == '\n');
+                    break;
+                }
+            }
+            state = target;
+        }
+        // Last line may have no newline
+        bool last_eol = end == len && len > 0 && data[len - 1] != '\n' && dfa.match_eol[state];
+        if (pos == end && !last_eol)
+            return -1;
+        found = pos;
+    }
+
+    const void *nl  = memrchr(data + from, '\n', found - from);
+    const void *eol = memchr(data + found, '\n', len - found);
+    line_end        = eol ? (const char *)eol - data : len;
+    return nl ? (const char *)nl - data + 1 : from;
+}
+
+//
+// Find the leftmost match in the line which starts at offset first.
+//
+long RegexSearch::search_line(const char *data, size_t len, size_t first) const
+{
+    const void *eol = memchr(data + first, '\n', len - first);
+    size_t end      = eol ? (const char *)eol - data + 1 : len;
+    size_t line_end;
+    if (first_line(data, len, first, end, line_end) < 0)
+        return -1;
+    return first_start(data, len, first, line_end + 1);
+}
+
+//
+// Find the rightmost match which starts in [first, upto],
+// in the line which starts at offset first.
+//
+long RegexSearch::rsearch_line(const char *data, size_t len, size_t first, size_t upto) const
+{
+    const void *eol = memchr(data + first, '\n', len - first);
+    size_t end      = eol ? (const char *)eol - data + 1 : len;
+    size_t line_end;
+    if (first_line(data, len, first, end, line_end) < 0)
+        return -1;
+    return last_start(data, len, first, std::min(upto, line_end) + 1);
+}
+
+//
+// Find the first match at or after the given offset.
+//
+long RegexSearch::find_from(const char *data, size_t len, size_t from) const
+{
+    if (!valid() || from > len)
+        return -1;
+
+    if (literal_is_prefix_) {
+        // Check candidates found by the prefix
+        for (long pos = prefilter_.find_from(data, len, from); pos >= 0;
+             pos      = prefilter_.find_from(data, len, pos + 1)) {
+            if (matches_at(data, len, pos))
+                return pos;
+        }
+        return -1;
+    }
+
+    if (!literal_.empty()) {
+        // Check lines which contain the literal
+        for (long pos = prefilter_.find_from(data, len, from); pos >= 0;
+             pos      = prefilter_.find_from(data, len, from)) {
+            const void *nl = memrchr(data + from, '\n', pos - from);
+            long found     = search_line(data, len, nl ? (const char *)nl - data + 1 : from);
+            if (found >= 0)
+                return found;
+
+            const void *eol = memchr(data + pos, '\n', len - pos);
+            if (!eol)
+                return -1;
+            from = (const char *)eol - data + 1;
+        }
+        return -1;
+    }
+
+    // Find the line, then the match in it
+    size_t line_end;
+    long line = first_line(data, len, from, len, line_end);
+    if (line < 0)
+        return -1;
+    return first_start(data, len, line, line_end + 1);
+}
+
+//
+// Find the last match which starts at or before the given offset.
+//
+long RegexSearch::rfind_upto(const char *data, size_t len, size_t upto) const
+{
+    if (!valid() || len == 0)
+        return -1;
+    upto = std::min(upto, len - 1);
+
+    if (literal_is_prefix_) {
+        // Check candidates found by the prefix, from the end
+        for (long pos = prefilter_.rfind_upto(data, len, upto); pos >= 0;
+             pos      = (pos > 0) ? prefilter_.rfind_upto(data, len, pos - 1) : -1) {
+            if (matches_at(data, len, pos))
+                return pos;
+        }
+        return -1;
+    }
+
+    // The line of the offset
+    const void *nl    = memrchr(data, '\n', upto);
+    size_t line_start = nl ? (const char *)nl - data + 1 : 0;
+    long found        = rsearch_line(data, len, line_start, upto);
+    if (found >= 0 || line_start == 0)
+        return found;
+
+    if (!literal_.empty()) {
+        // Check lines which contain the literal, from the end
+        for (long pos = prefilter_.rfind_upto(data, len, line_start - 1); pos >= 0;
+             pos      = prefilter_.rfind_upto(data, len, line_start - 1)) {
+            nl         = memrchr(data, '\n', pos);
+            line_start = nl ? (const char *)nl - data + 1 : 0;
+            found      = rsearch_line(data, len, line_start, len);
+            if (found >= 0 || line_start == 0)
+                return found;
+        }
+        return -1;
+    }
+
+    // The last line with a match before it
+    long last = -1;
+    size_t line_end;
+    for (size_t from = 0; from < line_start; from = line_end + 1) {
+        long line = first_line(data, len, from, line_start, line_end);
+        if (line < 0)
+            break;
+        last = line;
+    }
+    if (last < 0)
+        return -1;
+    return rsearch_line(data, len, last, len);
+}
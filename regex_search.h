@@ -0,0 +1,153 @@
+#ifndef REGEX_SEARCH_H
+#define REGEX_SEARCH_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "text_search.h"
+
+//
+// RegexSearch class - finds matches of a regular expression in blocks of raw bytes.
+//
+// Supported syntax, as in POSIX extended regular expressions:
+//      .           any character
+//      [abc] [^a-z]  character class, or its complement
+//      \d \w \s    digit, word character, space; \D \W \S for complements
+//      ^ $         start and end of line
+//      ( | )       grouping and alternatives
+//      * + ? {n} {n,} {n,m}  repetition
+//      \c          character c literally
+// Dot and complemented classes never match newline, so no match crosses a line.
+//
+// The expression is compiled to NFA by Thompson's construction, and a DFA
+// is built from it lazily: a state is a set of NFA states, and transitions
+// are computed on first use and then taken from a table. Two automata are kept:
+// anchored, which matches at a given position, and unanchored, which finds
+// the first line with a match in one pass over the bytes.
+//
+// When every match contains a fixed string, it is found by SubstringSearch
+// first, and only lines which have it are checked by the automata.
+// When the string starts every match, only its positions are checked.
+//
+// Automata are built while searching, so one object must not be used
+// by several threads at once: every thread gets a clone().
+//
+class RegexSearch : public SearchPattern {
+public:
+    explicit RegexSearch(const std::string &pattern);
+
+    // Check whether the pattern was compiled, and get error message otherwise.
+    bool valid() const { return error_.empty(); }
+    const std::string &error() const { return error_; }
+
+    long find_from(const char *data, size_t len, size_t from) const override;
+    long rfind_upto(const char *data, size_t len, size_t upto) const override;
+    long match_end(const char *data, size_t len, size_t pos) const override;
+    std::unique_ptr<SearchPattern> clone() const override
+    {
+        return std::make_unique<RegexSearch>(*this);
+    }
+
+    // Fixed string which is a part of every match, or empty when none.
+    const std::string &literal() const { return literal_; }
+
+    // Every match starts with the literal.
+    bool literal_is_prefix() const { return literal_is_prefix_; }
+
+    // Number of DFA states built so far.
+    size_t dfa_states() const { return anchored_.sets.size() + unanchored_.sets.size(); }
+
+    // DFA cache is flushed when it grows beyond this number of states.
+    static constexpr size_t MAX_DFA_STATES = 2000;
+
+private:
+    // NFA state
+    struct Node {
+        enum Kind {
+            BYTES, // consume a byte from the set, go to out
+            SPLIT, // go to out and out1
+            EMPTY, // go to out
+            BOL,   // at start of line, go to out
+            EOL,   // at end of line, go to out
+            MATCH, // pattern matched
+        };
+        Kind kind;
+        int out{ -1 };
+        int out1{ -1 };
+        int set{ -1 }; // index of byte set for BYTES
+    };
+
+    // Part of NFA under construction: the end is an EMPTY node with open exit.
+    struct Fragment {
+        int start;
+        int end;
+    };
+
+    // Lazily built DFA
+    struct Dfa {
+        bool unanchored{ false };            // start state is added after every byte
+        std::map<std::vector<int>, int> ids; // state by its set of NFA nodes
+        std::vector<std::vector<int>> sets;  // NFA nodes of every state
+        std::vector<int> next;               // 256 transitions per state, -1 when not built
+        std::vector<char> match;             // pattern matched before the current byte
+        std::vector<char> match_eol;         // pattern matched, when at end of line
+        int start_bol{ -1 };                 // start state at start of line
+        int start_mid{ -1 };                 // start state inside of line
+    };
+
+    // Parser
+    Fragment parse_alternation();
+    Fragment parse_concatenation();
+    Fragment parse_repetition();
+    Fragment parse_atom();
+    int parse_class();
+    int parse_escape(bool in_class);
+    bool parse_count(int &count);
+    void find_literal();
+
+    // Construction of NFA
+    int add_node(Node::Kind kind, int out = -1, int out1 = -1);
+    Fragment bytes_fragment(int set);
+    Fragment empty_fragment();
+    Fragment concat(Fragment a, Fragment b);
+    Fragment alternate(Fragment a, Fragment b);
+    Fragment repeat(Fragment a, bool optional, bool many);
+
+    // Lazy DFA
+    void reset_dfa(Dfa &dfa) const;
+    void add_closure(std::vector<int> &set, int node, bool at_bol) const;
+    int add_state(Dfa &dfa, std::vector<int> &&set) const;
+    int next_state(Dfa &dfa, int state, unsigned char c) const;
+    int start_state(const Dfa &dfa, const char *data, size_t pos) const;
+
+    // Check whether a match starts at the position.
+    bool matches_at(const char *data, size_t len, size_t pos) const;
+
+    // Find leftmost (or rightmost, up to a limit) match start in the line [first, last).
+    long first_start(const char *data, size_t len, size_t first, size_t last) const;
+    long last_start(const char *data, size_t len, size_t first, size_t last) const;
+
+    // Find the first line with a match by unanchored DFA. Returns its start, or -1.
+    long first_line(const char *data, size_t len, size_t from, size_t end,
+                    size_t &line_end) const;
+
+    // Find the leftmost, or the rightmost match which starts in [first, upto]
+    // of the line with offset first.
+    long search_line(const char *data, size_t len, size_t first) const;
+    long rsearch_line(const char *data, size_t len, size_t first, size_t upto) const;
+
+    std::string pattern_;                 // source text
+    size_t pos_{ 0 };                     // parser position
+    std::string error_;                   // compilation error
+    std::vector<Node> nodes_;             // NFA
+    std::vector<std::vector<bool>> sets_; // byte sets of BYTES nodes
+    int start_{ -1 };                     // NFA start node
+    std::string literal_;                 // fixed part of every match
+    bool literal_is_prefix_{ false };     // every match starts with literal_
+    SubstringSearch prefilter_;           // finds literal_
+    mutable Dfa anchored_;                // matches at a position
+    mutable Dfa unanchored_;              // matches anywhere in the line
+};
+
+#endif // REGEX_SEARCH_H
@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <utility>
 
@@ -9,7 +10,7 @@
 // Constructor with parameters.
 //
 Segment::Segment(int file_descriptor_, unsigned line_count_, long file_offset_,
-                 std::vector<unsigned short> &&line_lengths_)
+                 LineLengths &&line_lengths_)
     : line_count(line_count_), file_descriptor(file_descriptor_), file_offset(file_offset_),
       line_lengths(std::move(line_lengths_))
 {
@@ -24,12 +25,7 @@ Segment::Segment(int file_descriptor_, unsigned line_count_, long file_offset_,
 //
 long Segment::total_byte_count() const
 {
-    long total_bytes = 0;
-
-    for (int i = 0; i < line_count; ++i) {
-        total_bytes += line_lengths[i];
-    }
-    return total_bytes;
+    return line_lengths.total();
 }
 
 //
@@ -38,11 +34,7 @@ long Segment::total_byte_count() const
 //
 long Segment::calculate_line_offset(int rel_line) const
 {
-    long seek_pos = file_offset;
-    for (int i = 0; i < rel_line; ++i) {
-        seek_pos += line_lengths[i];
-    }
-    return seek_pos;
+    return file_offset + line_lengths.offset_of(rel_line);
 }
 
 //
@@ -50,67 +42,45 @@ long Segment::calculate_line_offset(int rel_line) const
 // Returns empty string for empty lines, blank segments, or read errors.
 //
 std::string Segment::read_line_content(int rel_line) const
+{
+    std::string result;
+    read_line_view(rel_line, result);
+    return result;
+}
+
+//
+// Read line content into caller's buffer, reusing its capacity.
+// Empty lines and blank segments give an empty view without touching the buffer.
+//
+std::string_view Segment::read_line_view(int rel_line, std::string &buf) const
 {
     // Validate relative line is within bounds
     if (rel_line < 0 || rel_line >= static_cast<int>(line_lengths.size())) {
-        return "";
+        return {};
     }
 
     // Get line length
-    int line_len = line_lengths[rel_line];
+    long line_len = line_lengths[rel_line];
     if (line_len <= 0) {
-        return "";
+        return {};
     }
 
     // Handle empty lines and blank segments
     if (line_len == 1 || file_descriptor < 0) {
-        return "";
+        return {};
     }
 
     // Calculate file offset for this line
     long seek_pos = calculate_line_offset(rel_line);
 
     // Read line content from file (excluding newline)
-    std::string result(line_len - 1, '\0');
-    if (result.size() > 0 && lseek(file_descriptor, seek_pos, SEEK_SET) >= 0) {
-        read(file_descriptor, &result[0], result.size());
-    }
-    return result;
-}
-
-//
-// Write segment content to output file descriptor.
-// Returns true on success, false on error (seek or write failure).
-//
-bool Segment::write_content(int out_fd) const
-{
-    // Calculate total bytes for this segment
-    long total_bytes = total_byte_count();
-
-    if (file_descriptor > 0) {
-        // Read from source file and write to output
-        if (lseek(file_descriptor, file_offset, SEEK_SET) < 0) {
-            // Failed to seek - file may have been unlinked
-            return false;
-        }
-
-        char buffer[8192];
-        while (total_bytes > 0) {
-            int to_read = (total_bytes < (long)sizeof(buffer)) ? total_bytes : sizeof(buffer);
-            int nread   = read(file_descriptor, buffer, to_read);
-            if (nread <= 0) {
-                break;
-            }
-
-            write(out_fd, buffer, nread);
-            total_bytes -= nread;
-        }
-    } else {
-        // Empty lines - write newlines
-        std::string newlines(total_bytes, '\n');
-        write(out_fd, newlines.data(), newlines.size());
+    buf.resize(line_len - 1);
+    ssize_t nread = pread(file_descriptor, &buf[0], buf.size(), seek_pos);
+    if (nread < (ssize_t)buf.size()) {
+        // Short read: clear the rest, as the buffer holds data of previous lines
+        std::fill(buf.begin() + (nread > 0 ? nread : 0), buf.end(), '\0');
     }
-    return true;
+    return buf;
 }
 
 //
@@ -118,9 +88,10 @@ bool Segment::write_content(int out_fd) const
 //
 bool Segment::can_merge_with(const Segment &other) const
 {
-    // Segments must be from the same file, and together have < 127 lines
+    // Segments must be from the same file, and together fit into size limits
     return file_descriptor > 0 && file_descriptor == other.file_descriptor &&
-           (line_count + other.line_count) < 127;
+           line_count + other.line_count <= MAX_LINES &&
+           total_byte_count() + other.total_byte_count() <= MAX_BYTES;
 }
 
 //
@@ -138,8 +109,8 @@ bool Segment::is_adjacent_to(const Segment &other) const
 void Segment::merge_with(const Segment &other)
 {
     // Combine data into this segment
-    for (unsigned short byte : other.line_lengths) {
-        line_lengths.push_back(byte);
+    for (long len : other.line_lengths) {
+        line_lengths.push_back(len);
     }
     line_count += other.line_count;
 }
@@ -155,10 +126,12 @@ void Segment::debug_print(std::ostream &out) const
         << "file_offset=" << file_offset << ", "
         << "line_lengths={";
 
-    for (int i = 0; i < line_count; ++i) {
-        if (i > 0)
+    bool first = true;
+    for (long len : line_lengths) {
+        if (!first)
             out << ",";
-        out << line_lengths[i];
+        out << len;
+        first = false;
     }
 
     out << "}\n";
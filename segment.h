@@ -4,12 +4,19 @@
 #include <cstddef>
 #include <list>
 #include <ostream>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "line_lengths.h"
+
+template <bool Const>
+class SegmentTreeIterator;
+
 class Segment {
 public:
     // Use iterators instead of pointers.
-    using iterator = std::list<Segment>::iterator;
+    using iterator = SegmentTreeIterator<false>;
 
     // Each segment contains a non-zero number of text lines.
     unsigned line_count{ 0 };
@@ -28,13 +35,19 @@ public:
     long file_offset{ 0 };
 
     // Line lengths, including "\n".
-    std::vector<unsigned short> line_lengths;
+    LineLengths line_lengths;
+
+    // Size limits for a segment. Unmodified text is kept in large segments,
+    // to keep the segment tree small; small segments appear only around edits.
+    // Checkpoints of line_lengths keep lookups inside a large segment cheap.
+    static constexpr unsigned MAX_LINES = 4096;
+    static constexpr long MAX_BYTES     = 256 * 1024;
 
     // Constructor.
     Segment() = default;
 
     Segment(int file_descriptor, unsigned line_count, long file_offset = 0,
-            std::vector<unsigned short> &&line_lengths = {});
+            LineLengths &&line_lengths = {});
 
     // Segment has contents when it comes from some file or contains only newlines.
 
@@ -49,9 +62,9 @@ public:
     // Returns empty string for empty lines, blank segments, or read errors.
     std::string read_line_content(int rel_line) const;
 
-    // Write segment content to output file descriptor.
-    // Returns true on success, false on error (seek or write failure).
-    bool write_content(int out_fd) const;
+    // Read line content into caller's buffer, reusing its capacity.
+    // Returns view of the line (excluding newline), valid while buffer is unchanged.
+    std::string_view read_line_view(int rel_line, std::string &buf) const;
 
     // Check if this segment can be merged with another segment.
     bool can_merge_with(const Segment &other) const;
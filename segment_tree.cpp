@@ -0,0 +1,425 @@
+#include "segment_tree.h"
+
+SegmentTree::~SegmentTree()
+{
+    clear();
+}
+
+SegmentTree::SegmentTree(SegmentTree &&other) noexcept : root_(other.root_), seed_(other.seed_)
+{
+    other.root_ = nullptr;
+}
+
+SegmentTree &SegmentTree::operator=(SegmentTree &&other) noexcept
+{
+    if (this != &other) {
+        clear();
+        root_       = other.root_;
+        seed_       = other.seed_;
+        other.root_ = nullptr;
+    }
+    return *this;
+}
+
+//
+// Remove all segments.
+//
+void SegmentTree::clear()
+{
+    destroy(root_);
+    root_ = nullptr;
+}
+
+//
+// Delete all nodes of the subtree.
+//
+void SegmentTree::destroy(SegmentNode *node)
+{
+    while (node) {
+        // Descend into right subtree iteratively, recurse into left one.
+        destroy(node->left);
+        SegmentNode *right = node->right;
+        delete node;
+        node = right;
+    }
+}
+
+//
+// Create a node with fresh priority and cached totals.
+//
+SegmentNode *SegmentTree::make_node(Segment &&seg)
+{
+    // Xorshift generator: cheap and good enough for treap priorities.
+    seed_ ^= seed_ << 13;
+    seed_ ^= seed_ >> 17;
+    seed_ ^= seed_ << 5;
+
+    auto node       = new SegmentNode(std::move(seg));
+    node->priority  = seed_;
+    node->seg_bytes = node->seg.total_byte_count();
+    pull(node);
+    return node;
+}
+
+//
+// Recompute totals of the node from its children.
+//
+void SegmentTree::pull(SegmentNode *node)
+{
+    node->count = 1;
+    node->lines = node->seg.line_count;
+    node->bytes = node->seg_bytes;
+    if (node->left) {
+        node->count += node->left->count;
+        node->lines += node->left->lines;
+        node->bytes += node->left->bytes;
+    }
+    if (node->right) {
+        node->count += node->right->count;
+        node->lines += node->right->lines;
+        node->bytes += node->right->bytes;
+    }
+}
+
+//
+// Split tree t into first k segments (l) and the rest (r).
+// Parent links of the returned roots are left for the caller to reset.
+//
+void SegmentTree::split(SegmentNode *t, size_t k, SegmentNode *&l, SegmentNode *&r)
+{
+    if (!t) {
+        l = r = nullptr;
+        return;
+    }
+    size_t left_count = t->left ? t->left->count : 0;
+    if (left_count < k) {
+        split(t->right, k - left_count - 1, t->right, r);
+        if (t->right)
+            t->right->parent = t;
+        l = t;
+    } else {
+        split(t->left, k, l, t->left);
+        if (t->left)
+            t->left->parent = t;
+        r = t;
+    }
+    pull(t);
+}
+
+//
+// Concatenate trees l and r, keeping heap order of priorities.
+//
+SegmentNode *SegmentTree::merge(SegmentNode *l, SegmentNode *r)
+{
+    if (!l)
+        return r;
+    if (!r)
+        return l;
+    if (l->priority > r->priority) {
+        l->right         = merge(l->right, r);
+        l->right->parent = l;
+        pull(l);
+        return l;
+    }
+    r->left         = merge(l, r->left);
+    r->left->parent = r;
+    pull(r);
+    return r;
+}
+
+SegmentNode *SegmentTree::leftmost(SegmentNode *node)
+{
+    if (node) {
+        while (node->left)
+            node = node->left;
+    }
+    return node;
+}
+
+SegmentNode *SegmentTree::rightmost(SegmentNode *node)
+{
+    if (node) {
+        while (node->right)
+            node = node->right;
+    }
+    return node;
+}
+
+//
+// Next node in order, or nullptr after the last one.
+//
+SegmentNode *SegmentTree::successor(SegmentNode *node)
+{
+    if (node->right)
+        return leftmost(node->right);
+    while (node->parent && node->parent->right == node)
+        node = node->parent;
+    return node->parent;
+}
+
+//
+// Previous node in order, or nullptr before the first one.
+//
+SegmentNode *SegmentTree::predecessor(SegmentNode *node)
+{
+    if (node->left)
+        return rightmost(node->left);
+    while (node->parent && node->parent->left == node)
+        node = node->parent;
+    return node->parent;
+}
+
+//
+// Compute the position of the segment at pos in the sequence.
+//
+size_t SegmentTree::index_of(const_iterator pos) const
+{
+    SegmentNode *node = pos.node();
+    if (!node)
+        return size();
+
+    size_t index = node->left ? node->left->count : 0;
+    for (; node->parent; node = node->parent) {
+        if (node->parent->right == node) {
+            SegmentNode *sibling = node->parent->left;
+            index += 1 + (sibling ? sibling->count : 0);
+        }
+    }
+    return index;
+}
+
+//
+// Compute the line number of the first line in the segment at pos.
+//
+long SegmentTree::base_line(const_iterator pos) const
+{
+    SegmentNode *node = pos.node();
+    if (!node)
+        return total_lines();
+
+    long line = node->left ? node->left->lines : 0;
+    for (; node->parent; node = node->parent) {
+        if (node->parent->right == node) {
+            SegmentNode *sibling = node->parent->left;
+            line += node->parent->seg.line_count + (sibling ? sibling->lines : 0);
+        }
+    }
+    return line;
+}
+
+//
+// Compute the byte offset of the first line in the segment at pos.
+//
+long SegmentTree::base_offset(const_iterator pos) const
+{
+    SegmentNode *node = pos.node();
+    if (!node)
+        return total_bytes();
+
+    long offset = node->left ? node->left->bytes : 0;
+    for (; node->parent; node = node->parent) {
+        if (node->parent->right == node) {
+            SegmentNode *sibling = node->parent->left;
+            offset += node->parent->seg_bytes + (sibling ? sibling->bytes : 0);
+        }
+    }
+    return offset;
+}
+
+//
+// Descend from the root to the node containing the specified line.
+//
+SegmentNode *SegmentTree::locate_line(long line_no, long &base_line) const
+{
+    SegmentNode *node = root_;
+    long base         = 0;
+
+    if (line_no < 0 || line_no >= total_lines())
+        return nullptr;
+
+    while (node) {
+        long left_lines = node->left ? node->left->lines : 0;
+        if (line_no < base + left_lines) {
+            node = node->left;
+        } else if (line_no < base + left_lines + (long)node->seg.line_count) {
+            base_line = base + left_lines;
+            return node;
+        } else {
+            base += left_lines + node->seg.line_count;
+            node = node->right;
+        }
+    }
+    return nullptr;
+}
+
+//
+// Find segment containing the specified line.
+//
+SegmentTree::iterator SegmentTree::find_line(long line_no, long &base_line)
+{
+    return iterator(locate_line(line_no, base_line), this);
+}
+
+SegmentTree::const_iterator SegmentTree::find_line(long line_no, long &base_line) const
+{
+    return const_iterator(locate_line(line_no, base_line), this);
+}
+
+//
+// Find segment containing the specified byte offset.
+//
+SegmentTree::const_iterator SegmentTree::find_offset(long offset, long &base_line,
+                                                     long &base_offset) const
+{
+    SegmentNode *node = root_;
+    long line         = 0;
+    long bytes        = 0;
+
+    if (offset < 0 || offset >= total_bytes())
+        return end();
+
+    while (node) {
+        long left_bytes = node->left ? node->left->bytes : 0;
+        long left_lines = node->left ? node->left->lines : 0;
+        if (offset < bytes + left_bytes) {
+            node = node->left;
+        } else if (offset < bytes + left_bytes + node->seg_bytes) {
+            base_line   = line + left_lines;
+            base_offset = bytes + left_bytes;
+            return const_iterator(node, this);
+        } else {
+            line += left_lines + node->seg.line_count;
+            bytes += left_bytes + node->seg_bytes;
+            node = node->right;
+        }
+    }
+    return end();
+}
+
+//
+// Insert segment before pos.
+//
+SegmentTree::iterator SegmentTree::insert(const_iterator pos, Segment &&seg)
+{
+    SegmentNode *node = make_node(std::move(seg));
+    SegmentNode *l, *r;
+
+    split(root_, index_of(pos), l, r);
+    root_         = merge(merge(l, node), r);
+    root_->parent = nullptr;
+    return iterator(node, this);
+}
+
+//
+// Erase one segment.
+//
+SegmentTree::iterator SegmentTree::erase(const_iterator pos)
+{
+    auto next = pos;
+    ++next;
+    return erase(pos, next);
+}
+
+//
+// Erase a range of segments.
+//
+SegmentTree::iterator SegmentTree::erase(const_iterator first, const_iterator last)
+{
+    size_t from = index_of(first);
+    size_t to   = index_of(last);
+    if (from >= to)
+        return iterator(last.node(), this);
+
+    SegmentNode *head, *middle, *tail;
+    split(root_, to, head, tail);
+    split(head, from, head, middle);
+    destroy(middle);
+
+    root_ = merge(head, tail);
+    if (root_)
+        root_->parent = nullptr;
+    return iterator(last.node(), this);
+}
+
+//
+// Move all segments from the list before pos.
+//
+SegmentTree::iterator SegmentTree::splice(const_iterator pos, std::list<Segment> &segments)
+{
+    if (segments.empty())
+        return iterator(pos.node(), this);
+
+    // Build a tree of the new segments.
+    SegmentNode *chunk = nullptr;
+    SegmentNode *first = nullptr;
+    for (auto &seg : segments) {
+        SegmentNode *node = make_node(std::move(seg));
+        if (!first)
+            first = node;
+        chunk         = merge(chunk, node);
+        chunk->parent = nullptr;
+    }
+    segments.clear();
+
+    SegmentNode *l, *r;
+    split(root_, index_of(pos), l, r);
+    root_         = merge(merge(l, chunk), r);
+    root_->parent = nullptr;
+    return iterator(first, this);
+}
+
+//
+// Move range of segments into a separate tree.
+// Nodes are relinked as a whole subtree, without copying.
+//
+SegmentTree SegmentTree::extract(const_iterator first, const_iterator last)
+{
+    SegmentTree result;
+    size_t from = index_of(first);
+    size_t to   = index_of(last);
+    if (from >= to)
+        return result;
+
+    SegmentNode *head, *middle, *tail;
+    split(root_, to, head, tail);
+    split(head, from, head, middle);
+
+    root_ = merge(head, tail);
+    if (root_)
+        root_->parent = nullptr;
+    middle->parent = nullptr;
+    result.root_   = middle;
+    return result;
+}
+
+//
+// Move all segments of the other tree before pos.
+//
+SegmentTree::iterator SegmentTree::splice(const_iterator pos, SegmentTree &other)
+{
+    if (other.empty())
+        return iterator(pos.node(), this);
+
+    SegmentNode *first = leftmost(other.root_);
+    SegmentNode *l, *r;
+    split(root_, index_of(pos), l, r);
+    root_         = merge(merge(l, other.root_), r);
+    root_->parent = nullptr;
+    other.root_   = nullptr;
+    return iterator(first, this);
+}
+
+//
+// Refresh cached totals after the segment at pos was modified in place.
+//
+void SegmentTree::update(const_iterator pos)
+{
+    SegmentNode *node = pos.node();
+    if (!node)
+        return;
+
+    node->seg_bytes = node->seg.total_byte_count();
+    for (; node; node = node->parent) {
+        pull(node);
+    }
+}
@@ -0,0 +1,238 @@
+#ifndef SEGMENT_TREE_H
+#define SEGMENT_TREE_H
+
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <type_traits>
+#include <utility>
+
+#include "segment.h"
+
+//
+// Node of the segment tree.
+// Besides the segment itself, every node caches totals of its subtree,
+// so that lookups by line number or byte offset take O(log n) steps.
+//
+struct SegmentNode {
+    Segment seg;
+
+    SegmentNode *left{ nullptr };
+    SegmentNode *right{ nullptr };
+    SegmentNode *parent{ nullptr };
+
+    unsigned priority{ 0 }; // heap priority of the treap
+    long seg_bytes{ 0 };    // cached seg.total_byte_count()
+    size_t count{ 1 };      // number of segments in subtree
+    long lines{ 0 };        // number of lines in subtree
+    long bytes{ 0 };        // number of bytes in subtree
+
+    explicit SegmentNode(Segment &&s) : seg(std::move(s)) {}
+};
+
+class SegmentTree;
+
+//
+// Bidirectional iterator over segments, in file order.
+// Like std::list iterators, it stays valid until the segment is erased.
+//
+template <bool Const>
+class SegmentTreeIterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type        = Segment;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = typename std::conditional<Const, const Segment *, Segment *>::type;
+    using reference         = typename std::conditional<Const, const Segment &, Segment &>::type;
+
+    SegmentTreeIterator() = default;
+    SegmentTreeIterator(SegmentNode *node, const SegmentTree *tree) : node_(node), tree_(tree) {}
+
+    // Allow conversion from iterator to const_iterator.
+    template <bool C = Const, typename = typename std::enable_if<C>::type>
+    SegmentTreeIterator(const SegmentTreeIterator<false> &other)
+        : node_(other.node()), tree_(other.tree())
+    {
+    }
+
+    reference operator*() const { return node_->seg; }
+    pointer operator->() const { return &node_->seg; }
+
+    SegmentTreeIterator &operator++();
+    SegmentTreeIterator &operator--();
+    SegmentTreeIterator operator++(int)
+    {
+        auto tmp = *this;
+        ++*this;
+        return tmp;
+    }
+    SegmentTreeIterator operator--(int)
+    {
+        auto tmp = *this;
+        --*this;
+        return tmp;
+    }
+
+    template <bool C>
+    bool operator==(const SegmentTreeIterator<C> &other) const
+    {
+        return node_ == other.node();
+    }
+    template <bool C>
+    bool operator!=(const SegmentTreeIterator<C> &other) const
+    {
+        return node_ != other.node();
+    }
+
+    // Internal access for SegmentTree.
+    SegmentNode *node() const { return node_; }
+    const SegmentTree *tree() const { return tree_; }
+
+private:
+    SegmentNode *node_{ nullptr };       // nullptr for end()
+    const SegmentTree *tree_{ nullptr }; // needed to step back from end()
+};
+
+//
+// SegmentTree class - ordered sequence of segments stored as a treap
+// keyed implicitly by position. Interface resembles std::list<Segment>,
+// plus lookups by line number or byte offset in O(log n).
+//
+class SegmentTree {
+public:
+    using iterator       = SegmentTreeIterator<false>;
+    using const_iterator = SegmentTreeIterator<true>;
+
+    SegmentTree() = default;
+    ~SegmentTree();
+
+    // No copying, but can be moved
+    SegmentTree(const SegmentTree &)            = delete;
+    SegmentTree &operator=(const SegmentTree &) = delete;
+    SegmentTree(SegmentTree &&other) noexcept;
+    SegmentTree &operator=(SegmentTree &&other) noexcept;
+
+    iterator begin() { return iterator(leftmost(root_), this); }
+    iterator end() { return iterator(nullptr, this); }
+    const_iterator begin() const { return const_iterator(leftmost(root_), this); }
+    const_iterator end() const { return const_iterator(nullptr, this); }
+
+    bool empty() const { return root_ == nullptr; }
+    size_t size() const { return root_ ? root_->count : 0; }
+
+    Segment &front() { return leftmost(root_)->seg; }
+    Segment &back() { return rightmost(root_)->seg; }
+
+    // Total number of lines in all segments.
+    long total_lines() const { return root_ ? root_->lines : 0; }
+
+    // Total number of bytes in all segments.
+    long total_bytes() const { return root_ ? root_->bytes : 0; }
+
+    // Remove all segments.
+    void clear();
+
+    // Insert segment before pos. Returns iterator to the inserted segment.
+    iterator insert(const_iterator pos, Segment &&seg);
+
+    // Append segment at the end.
+    template <typename... Args>
+    iterator emplace_back(Args &&...args)
+    {
+        return insert(end(), Segment(std::forward<Args>(args)...));
+    }
+
+    // Erase one segment, or a range of segments.
+    // Returns iterator following the last removed segment.
+    iterator erase(const_iterator pos);
+    iterator erase(const_iterator first, const_iterator last);
+
+    // Move all segments from the list before pos.
+    // Returns iterator to the first inserted segment, or pos when list is empty.
+    iterator splice(const_iterator pos, std::list<Segment> &segments);
+
+    // Move range of segments into a separate tree, in O(log n).
+    // Iterators to the moved segments stay valid.
+    SegmentTree extract(const_iterator first, const_iterator last);
+
+    // Move all segments of the other tree before pos, in O(log n).
+    // Returns iterator to the first inserted segment, or pos when other is empty.
+    iterator splice(const_iterator pos, SegmentTree &other);
+
+    // Refresh cached totals after the segment at pos was modified in place.
+    void update(const_iterator pos);
+
+    // Find segment containing the specified line.
+    // On success, base_line is set to the number of the first line of that segment.
+    // Returns end() when line_no is beyond the last line.
+    iterator find_line(long line_no, long &base_line);
+    const_iterator find_line(long line_no, long &base_line) const;
+
+    // Find segment containing the specified byte offset.
+    // On success, base_line and base_offset are set to the number of the first line
+    // of that segment and to its byte offset. Returns end() when offset is beyond the last byte.
+    const_iterator find_offset(long offset, long &base_line, long &base_offset) const;
+
+    // Compute the line number of the first line in the segment at pos.
+    // For end(), returns total_lines().
+    long base_line(const_iterator pos) const;
+
+    // Compute the byte offset of the first line in the segment at pos.
+    // For end(), returns total_bytes().
+    long base_offset(const_iterator pos) const;
+
+    // Compute the position of the segment at pos in the sequence.
+    // For end(), returns size().
+    size_t index_of(const_iterator pos) const;
+
+    // Tree navigation helpers, used by iterators.
+    static SegmentNode *leftmost(SegmentNode *node);
+    static SegmentNode *rightmost(SegmentNode *node);
+    static SegmentNode *successor(SegmentNode *node);
+    static SegmentNode *predecessor(SegmentNode *node);
+
+    SegmentNode *root() const { return root_; }
+
+private:
+    // Descend from the root to the node containing the specified line.
+    SegmentNode *locate_line(long line_no, long &base_line) const;
+
+    // Create a node with fresh priority and cached totals.
+    SegmentNode *make_node(Segment &&seg);
+
+    // Recompute totals of the node from its children.
+    static void pull(SegmentNode *node);
+
+    // Split tree t into first k segments (l) and the rest (r).
+    static void split(SegmentNode *t, size_t k, SegmentNode *&l, SegmentNode *&r);
+
+    // Concatenate trees l and r.
+    static SegmentNode *merge(SegmentNode *l, SegmentNode *r);
+
+    // Delete all nodes of the subtree.
+    static void destroy(SegmentNode *node);
+
+    SegmentNode *root_{ nullptr };
+    unsigned seed_{ 2463534242u }; // state of priority generator
+};
+
+template <bool Const>
+SegmentTreeIterator<Const> &SegmentTreeIterator<Const>::operator++()
+{
+    node_ = SegmentTree::successor(node_);
+    return *this;
+}
+
+template <bool Const>
+SegmentTreeIterator<Const> &SegmentTreeIterator<Const>::operator--()
+{
+    if (node_) {
+        node_ = SegmentTree::predecessor(node_);
+    } else {
+        // Step back from end() to the last segment.
+        node_ = SegmentTree::rightmost(tree_->root());
+    }
+    return *this;
+}
+
+#endif // SEGMENT_TREE_H
@@ -16,6 +16,8 @@ Editor *Editor::instance_ = nullptr;
 //
 void Editor::save_state()
 {
+    put_line(); // Commit pending edit
+
     std::ofstream out(tmpname_.c_str());
     if (out) {
         out << filename_ << '\n';
@@ -101,6 +103,9 @@ void Editor::setup_signal_handlers()
     signal(SIGILL, handle_fatal_signal);
     signal(SIGBUS, handle_fatal_signal);
 
+    // Guard mapped files against truncation; other faults still reach handle_fatal_signal
+    Filemap::install_sigbus_guard();
+
     // SIGINT - interrupt (can be handled gracefully)
     signal(SIGINT, handle_sigint);
 }
@@ -113,6 +118,9 @@ void Editor::handle_fatal_signal(int sig)
     // Close ncurses cleanly
     if (instance_) {
         endwin();
+
+        // Write buffered lines, so that temp file is consistent
+        instance_->tempfile_.flush();
     }
 
     // Print error message
@@ -177,6 +185,25 @@ int Editor::journal_read_key()
     }
 }
 
+//
+// Check whether more keys were typed and not read yet.
+// Keys replayed from journal are never pending, so that replay
+// repeats the same steps.
+//
+bool Editor::input_pending()
+{
+    if (inputfile_ > 0 || !stdscr)
+        return false;
+
+    timeout(0);
+    int ch = getch();
+    timeout(200);
+    if (ch == ERR)
+        return false;
+    ungetch(ch);
+    return true;
+}
+
 //
 // Record key press to journal file.
 //
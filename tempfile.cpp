@@ -2,10 +2,69 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <list>
 #include <vector>
 
+namespace {
+
+//
+// Create unlinked temporary file, return its descriptor or -1.
+//
+int create_temp_file()
+{
+    char template_name[] = "/tmp/v-edit-XXXXXX";
+    int fd               = mkstemp(template_name);
+    if (fd >= 0) {
+        // Unlink immediately so file is deleted when closed
+        unlink(template_name);
+    }
+    return fd;
+}
+
+//
+// Sort extents by offset and merge those which overlap or touch.
+//
+void coalesce(std::vector<Tempfile::Extent> &ranges)
+{
+    std::sort(ranges.begin(), ranges.end(), [](const Tempfile::Extent &a, const Tempfile::Extent &b) {
+        return a.offset < b.offset;
+    });
+
+    size_t count = 0;
+    for (const auto &ext : ranges) {
+        if (count > 0 && ext.offset <= ranges[count - 1].offset + ranges[count - 1].length) {
+            auto &last  = ranges[count - 1];
+            last.length = std::max(last.length, ext.offset + ext.length - last.offset);
+        } else {
+            ranges[count++] = ext;
+        }
+    }
+    ranges.resize(count);
+}
+
+//
+// Find index of the range which contains [offset, offset+length), or -1.
+//
+long find_range(const std::vector<Tempfile::Extent> &ranges, long offset, long length)
+{
+    auto it = std::upper_bound(
+        ranges.begin(), ranges.end(), offset,
+        [](long value, const Tempfile::Extent &ext) { return value < ext.offset; });
+    if (it == ranges.begin()) {
+        return -1;
+    }
+    --it;
+    if (offset + length > it->offset + it->length) {
+        return -1;
+    }
+    return it - ranges.begin();
+}
+
+} // namespace
+
 Tempfile::Tempfile() = default;
 
 Tempfile::~Tempfile()
@@ -22,58 +81,130 @@ bool Tempfile::open_temp_file()
         return true; // Already open
     }
 
-    char template_name[] = "/tmp/v-edit-XXXXXX";
-    tempfile_fd_         = mkstemp(template_name);
+    tempfile_fd_ = create_temp_file();
     if (tempfile_fd_ < 0) {
         return false;
     }
-
-    // Unlink immediately so file is deleted when closed
-    unlink(template_name);
-    tempseek_ = 0;
+    tempseek_             = 0;
+    flushed_              = 0;
+    compact_checked_size_ = 0;
     return true;
 }
 
 //
 // Close temporary file.
+// Buffered data is discarded, as the file is already unlinked.
 //
 void Tempfile::close_temp_file()
 {
+    cancel_compaction();
     if (tempfile_fd_ >= 0) {
         close(tempfile_fd_);
         tempfile_fd_ = -1;
         tempseek_    = 0;
+        flushed_     = 0;
+        pending_.clear();
     }
 }
 
 //
-// Write a line to the temporary file and return a segment for it.
+// Write all buffered data to the file with one system call.
 //
-std::list<Segment> Tempfile::write_line_to_temp(const std::string &line_content)
+bool Tempfile::flush()
 {
-    if (tempfile_fd_ < 0 && !open_temp_file()) {
-        return {};
+    size_t done = 0;
+    while (done < pending_.size()) {
+        ssize_t nwritten =
+            pwrite(tempfile_fd_, pending_.data() + done, pending_.size() - done, flushed_ + done);
+        if (nwritten < 0 && errno == EINTR) {
+            continue;
+        }
+        if (nwritten <= 0) {
+            break;
+        }
+        done += nwritten;
     }
+    pending_.erase(0, done);
+    flushed_ += done;
+    return pending_.empty();
+}
 
-    std::string line = line_content;
+//
+// Flush buffered data when it is older than the flush interval.
+//
+void Tempfile::flush_if_expired()
+{
+    if (!pending_.empty() && std::chrono::steady_clock::now() - pending_since_ >= flush_interval_) {
+        flush();
+    }
+}
+
+//
+// Set size and time thresholds for flushing the buffer.
+//
+void Tempfile::set_flush_limits(size_t nbytes, std::chrono::milliseconds interval)
+{
+    flush_size_     = nbytes;
+    flush_interval_ = interval;
+    flush_if_full();
+}
+
+//
+// Pointer to data at offset when it is still in the buffer, or nullptr.
+//
+const char *Tempfile::unflushed_bytes(long offset, size_t len) const
+{
+    if (offset < flushed_ || offset + (long)len > tempseek_) {
+        return nullptr;
+    }
+    return pending_.data() + (offset - flushed_);
+}
+
+//
+// Append line with trailing newline to the buffer.
+//
+int Tempfile::append_line(const std::string &line_content)
+{
+    if (pending_.empty()) {
+        pending_since_ = std::chrono::steady_clock::now();
+        pending_.reserve(flush_size_);
+    }
+
+    size_t start = pending_.size();
+    pending_ += line_content;
     // Add newline if not present
-    if (line.empty() || line.back() != '\n') {
-        line += '\n';
+    if (line_content.empty() || line_content.back() != '\n') {
+        pending_ += '\n';
     }
 
-    long seek_pos = tempseek_;
-    int nbytes    = line.size();
+    int nbytes = pending_.size() - start;
+    tempseek_ += nbytes;
+    return nbytes;
+}
 
-    // Seek to the correct position before writing
-    if (lseek(tempfile_fd_, seek_pos, SEEK_SET) < 0) {
-        return {};
+//
+// Flush the buffer if it grew beyond the size threshold.
+//
+void Tempfile::flush_if_full()
+{
+    if (pending_.size() >= flush_size_) {
+        flush();
     }
+}
 
-    if (write(tempfile_fd_, line.c_str(), nbytes) != nbytes) {
+//
+// Write a line to the temporary file and return a segment for it.
+// Data goes to the buffer; no system calls unless the buffer is full.
+//
+std::list<Segment> Tempfile::write_line_to_temp(const std::string &line_content)
+{
+    if (tempfile_fd_ < 0 && !open_temp_file()) {
         return {};
     }
 
-    tempseek_ += nbytes;
+    long seek_pos = tempseek_;
+    int nbytes    = append_line(line_content);
+    flush_if_full();
 
     Segment seg;
     seg.line_count      = 1;
@@ -86,6 +217,7 @@ std::list<Segment> Tempfile::write_line_to_temp(const std::string &line_content)
 
 //
 // Write multiple lines to temporary file and return a segment for them.
+// The whole batch is appended to the buffer, and written by at most one flush.
 //
 std::list<Segment> Tempfile::write_lines_to_temp(const std::vector<std::string> &lines)
 {
@@ -97,33 +229,225 @@ std::list<Segment> Tempfile::write_lines_to_temp(const std::vector<std::string>
         return {};
     }
 
-    // Write all lines to temp file
     Segment seg;
     seg.line_count      = lines.size();
     seg.file_descriptor = tempfile_fd_;
     seg.file_offset     = tempseek_;
+    seg.line_lengths.reserve(lines.size());
 
-    // Seek to the correct position before writing
-    if (lseek(tempfile_fd_, tempseek_, SEEK_SET) < 0) {
-        return {};
+    // Append lines and record their sizes
+    for (const std::string &ln : lines) {
+        seg.line_lengths.push_back(append_line(ln));
     }
+    flush_if_full();
 
-    // Write lines and record their sizes
-    for (const std::string &ln : lines) {
-        std::string line = ln;
-        // Add newline if not present
-        if (line.empty() || line.back() != '\n') {
-            line += '\n';
+    return { seg };
+}
+
+//
+// Set thresholds for compaction.
+//
+void Tempfile::set_compaction_limits(long min_size, double dead_ratio)
+{
+    compact_min_size_   = min_size;
+    compact_dead_ratio_ = dead_ratio;
+}
+
+//
+// Check whether the file grew enough since the last check to look for garbage.
+// Collecting live extents costs a walk over all segments, so don't do it too often.
+//
+bool Tempfile::compaction_check_due()
+{
+    if (tempfile_fd_ < 0 || is_compacting() || tempseek_ < compact_min_size_) {
+        return false;
+    }
+    if (tempseek_ - compact_checked_size_ < compact_min_size_ / 4) {
+        return false;
+    }
+    compact_checked_size_ = tempseek_;
+    return true;
+}
+
+//
+// Start compaction when dead bytes exceed the threshold.
+//
+bool Tempfile::begin_compaction(std::vector<Extent> live)
+{
+    if (tempfile_fd_ < 0 || is_compacting()) {
+        return false;
+    }
+
+    coalesce(live);
+    long live_bytes = 0;
+    for (const auto &ext : live) {
+        live_bytes += ext.length;
+    }
+    long dead_bytes = tempseek_ - live_bytes;
+    if (tempseek_ < compact_min_size_ || dead_bytes < compact_dead_ratio_ * tempseek_) {
+        return false;
+    }
+
+    // Live data must be in the file, not in the buffer
+    if (!flush()) {
+        return false;
+    }
+    compact_fd_ = create_temp_file();
+    if (compact_fd_ < 0) {
+        return false;
+    }
+
+    // Ranges are copied in order, so their place in new file is known in advance
+    compact_ranges_ = std::move(live);
+    compact_targets_.clear();
+    compact_seek_ = 0;
+    for (const auto &ext : compact_ranges_) {
+        compact_targets_.push_back(compact_seek_);
+        compact_seek_ += ext.length;
+    }
+    compact_next_ = 0;
+    compact_done_ = 0;
+    return true;
+}
+
+//
+// Copy up to budget bytes of live data into the new file.
+//
+bool Tempfile::compaction_step(long budget)
+{
+    if (!is_compacting()) {
+        return false;
+    }
+    while (compact_next_ < compact_ranges_.size() && budget > 0) {
+        const Extent &ext = compact_ranges_[compact_next_];
+        long nbytes       = std::min(budget, ext.length - compact_done_);
+        if (!copy_bytes(ext.offset + compact_done_, nbytes,
+                        compact_targets_[compact_next_] + compact_done_)) {
+            cancel_compaction();
+            return false;
+        }
+        budget -= nbytes;
+        compact_done_ += nbytes;
+        if (compact_done_ == ext.length) {
+            compact_next_++;
+            compact_done_ = 0;
         }
+    }
+    return compact_next_ == compact_ranges_.size();
+}
 
-        int nbytes = line.size();
-        if (write(tempfile_fd_, line.c_str(), nbytes) != nbytes) {
-            return {};
+//
+// Redirect segments to the new file and drop the old one.
+//
+void Tempfile::finish_compaction(const std::vector<Segment *> &segments)
+{
+    if (!is_compacting()) {
+        return;
+    }
+
+    // Finish copying, in case the caller did not
+    if (!compaction_step(tempseek_)) {
+        if (is_compacting()) {
+            cancel_compaction();
         }
+        return;
+    }
 
-        seg.line_lengths.push_back(nbytes);
-        tempseek_ += nbytes;
+    // Lines written since compaction started are not in the copied ranges
+    if (!flush()) {
+        cancel_compaction();
+        return;
+    }
+    std::vector<Extent> extra;
+    for (const Segment *seg : segments) {
+        long length = seg->total_byte_count();
+        if (find_range(compact_ranges_, seg->file_offset, length) < 0) {
+            extra.push_back({ seg->file_offset, length });
+        }
+    }
+    coalesce(extra);
+    std::vector<long> extra_targets;
+    for (const auto &ext : extra) {
+        if (!copy_bytes(ext.offset, ext.length, compact_seek_)) {
+            cancel_compaction();
+            return;
+        }
+        extra_targets.push_back(compact_seek_);
+        compact_seek_ += ext.length;
     }
 
-    return { seg };
+    // All data is in place: rewrite offsets of segments
+    for (Segment *seg : segments) {
+        long length = seg->total_byte_count();
+        long index  = find_range(compact_ranges_, seg->file_offset, length);
+        if (index >= 0) {
+            seg->file_offset =
+                compact_targets_[index] + seg->file_offset - compact_ranges_[index].offset;
+        } else {
+            index            = find_range(extra, seg->file_offset, length);
+            seg->file_offset = extra_targets[index] + seg->file_offset - extra[index].offset;
+        }
+    }
+
+    // Put new file in place of the old one, keeping the descriptor number
+    dup2(compact_fd_, tempfile_fd_);
+    close(compact_fd_);
+    compact_fd_ = -1;
+
+    tempseek_             = compact_seek_;
+    flushed_              = compact_seek_;
+    compact_checked_size_ = compact_seek_;
+    compact_ranges_.clear();
+    compact_targets_.clear();
+    compact_buf_.clear();
+    compact_buf_.shrink_to_fit();
+}
+
+//
+// Abandon compaction in progress, keeping the old file.
+//
+void Tempfile::cancel_compaction()
+{
+    if (compact_fd_ >= 0) {
+        close(compact_fd_);
+        compact_fd_ = -1;
+    }
+    compact_ranges_.clear();
+    compact_targets_.clear();
+    compact_next_ = 0;
+    compact_done_ = 0;
+}
+
+//
+// Copy bytes from old file into new file.
+//
+bool Tempfile::copy_bytes(long from, long length, long to)
+{
+    compact_buf_.resize(256 * 1024);
+    while (length > 0) {
+        size_t chunk  = std::min<long>(length, compact_buf_.size());
+        ssize_t nread = pread(tempfile_fd_, compact_buf_.data(), chunk, from);
+        if (nread <= 0) {
+            if (nread < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ssize_t done = 0;
+        while (done < nread) {
+            ssize_t nwritten =
+                pwrite(compact_fd_, compact_buf_.data() + done, nread - done, to + done);
+            if (nwritten < 0 && errno == EINTR) {
+                continue;
+            }
+            if (nwritten <= 0) {
+                return false;
+            }
+            done += nwritten;
+        }
+        from += nread;
+        to += nread;
+        length -= nread;
+    }
+    return true;
 }
@@ -1,8 +1,10 @@
 #ifndef TEMPFILE_H
 #define TEMPFILE_H
 
+#include <chrono>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "segment.h"
 
@@ -10,6 +12,14 @@
 // Tempfile class - manages temporary file for storing modified lines.
 // Shared by all workspaces in an editor instance.
 //
+// Appended lines are collected in memory and written in large chunks.
+// The unwritten tail must be read through unflushed_bytes(), or flushed
+// before the file is accessed by descriptor.
+//
+// Data of deleted or replaced lines is reclaimed by compaction: bytes still
+// referenced by segments are copied into a fresh file in small steps, and
+// at the end the segments are redirected to the new file.
+//
 class Tempfile {
 public:
     Tempfile();
@@ -34,9 +44,91 @@ public:
     // Get current file descriptor
     int fd() const { return tempfile_fd_; }
 
+    // Write all buffered data to the file.
+    // Returns false on write error; unwritten data stays in the buffer.
+    bool flush();
+
+    // Flush buffered data when it is older than the flush interval.
+    // Called periodically from the idle loop.
+    void flush_if_expired();
+
+    // Set thresholds: buffer is flushed when it grows beyond the given
+    // size in bytes, or when its data is older than the given interval.
+    void set_flush_limits(size_t nbytes, std::chrono::milliseconds interval);
+
+    // Pointer to data at offset when it is still in the buffer, or nullptr.
+    const char *unflushed_bytes(long offset, size_t len) const;
+
+    // Number of bytes waiting in the buffer.
+    size_t unflushed_size() const { return pending_.size(); }
+
+    // Size of temp file data, including the buffered tail.
+    long size() const { return tempseek_; }
+
+    //
+    // Compaction
+    //
+
+    // Range of bytes in temp file referenced by segments.
+    struct Extent {
+        long offset;
+        long length;
+    };
+
+    // Set thresholds: compaction starts when the file is at least min_size bytes,
+    // and the given fraction of it is not referenced anymore.
+    void set_compaction_limits(long min_size, double dead_ratio);
+
+    // Check whether the file grew enough since the last check to look for garbage.
+    bool compaction_check_due();
+
+    // Start compaction when dead bytes exceed the threshold.
+    // Returns false when compaction is not worth it.
+    bool begin_compaction(std::vector<Extent> live);
+
+    // Copy up to budget bytes of live data into the new file.
+    // Returns true when all live data is copied, and compaction can be finished.
+    bool compaction_step(long budget);
+
+    // Redirect segments to the new file and drop the old one.
+    // Data appended since begin_compaction() is copied here as well.
+    void finish_compaction(const std::vector<Segment *> &segments);
+
+    // Abandon compaction in progress, keeping the old file.
+    void cancel_compaction();
+
+    // Check whether compaction is in progress.
+    bool is_compacting() const { return compact_fd_ >= 0; }
+
 private:
+    // Append line with trailing newline to the buffer, return its length.
+    int append_line(const std::string &line_content);
+
+    // Flush the buffer if it grew beyond the size threshold.
+    void flush_if_full();
+
     int tempfile_fd_{ -1 }; // file descriptor for temporary file
-    long tempseek_{ 0 };    // seek position for temporary file
+    long tempseek_{ 0 };    // end of data, including the buffered tail
+    long flushed_{ 0 };     // end of data written to the file
+    std::string pending_;   // buffered tail of data, not yet written
+
+    size_t flush_size_{ 64 * 1024 };                      // size threshold for flush
+    std::chrono::milliseconds flush_interval_{ 1000 };    // time threshold for flush
+    std::chrono::steady_clock::time_point pending_since_; // when buffer became non-empty
+
+    // Copy bytes from old file into new file.
+    bool copy_bytes(long from, long length, long to);
+
+    long compact_min_size_{ 4 * 1024 * 1024 }; // no compaction for smaller files
+    double compact_dead_ratio_{ 0.75 };         // fraction of dead bytes to start compaction
+    long compact_checked_size_{ 0 };            // file size at the last check
+    int compact_fd_{ -1 };                      // new file, while compaction is in progress
+    long compact_seek_{ 0 };                    // end of data in new file
+    std::vector<Extent> compact_ranges_;        // live ranges of old file, sorted
+    std::vector<long> compact_targets_;         // offsets of these ranges in new file
+    size_t compact_next_{ 0 };                  // index of next range to copy
+    long compact_done_{ 0 };                    // bytes of next range already copied
+    std::vector<char> compact_buf_;             // buffer for copying
 };
 
 #endif // TEMPFILE_H
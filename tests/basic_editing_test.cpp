@@ -21,6 +21,7 @@ TEST_F(EditorDriver, BasicEditingBackspaceMiddleOfLine)
 
     // Call backend method - should delete space before 'W'
     editor->edit_backspace();
+    editor->put_line(); // Commit line being edited
 
     // Verify result: "HelloWorld"
     EXPECT_EQ(editor->wksp_->read_line(0), "HelloWorld");
@@ -62,6 +63,7 @@ TEST_F(EditorDriver, BasicEditingBackspaceEndOfLine)
 
     // Call backend method - delete last character
     editor->edit_backspace();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Tes");
     EXPECT_EQ(editor->cursor_col_, 3);
@@ -84,6 +86,7 @@ TEST_F(EditorDriver, BasicEditingDeleteMiddleOfLine)
 
     // Call backend method - delete character at cursor
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     // Result: "HelloWorld"
     EXPECT_EQ(editor->wksp_->read_line(0), "HelloWorld");
@@ -120,6 +123,7 @@ TEST_F(EditorDriver, BasicEditingDeleteFirstCharacter)
 
     // Call backend method - delete first character
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "ello");
     EXPECT_EQ(editor->cursor_col_, 0);
@@ -228,6 +232,7 @@ TEST_F(EditorDriver, BasicEditingTabAtStart)
 
     // Call backend method - insert tab (4 spaces)
     editor->edit_tab();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "    Hello");
     EXPECT_EQ(editor->cursor_col_, 4);
@@ -246,6 +251,7 @@ TEST_F(EditorDriver, BasicEditingTabMiddleOfLine)
 
     // Call backend method - insert tab
     editor->edit_tab();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello     World");
     EXPECT_EQ(editor->cursor_col_, 9);
@@ -264,6 +270,7 @@ TEST_F(EditorDriver, BasicEditingTabAtEnd)
 
     // Call backend method - insert tab
     editor->edit_tab();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello    ");
     EXPECT_EQ(editor->cursor_col_, 9);
@@ -287,6 +294,7 @@ TEST_F(EditorDriver, BasicEditingInsertCharacterAtStart)
 
     // Call backend method - insert 'H'
     editor->edit_insert_char('H');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 1);
@@ -306,6 +314,7 @@ TEST_F(EditorDriver, BasicEditingInsertCharacterMiddle)
 
     // Call backend method - insert 'l'
     editor->edit_insert_char('l');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 3);
@@ -325,6 +334,7 @@ TEST_F(EditorDriver, BasicEditingInsertCharacterAtEnd)
 
     // Call backend method - insert 'o'
     editor->edit_insert_char('o');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 5);
@@ -348,6 +358,7 @@ TEST_F(EditorDriver, BasicEditingOverwriteCharacterMiddle)
 
     // Call backend method - overwrite with 'e'
     editor->edit_insert_char('e');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 2);
@@ -367,6 +378,7 @@ TEST_F(EditorDriver, BasicEditingOverwriteAtEnd)
 
     // Call backend method - overwrite (extends line since at end)
     editor->edit_insert_char('o');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 5);
@@ -386,6 +398,7 @@ TEST_F(EditorDriver, BasicEditingOverwriteFirstCharacter)
 
     // Call backend method - overwrite with 'H'
     editor->edit_insert_char('H');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 1);
@@ -410,6 +423,7 @@ TEST_F(EditorDriver, BasicEditingMultipleOperationsSequence)
     for (size_t i = 0; text[i] != '\0'; ++i) {
         editor->edit_insert_char(text[i]);
     }
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Test");
     EXPECT_EQ(editor->cursor_col_, 4);
@@ -417,6 +431,7 @@ TEST_F(EditorDriver, BasicEditingMultipleOperationsSequence)
     // Delete last character using backend method
     LoadLine(0);
     editor->edit_backspace();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Tes");
     EXPECT_EQ(editor->cursor_col_, 3);
@@ -437,6 +452,7 @@ TEST_F(EditorDriver, BasicEditingEmptyLineOperations)
     // Insert character into empty line using backend method
     editor->insert_mode_ = true;
     editor->edit_insert_char('A');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "A");
     EXPECT_EQ(editor->cursor_col_, 1);
@@ -457,6 +473,7 @@ TEST_F(EditorDriver, BasicEditingLongLineEditing)
 
     // Delete character at position 50 using backend method
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     // Result should be 99 characters
     EXPECT_EQ(editor->wksp_->read_line(0).size(), 99);
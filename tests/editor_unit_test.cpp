@@ -1,8 +1,11 @@
 #include <fcntl.h>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <fstream>
+#include <thread>
 
 #include "EditorDriver.h"
 
@@ -609,3 +612,531 @@ TEST_F(EditorDriver, EditorDebugPutLineGaps)
     EXPECT_EQ(line1, ""); // Should be blank
     EXPECT_EQ(line2, "Line 3");
 }
+
+TEST_F(EditorDriver, GotoOffsetCommand)
+{
+    editor->wksp_->load_text(std::vector<std::string>{ "alpha", "beta", "gamma" });
+
+    // Offset 8 is 't' in "beta": "alpha\n" takes 6 bytes
+    editor->execute_command("b8");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 1);
+    EXPECT_EQ(GetActualCol(), 2u);
+    EXPECT_EQ(editor->status_, "Goto offset 8");
+
+    // Start of the last line
+    editor->execute_command("b11");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 2);
+    EXPECT_EQ(GetActualCol(), 0u);
+
+    // Beyond end of file goes to the last line
+    editor->execute_command("b1000");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 2);
+}
+
+TEST_F(EditorDriver, DeferredLineCommit)
+{
+    CreateLine(0, "abc");
+    CreateLine(1, "def");
+    editor->put_line();
+    editor->tempfile_.flush();
+
+    // Typing keeps edits in the line buffer: nothing goes to temp file
+    editor->cursor_line_ = 0;
+    editor->cursor_col_  = 0;
+    for (char ch : std::string("XYZ")) {
+        editor->edit_insert_char(ch);
+    }
+    EXPECT_EQ(editor->tempfile_.unflushed_size(), 0u);
+    EXPECT_EQ(editor->wksp_->read_line(0), "abc");
+    EXPECT_EQ(editor->current_line_length(), 6);
+
+    // Search sees the line being edited
+    editor->cursor_col_ = 0;
+    EXPECT_TRUE(editor->search_forward("YZa"));
+    EXPECT_EQ(editor->wksp_->read_line(0), "XYZabc");
+
+    // Loading another line commits the edit
+    editor->get_line(0);
+    editor->edit_insert_char('!');
+    editor->get_line(1);
+    EXPECT_EQ(editor->wksp_->read_line(0), "X!YZabc");
+}
+
+TEST_F(EditorDriver, LineBufferReloadedAfterDelete)
+{
+    CreateLine(0, "first");
+    CreateLine(1, "second");
+    editor->put_line();
+
+    // Unmodified buffer must not survive structural changes
+    editor->get_line(0);
+    EXPECT_EQ(editor->current_line_, "first");
+    editor->wksp_->delete_contents(0, 0);
+    editor->get_line(0);
+    EXPECT_EQ(editor->current_line_, "second");
+}
+
+TEST_F(EditorDriver, TempfileCompactionAcrossWorkspaces)
+{
+    editor->tempfile_.set_compaction_limits(4096, 0.5);
+
+    // Alternative workspace with modified lines
+    editor->alt_wksp_->load_text(std::vector<std::string>{ "alt one", "alt two" });
+    editor->alt_wksp_->put_line(1, "alt changed");
+
+    // Rewrite the same lines many times, leaving garbage in temp file
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            CreateLine(i, "Line " + std::to_string(i) + " round " + std::to_string(round));
+        }
+    }
+    editor->put_line();
+    long old_size = editor->tempfile_.size();
+
+    // Old versions of lines are kept for undo, until history is dropped
+    editor->wksp_->clear_undo();
+    editor->alt_wksp_->clear_undo();
+
+    // Idle ticks run compaction until it finishes
+    int ticks = 0;
+    do {
+        editor->compact_tempfile();
+        ticks++;
+    } while (editor->tempfile_.is_compacting() || ticks < 2);
+
+    EXPECT_LT(editor->tempfile_.size(), old_size / 10);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(editor->wksp_->read_line(i), "Line " + std::to_string(i) + " round 99");
+    }
+    EXPECT_EQ(editor->alt_wksp_->read_line(0), "alt one");
+    EXPECT_EQ(editor->alt_wksp_->read_line(1), "alt changed");
+}
+
+TEST_F(EditorDriver, UndoRedoEdits)
+{
+    CreateLine(0, "one");
+    CreateLine(1, "two");
+    CreateLine(2, "three");
+    editor->put_line();
+
+    // Typing into a line, then join with the next one by one key
+    editor->wksp_->undo_checkpoint();
+    editor->cursor_line_ = 0;
+    editor->cursor_col_  = 3;
+    editor->edit_insert_char('!');
+    editor->wksp_->undo_checkpoint();
+    editor->edit_delete();
+    editor->put_line();
+    EXPECT_EQ(editor->wksp_->read_line(0), "one!two");
+    EXPECT_EQ(editor->wksp_->total_line_count(), 2);
+
+    // Join is undone as a whole, with typing committed by it
+    editor->edit_undo(false);
+    EXPECT_EQ(editor->wksp_->read_line(0), "one");
+    EXPECT_EQ(editor->wksp_->read_line(1), "two");
+    EXPECT_EQ(editor->wksp_->total_line_count(), 3);
+    EXPECT_EQ(editor->status_, "Undone");
+
+    editor->edit_undo(true);
+    EXPECT_EQ(editor->wksp_->read_line(0), "one!two");
+    EXPECT_EQ(editor->wksp_->read_line(1), "three");
+
+    // Undo everything, and more
+    while (editor->wksp_->undo_depth() > 0) {
+        editor->edit_undo(false);
+    }
+    EXPECT_EQ(editor->wksp_->total_line_count(), 0);
+    editor->edit_undo(false);
+    EXPECT_EQ(editor->status_, "Nothing to undo");
+
+    // Redo everything
+    while (editor->wksp_->redo_depth() > 0) {
+        editor->edit_undo(true);
+    }
+    EXPECT_EQ(editor->wksp_->read_line(0), "one!two");
+    EXPECT_EQ(editor->wksp_->read_line(1), "three");
+
+    // New change forgets what was undone
+    editor->edit_undo(false);
+    editor->wksp_->undo_checkpoint();
+    editor->wksp_->put_line(2, "new");
+    EXPECT_EQ(editor->wksp_->redo_depth(), 0u);
+    editor->edit_undo(true);
+    EXPECT_EQ(editor->status_, "Nothing to redo");
+}
+
+TEST_F(EditorDriver, UndoSurvivesTempfileCompaction)
+{
+    editor->tempfile_.set_compaction_limits(4096, 0.5);
+
+    for (int round = 0; round < 100; ++round) {
+        editor->wksp_->undo_checkpoint();
+        editor->wksp_->put_line(0, "Round " + std::to_string(round) + std::string(50, '.'));
+    }
+    editor->wksp_->delete_contents(0, 0);
+    editor->tempfile_.flush();
+
+    // Old versions are live data, until a new change drops them from history
+    while (editor->wksp_->undo_depth() > 0) {
+        editor->wksp_->undo();
+    }
+    editor->wksp_->undo_checkpoint();
+    editor->wksp_->put_line(0, "Final");
+    editor->wksp_->undo_checkpoint();
+    editor->wksp_->put_line(0, "Last");
+    editor->tempfile_.flush();
+    long old_size = editor->tempfile_.size();
+
+    int ticks = 0;
+    do {
+        editor->compact_tempfile();
+        ticks++;
+    } while (editor->tempfile_.is_compacting() || ticks < 2);
+
+    // History is redirected to the new temp file
+    EXPECT_LT(editor->tempfile_.size(), old_size / 10);
+    EXPECT_EQ(editor->wksp_->read_line(0), "Last");
+    editor->wksp_->undo();
+    EXPECT_EQ(editor->wksp_->read_line(0), "Final");
+    editor->wksp_->undo();
+    EXPECT_EQ(editor->wksp_->total_line_count(), 0);
+    editor->wksp_->redo();
+    editor->wksp_->redo();
+    EXPECT_EQ(editor->wksp_->read_line(0), "Last");
+}
+
+TEST_F(EditorDriver, LineCacheKeepsUnchangedLines)
+{
+    std::vector<std::string> lines;
+    for (int i = 0; i < 50; ++i) {
+        lines.push_back("Line " + std::to_string(i));
+    }
+    editor->wksp_->load_text(lines);
+    editor->tempfile_.flush();
+
+    // First screen is read
+    for (int lno = 0; lno < 20; ++lno) {
+        EXPECT_EQ(editor->visible_line(lno), lines[lno]);
+    }
+    EXPECT_EQ(editor->line_cache_.misses(), 20u);
+    EXPECT_EQ(editor->line_cache_.hits(), 0u);
+
+    // Scroll by one line reads only the new one
+    for (int lno = 1; lno < 21; ++lno) {
+        editor->visible_line(lno);
+    }
+    EXPECT_EQ(editor->line_cache_.misses(), 21u);
+    EXPECT_EQ(editor->line_cache_.hits(), 19u);
+
+    // Replaced line is read again, shifted lines are still cached
+    editor->wksp_->put_line(5, "Changed");
+    editor->wksp_->delete_contents(0, 0);
+    EXPECT_EQ(editor->visible_line(4), "Changed");
+    EXPECT_EQ(editor->visible_line(5), "Line 6");
+    EXPECT_EQ(editor->line_cache_.misses(), 22u);
+    EXPECT_EQ(editor->line_cache_.hits(), 20u);
+
+    // Lines far away from the screen are dropped
+    editor->line_cache_.trim(30, 50, 0);
+    EXPECT_EQ(editor->line_cache_.size(), 0u);
+}
+
+TEST_F(EditorDriver, RegexSearchMode)
+{
+    std::vector<std::string> lines = { "alpha", "took 15ms", "beta", "took 7ms", "a.b" };
+    editor->wksp_->load_text(lines);
+    editor->tempfile_.flush();
+
+    // Literal search by default
+    editor->cursor_line_ = 0;
+    editor->cursor_col_  = 0;
+    EXPECT_FALSE(editor->search_forward("[0-9]+ms"));
+    EXPECT_TRUE(editor->search_forward("a.b"));
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 4);
+
+    // ^X r switches to regular expressions
+    editor->handle_key_edit(24);
+    editor->handle_key_edit('r');
+    EXPECT_EQ(editor->status_, "Search: regex");
+    EXPECT_TRUE(editor->search_forward("[0-9]+ms"));
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 1);
+    EXPECT_EQ(editor->cursor_col_, 5);
+    const SearchPattern *compiled = editor->search_pattern_.get();
+    editor->cursor_col_++;
+    EXPECT_TRUE(editor->search_forward("[0-9]+ms"));
+    EXPECT_EQ(editor->cursor_col_, 6);
+
+    // Pattern is reused by repeated search
+    editor->cursor_col_++;
+    editor->last_search_         = "[0-9]+ms";
+    editor->last_search_forward_ = true;
+    EXPECT_TRUE(editor->search_next());
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 3);
+    EXPECT_EQ(editor->cursor_col_, 5);
+    EXPECT_EQ(editor->search_pattern_.get(), compiled);
+    EXPECT_TRUE(editor->search_backward("^a"));
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 0);
+
+    // Bad expression is reported
+    EXPECT_FALSE(editor->search_forward("(ms"));
+    EXPECT_EQ(editor->status_, "Bad pattern: Unmatched (");
+
+    editor->handle_key_edit(24);
+    editor->handle_key_edit('r');
+    EXPECT_EQ(editor->status_, "Search: literal");
+    EXPECT_FALSE(editor->search_forward("(ms"));
+    EXPECT_EQ(editor->status_, "Not found: (ms");
+}
+
+TEST_F(EditorDriver, SearchInterrupted)
+{
+    std::vector<std::string> lines = { "alpha", "beta", "gamma" };
+    editor->wksp_->load_text(lines);
+    editor->tempfile_.flush();
+
+    // Interrupt stops the search, and is consumed by it
+    editor->interrupt_flag_ = true;
+    EXPECT_FALSE(editor->search_forward("gamma"));
+    EXPECT_EQ(editor->status_, "Search interrupted");
+    EXPECT_FALSE(editor->interrupt_flag_);
+
+    // Wrap around stops at the start position
+    editor->cursor_line_ = 2;
+    EXPECT_TRUE(editor->search_forward("beta"));
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 1);
+    EXPECT_TRUE(editor->search_backward("gamma"));
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 2);
+}
+
+TEST_F(EditorDriver, RepeatSearchUsesMatchIndex)
+{
+    std::vector<std::string> lines = { "one ab", "ab ab", "none", "xab" };
+    editor->wksp_->load_text(lines);
+    editor->tempfile_.flush();
+
+    editor->execute_command("/ab");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 0);
+    EXPECT_EQ(editor->cursor_col_, 4);
+    while (!editor->wksp_->matches_indexed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Match under cursor is skipped, and the search wraps around
+    std::vector<std::pair<int, int>> expected = { { 1, 0 }, { 1, 3 }, { 3, 1 }, { 0, 4 } };
+    for (size_t k = 0; k < expected.size(); ++k) {
+        EXPECT_TRUE(editor->search_next());
+        int line = editor->wksp_->view.topline + editor->cursor_line_;
+        int col  = editor->wksp_->view.basecol + editor->cursor_col_;
+        EXPECT_EQ(std::make_pair(line, col), expected[k]);
+
+        long rank, total;
+        EXPECT_TRUE(editor->wksp_->match_rank(line, col, rank, total));
+        EXPECT_EQ(rank, k == 3 ? 1 : (long)k + 2);
+        EXPECT_EQ(total, 4);
+    }
+    EXPECT_TRUE(editor->search_prev());
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 3);
+
+    // After backward search, n continues backward
+    editor->execute_command("?ab");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 3);
+    editor->execute_command("n");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 1);
+    EXPECT_EQ(editor->cursor_col_, 3);
+
+    // Edited line is searched again
+    editor->wksp_->put_line(2, "ab");
+    editor->execute_command("n");
+    EXPECT_EQ(editor->cursor_col_, 0);
+    long rank, total;
+    EXPECT_TRUE(editor->wksp_->match_rank(1, 0, rank, total));
+    EXPECT_EQ(rank, 2);
+    EXPECT_EQ(total, 5);
+    editor->execute_command("n");
+    EXPECT_EQ(editor->wksp_->view.topline + editor->cursor_line_, 0);
+    EXPECT_EQ(editor->cursor_col_, 4);
+}
+
+TEST_F(EditorDriver, IncrementalSearch)
+{
+    std::vector<std::string> lines = { "xxab", "abc", "abd", "zz" };
+    editor->wksp_->load_text(lines);
+    editor->tempfile_.flush();
+    auto position = [&]() {
+        return std::make_pair(editor->wksp_->view.topline + editor->cursor_line_,
+                              editor->wksp_->view.basecol + editor->cursor_col_);
+    };
+    auto type = [&](const std::string &text) {
+        for (char c : text) {
+            editor->handle_key_cmd(c);
+            editor->incremental_search();
+        }
+    };
+    editor->cursor_line_ = 1;
+    editor->cursor_col_  = 1;
+
+    // Every key moves to the first match of the text typed so far
+    editor->handle_key_edit(6); // ^F
+    type("a");
+    EXPECT_EQ(position(), std::make_pair(2, 0));
+    type("b");
+    EXPECT_EQ(position(), std::make_pair(2, 0));
+    type("c");
+    EXPECT_EQ(position(), std::make_pair(1, 0));
+
+    // Backspace returns to the previous match
+    editor->handle_key_cmd(127); // Backspace
+    editor->incremental_search();
+    EXPECT_EQ(position(), std::make_pair(2, 0));
+
+    // Longer text is not searched when the shorter one was not found
+    type("xy");
+    EXPECT_EQ(position(), std::make_pair(2, 0));
+    ASSERT_EQ(editor->isearch_steps_.size(), 4u);
+    EXPECT_FALSE(editor->isearch_steps_.back().found);
+    EXPECT_EQ(editor->isearch_steps_.back().needle, "abxy");
+
+    // Escape returns to the start
+    editor->handle_key_cmd(27);
+    EXPECT_FALSE(editor->cmd_mode_);
+    EXPECT_EQ(position(), std::make_pair(1, 1));
+    EXPECT_TRUE(editor->isearch_steps_.empty());
+
+    // Enter completes the search
+    editor->handle_key_edit(2); // ^B
+    type("ab");
+    EXPECT_EQ(position(), std::make_pair(1, 0));
+    editor->handle_key_cmd('\n');
+    EXPECT_EQ(position(), std::make_pair(1, 0));
+    EXPECT_EQ(editor->status_, "Found: ab");
+    EXPECT_EQ(editor->last_search_, "ab");
+    EXPECT_FALSE(editor->last_search_forward_);
+
+    // Regular expression is searched from the start every time
+    editor->regex_search_ = true;
+    editor->cursor_col_   = 1;
+    editor->handle_key_edit(6); // ^F
+    type("z");
+    EXPECT_EQ(position(), std::make_pair(3, 0));
+    type("|");
+    EXPECT_EQ(position(), std::make_pair(1, 1));
+    type("d");
+    EXPECT_EQ(position(), std::make_pair(2, 2));
+    type("(");
+    EXPECT_EQ(position(), std::make_pair(2, 2));
+    EXPECT_EQ(editor->status_, "");
+    editor->handle_key_cmd(27);
+    EXPECT_EQ(position(), std::make_pair(1, 1));
+}
+
+TEST_F(EditorDriver, SubstituteCommand)
+{
+    std::vector<std::string> lines = { "a/b a/b", "xyz", "a/b", "a/b/c" };
+    editor->wksp_->load_text(lines);
+    editor->tempfile_.flush();
+
+    // Slash in the text is quoted by backslash
+    editor->execute_command("c/a\\/b/ab/");
+    EXPECT_EQ(editor->status_, "Replaced 3 in 3 lines");
+    EXPECT_EQ(editor->wksp_->read_line(0), "ab a/b");
+    EXPECT_EQ(editor->wksp_->read_line(3), "ab/c");
+
+    // Count limits the lines, from the cursor
+    editor->cursor_line_ = 3;
+    editor->execute_command("1c/b/-/g");
+    EXPECT_EQ(editor->status_, "Replaced 1 in 1 line");
+    EXPECT_EQ(editor->wksp_->read_line(3), "a-/c");
+    EXPECT_EQ(editor->wksp_->read_line(2), "ab");
+    editor->regex_search_ = true;
+    editor->execute_command("2c/[a-c]+/-/g");
+    EXPECT_EQ(editor->wksp_->read_line(0), "ab a/b");
+    EXPECT_EQ(editor->wksp_->read_line(3), "--/-");
+
+    editor->cursor_line_ = 0;
+    editor->execute_command("c/q/r/g");
+    EXPECT_EQ(editor->status_, "Not found: q");
+    editor->execute_command("c/(/r/");
+    EXPECT_EQ(editor->status_, "Bad pattern: Unmatched (");
+    editor->execute_command("c/a/\n/");
+    EXPECT_EQ(editor->status_, "Cannot replace by newline");
+
+    // Undone at once
+    editor->wksp_->undo_checkpoint();
+    editor->execute_command("c/.$/!/");
+    EXPECT_EQ(editor->wksp_->read_line(1), "xy!");
+    editor->edit_undo(false);
+    EXPECT_EQ(editor->wksp_->read_line(0), "ab a/b");
+    EXPECT_EQ(editor->wksp_->read_line(1), "xyz");
+
+    // Names with slashes save the file, without changing it
+    std::string dirname = "SubstituteCommand.dir";
+    mkdir(dirname.c_str(), 0755);
+    editor->execute_command("s" + dirname + "/g");
+    EXPECT_EQ(editor->status_, "Saving as: " + dirname + "/g");
+    editor->finish_saves();
+    std::ifstream in(dirname + "/g");
+    std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(saved, "ab a/b\nxyz\nab\n--/-\n");
+    in.close();
+    std::remove((dirname + "/g").c_str());
+    rmdir(dirname.c_str());
+
+    editor->execute_command("s/tmp/x/");
+    EXPECT_EQ(editor->status_, "Saving as: /tmp/x/");
+    editor->finish_saves();
+    EXPECT_EQ(editor->wksp_->read_line(0), "ab a/b");
+}
+
+//
+// Test that a save which fails on write is reported, and the file stays modified
+//
+TEST_F(EditorDriver, SaveFailureIsReported)
+{
+    if (access("/dev/full", W_OK) != 0)
+        GTEST_SKIP() << "no /dev/full";
+
+    editor->wksp_->load_text("one\ntwo\n");
+    editor->wksp_->file_state.modified = true;
+
+    // Not by save_as(), which unlinks the target first
+    editor->wksp_->start_save("/dev/full");
+    editor->wksp_->file_state.modified = false;
+    for (int i = 0; i < 1000 && editor->is_saving(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        editor->poll_saves();
+    }
+    EXPECT_EQ(editor->status_, "Cannot write: /dev/full");
+    EXPECT_TRUE(editor->wksp_->file_state.modified);
+
+    // Same when waited for at exit
+    editor->wksp_->start_save("/dev/full");
+    editor->wksp_->file_state.modified = false;
+    editor->finish_saves();
+    EXPECT_EQ(editor->status_, "Cannot write: /dev/full");
+    EXPECT_TRUE(editor->wksp_->file_state.modified);
+}
+
+//
+// Test that save as renames the file only when the save succeeds
+//
+TEST_F(EditorDriver, SaveAsRenamesOnSuccess)
+{
+    editor->wksp_->load_text("one\ntwo\n");
+    editor->filename_ = "SaveAsRenamesOnSuccess.txt";
+
+    editor->save_as("no/such/dir/file.txt");
+    EXPECT_EQ(editor->filename_, "SaveAsRenamesOnSuccess.txt");
+    editor->finish_saves();
+    EXPECT_EQ(editor->status_, "Cannot write: no/such/dir/file.txt");
+    EXPECT_EQ(editor->filename_, "SaveAsRenamesOnSuccess.txt");
+
+    std::string outname = "SaveAsRenamesOnSuccess.out";
+    editor->save_as(outname);
+    for (int i = 0; i < 1000 && editor->is_saving(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        editor->poll_saves();
+    }
+    EXPECT_EQ(editor->status_, "Saved: " + outname);
+    EXPECT_EQ(editor->filename_, outname);
+    std::remove(outname.c_str());
+}
@@ -21,6 +21,7 @@ TEST_F(EditorDriver, HorizontalBackspaceWithScroll)
 
     // Call backend method - should delete 'E' at position 14
     editor->edit_backspace();
+    editor->put_line(); // Commit line being edited
 
     // Result: "0123456789ABCDFGHIJ" (E removed)
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDFGHIJ");
@@ -68,6 +69,7 @@ TEST_F(EditorDriver, HorizontalDeleteWithScroll)
 
     // Call backend method - delete character at cursor position (F at position 15)
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     // Result: "0123456789ABCDEGHIJ" (F removed)
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEGHIJ");
@@ -86,6 +88,7 @@ TEST_F(EditorDriver, HorizontalDeleteAtVariousScrollPositions)
 
     // Call backend method
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     // Result: "ABCDEFGHIJKLMNOPQRSTVWXYZ" (U removed at position 20)
     EXPECT_EQ(editor->wksp_->read_line(0), "ABCDEFGHIJKLMNOPQRSTVWXYZ");
@@ -164,6 +167,7 @@ TEST_F(EditorDriver, HorizontalTabWithScroll)
 
     // Call backend method - insert tab (4 spaces) at actual position 15
     editor->edit_tab();
+    editor->put_line(); // Commit line being edited
 
     // Result: "0123456789ABCDE    FGHIJ"
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDE    FGHIJ");
@@ -183,6 +187,7 @@ TEST_F(EditorDriver, HorizontalTabAtScrollBoundary)
 
     // Call backend method - insert tab
     editor->edit_tab();
+    editor->put_line(); // Commit line being edited
 
     // Spaces inserted at position 20
     std::string result = editor->wksp_->read_line(0);
@@ -206,6 +211,7 @@ TEST_F(EditorDriver, HorizontalInsertCharacterWithScroll)
 
     // Call backend method - insert 'X' at actual position 15
     editor->edit_insert_char('X');
+    editor->put_line(); // Commit line being edited
 
     // Result: "0123456789ABCDEXFGHIJ"
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEXFGHIJ");
@@ -228,6 +234,7 @@ TEST_F(EditorDriver, HorizontalInsertMultipleCharactersWithScroll)
     for (size_t i = 0; text[i] != '\0'; ++i) {
         editor->edit_insert_char(text[i]);
     }
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Start Middle End");
 }
@@ -248,6 +255,7 @@ TEST_F(EditorDriver, HorizontalOverwriteWithScroll)
 
     // Call backend method - overwrite 'F' with 'X' at actual position 15
     editor->edit_insert_char('X');
+    editor->put_line(); // Commit line being edited
 
     // Result: "0123456789ABCDEXGHIJ"
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEXGHIJ");
@@ -270,6 +278,7 @@ TEST_F(EditorDriver, HorizontalOverwriteMultipleWithScroll)
     for (size_t i = 0; text[i] != '\0'; ++i) {
         editor->edit_insert_char(text[i]);
     }
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "The quick BLACK fox");
 }
@@ -293,6 +302,7 @@ TEST_F(EditorDriver, HorizontalEditingAtMaxScroll)
 
     // Call backend method - delete character at position 90
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0).length(), 99);
 }
@@ -335,6 +345,7 @@ TEST_F(EditorDriver, HorizontalComplexEditingSequenceWithScroll)
 
     // Call backend method - insert 'X'
     editor->edit_insert_char('X');
+    editor->put_line(); // Commit line being edited
 
     // Verify: "0123456789ABXCDEFGHIJKLMNOP"
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABXCDEFGHIJKLMNOP");
@@ -344,6 +355,7 @@ TEST_F(EditorDriver, HorizontalComplexEditingSequenceWithScroll)
     EXPECT_EQ(GetActualCol(), 13); // 8 + 5 = 13
 
     editor->edit_backspace();
+    editor->put_line(); // Commit line being edited
 
     // Back to original: "0123456789ABCDEFGHIJKLMNOP"
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEFGHIJKLMNOP");
@@ -373,6 +385,7 @@ TEST_F(EditorDriver, HorizontalVerifyBugFixScenario)
 
     // Call backend method - delete character at actual position 12
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     // Result: "Hello World est Line" ('T' removed)
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello World est Line");
@@ -516,6 +529,7 @@ TEST_F(EditorDriver, HorizontalBackspaceJoinLinesWithScroll)
 
     // Call backend method - with scroll, actual_col > 0, so backspace deletes character in line
     editor->edit_backspace();
+    editor->put_line(); // Commit line being edited
 
     // Should delete character at position 4: "Second line" -> "Secod line"
     EXPECT_EQ(editor->wksp_->read_line(1), "Secod line");
@@ -598,6 +612,7 @@ TEST_F(EditorDriver, HorizontalDeleteNotAtEndWithScroll)
 
     // Call backend method - delete character at position 5
     editor->edit_delete();
+    editor->put_line(); // Commit line being edited
 
     // Should delete 'n' at position 5: "Testing" -> "Testig"
     EXPECT_EQ(editor->wksp_->read_line(0), "Testig");
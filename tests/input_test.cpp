@@ -20,6 +20,7 @@ TEST_F(EditorDriver, InputBackspaceKeyMiddleOfLine)
 
     // Simulate backspace key press
     editor->handle_key_edit(KEY_BACKSPACE);
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "HelloWorld");
     EXPECT_EQ(editor->cursor_col_, 5);
@@ -37,6 +38,7 @@ TEST_F(EditorDriver, InputBackspaceKeyWithScroll)
 
     // Simulate backspace (actual position: 10 + 5 = 15)
     editor->handle_key_edit(KEY_BACKSPACE);
+    editor->put_line(); // Commit line being edited
 
     // Should delete character at position 14
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDFGHIJ");
@@ -52,6 +54,7 @@ TEST_F(EditorDriver, InputBackspaceKey127)
     editor->get_line(0);
 
     editor->handle_key_edit(127); // ASCII DEL/Backspace
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Tst");
     EXPECT_EQ(editor->cursor_col_, 1);
@@ -70,6 +73,7 @@ TEST_F(EditorDriver, InputDeleteKeyMiddleOfLine)
 
     // Simulate delete key press
     editor->handle_key_edit(KEY_DC);
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "HelloWorld");
     EXPECT_EQ(editor->cursor_col_, 5); // Cursor doesn't move
@@ -85,6 +89,7 @@ TEST_F(EditorDriver, InputDeleteKeyWithScroll)
 
     // Simulate delete (actual position: 10 + 5 = 15)
     editor->handle_key_edit(KEY_DC);
+    editor->put_line(); // Commit line being edited
 
     // Should delete character at position 15 (F)
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEGHIJ");
@@ -141,6 +146,7 @@ TEST_F(EditorDriver, InputTabKeyInsertion)
 
     // Simulate tab key press
     editor->handle_key_edit('\t');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "    Hello");
     EXPECT_EQ(editor->cursor_col_, 4);
@@ -156,6 +162,7 @@ TEST_F(EditorDriver, InputTabKeyWithScroll)
 
     // Simulate tab (actual position: 10 + 5 = 15)
     editor->handle_key_edit('\t');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDE    FGHIJ");
     EXPECT_EQ(editor->cursor_col_, 9);
@@ -175,6 +182,7 @@ TEST_F(EditorDriver, InputCharacterInsertionKey)
 
     // Simulate 'l' key press
     editor->handle_key_edit('l');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 3);
@@ -193,6 +201,7 @@ TEST_F(EditorDriver, InputMultipleCharacterInsertion)
     for (size_t i = 0; text[i] != '\0'; ++i) {
         editor->handle_key_edit(text[i]);
     }
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Test");
     EXPECT_EQ(editor->cursor_col_, 4);
@@ -209,6 +218,7 @@ TEST_F(EditorDriver, InputCharacterInsertionWithScroll)
 
     // Insert 'X' at actual position 15
     editor->handle_key_edit('X');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEXFGHIJ");
     EXPECT_EQ(editor->cursor_col_, 6);
@@ -220,14 +230,17 @@ TEST_F(EditorDriver, InputCharacterInsertionFooLineCount)
     EXPECT_EQ(editor->wksp_->total_line_count(), 0);
 
     editor->handle_key_edit('f');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 1);
 
     editor->handle_key_edit('o');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 1);
 
     editor->handle_key_edit('o');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 1);
 
@@ -244,14 +257,17 @@ TEST_F(EditorDriver, InputCharacterInsertionFooBarQuz)
     EXPECT_EQ(editor->wksp_->total_line_count(), 0);
 
     editor->handle_key_edit('f');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 1);
 
     editor->handle_key_edit('o');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 1);
 
     editor->handle_key_edit('o');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 1);
 
@@ -260,14 +276,17 @@ TEST_F(EditorDriver, InputCharacterInsertionFooBarQuz)
     EXPECT_EQ(editor->wksp_->total_line_count(), 2);
 
     editor->handle_key_edit('b');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 2);
 
     editor->handle_key_edit('a');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 2);
 
     editor->handle_key_edit('r');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 2);
 
@@ -276,14 +295,17 @@ TEST_F(EditorDriver, InputCharacterInsertionFooBarQuz)
     EXPECT_EQ(editor->wksp_->total_line_count(), 3);
 
     editor->handle_key_edit('q');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 3);
 
     editor->handle_key_edit('u');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 3);
 
     editor->handle_key_edit('z');
+    editor->put_line(); // Commit line being edited
     editor->wksp_->debug_print(std::cout);
     EXPECT_EQ(editor->wksp_->total_line_count(), 3);
 
@@ -310,6 +332,7 @@ TEST_F(EditorDriver, InputCharacterOverwriteKey)
 
     // Overwrite 'x' with 'e'
     editor->handle_key_edit('e');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello");
     EXPECT_EQ(editor->cursor_col_, 2);
@@ -326,6 +349,7 @@ TEST_F(EditorDriver, InputCharacterOverwriteWithScroll)
 
     // Overwrite 'F' with 'X' at actual position 15
     editor->handle_key_edit('X');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "0123456789ABCDEXGHIJ");
     EXPECT_EQ(editor->cursor_col_, 6);
@@ -346,6 +370,7 @@ TEST_F(EditorDriver, InputInsertVsOverwriteMode)
     editor->get_line(0);
 
     editor->handle_key_edit('X');
+    editor->put_line(); // Commit line being edited
     EXPECT_EQ(editor->wksp_->read_line(0), "TeXst");
 
     // Test overwrite mode
@@ -356,6 +381,7 @@ TEST_F(EditorDriver, InputInsertVsOverwriteMode)
     editor->get_line(1);
 
     editor->handle_key_edit('X');
+    editor->put_line(); // Commit line being edited
     EXPECT_EQ(editor->wksp_->read_line(1), "TeXt");
 }
 
@@ -378,6 +404,7 @@ TEST_F(EditorDriver, InputComplexEditingSequence)
     editor->handle_key_edit('r');
     editor->handle_key_edit('l');
     editor->handle_key_edit('d');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello World");
     EXPECT_EQ(editor->cursor_col_, 11);
@@ -385,6 +412,7 @@ TEST_F(EditorDriver, InputComplexEditingSequence)
     // Backspace twice
     editor->handle_key_edit(KEY_BACKSPACE);
     editor->handle_key_edit(KEY_BACKSPACE);
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "Hello Wor");
     EXPECT_EQ(editor->cursor_col_, 9);
@@ -405,6 +433,7 @@ TEST_F(EditorDriver, InputEditingWithScrollingSequence)
     editor->handle_key_edit('A');
     editor->handle_key_edit('C');
     editor->handle_key_edit('K');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "The quick BLACK fox");
 }
@@ -425,6 +454,7 @@ TEST_F(EditorDriver, InputPrintableCharacterRange)
     editor->handle_key_edit(' '); // 32
     editor->handle_key_edit('A'); // 65
     editor->handle_key_edit('~'); // 126
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), " A~");
 }
@@ -457,12 +487,14 @@ TEST_F(EditorDriver, InputEmptyLineEditing)
 
     // Add character to empty line
     editor->handle_key_edit('A');
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "A");
     EXPECT_EQ(editor->cursor_col_, 1);
 
     // Delete it
     editor->handle_key_edit(KEY_BACKSPACE);
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0), "");
     EXPECT_EQ(editor->cursor_col_, 0);
@@ -480,6 +512,7 @@ TEST_F(EditorDriver, InputVeryLongLineEditing)
 
     // Delete at position 90
     editor->handle_key_edit(KEY_DC);
+    editor->put_line(); // Commit line being edited
 
     EXPECT_EQ(editor->wksp_->read_line(0).length(), 99);
 }
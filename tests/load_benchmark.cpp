@@ -0,0 +1,126 @@
+//
+// Benchmark of Workspace::load_file(): time to open a file, number of
+// segments and heap used by the segment tree.
+//
+// Usage:
+//      load_benchmark --generate SIZE_MB FILE     -- create test input
+//      load_benchmark [--threads N] [--io NAME] FILE...   -- measure loading
+//
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2 1
+#endif
+
+#include "io_backend.h"
+#include "tempfile.h"
+#include "workspace.h"
+
+//
+// Number of bytes allocated on heap, or 0 when unknown.
+//
+static size_t heap_in_use()
+{
+#ifdef HAVE_MALLINFO2
+    return mallinfo2().uordblks;
+#else
+    return 0;
+#endif
+}
+
+//
+// Create file of given size with lines of text, 0 to 80 characters each.
+//
+static int generate(long size_mb, const char *filename)
+{
+    FILE *out = fopen(filename, "w");
+    if (!out) {
+        perror(filename);
+        return 1;
+    }
+
+    const long total = size_mb * 1024 * 1024;
+    unsigned seed    = 1;
+    std::string line;
+    for (long written = 0; written < total; written += line.size()) {
+        seed = seed * 1103515245 + 12345;
+        line.assign((seed >> 16) % 81, 'a' + written % 26);
+        line += '\n';
+        fwrite(line.data(), 1, line.size(), out);
+    }
+    fclose(out);
+    return 0;
+}
+
+//
+// Load the file into a workspace and print statistics.
+//
+static int measure(const char *filename, unsigned threads)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror(filename);
+        return 1;
+    }
+
+    Tempfile tempfile;
+    size_t heap_before = heap_in_use();
+    {
+        Workspace wksp(tempfile);
+        wksp.set_index_threads(threads);
+
+        auto start = std::chrono::steady_clock::now();
+        wksp.load_file(fd);
+        auto finish = std::chrono::steady_clock::now();
+
+        size_t heap_after = heap_in_use();
+        double seconds    = std::chrono::duration<double>(finish - start).count();
+        printf("%s: %s, %ld bytes, %d lines, %zu segments, heap %zu bytes, open %.2f sec\n",
+               filename, IoBackend::get().name(), wksp.get_contents().total_bytes(),
+               wksp.total_line_count(),
+               wksp.get_contents().size(), heap_after - heap_before, seconds);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && strcmp(argv[1], "--generate") == 0) {
+        return generate(atol(argv[2]), argv[3]);
+    }
+    if (argc < 2) {
+        fprintf(stderr, "Usage:\n");
+        fprintf(stderr, "    load_benchmark --generate SIZE_MB FILE\n");
+        fprintf(stderr, "    load_benchmark [--threads N] [--io NAME] FILE...\n");
+        return 1;
+    }
+
+    // Number of indexing threads, 0 for one per core
+    unsigned threads = 0;
+    int first        = 1;
+    while (first + 2 < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "--threads") == 0) {
+            threads = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "--io") == 0 && IoBackend::select(argv[first + 1])) {
+            // Backend selected
+        } else {
+            fprintf(stderr, "Bad option: %s %s\n", argv[first], argv[first + 1]);
+            return 1;
+        }
+        first += 2;
+    }
+
+    int status = 0;
+    for (int i = first; i < argc; ++i) {
+        status |= measure(argv[i], threads);
+    }
+    return status;
+}
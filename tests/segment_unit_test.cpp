@@ -144,7 +144,11 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     std::string content;
 
     // Create lines that vary in length to test different cases
-    for (int i = 0; i < 200; i++) {
+    long second_offset = 0;
+    for (int i = 0; i < 5000; i++) {
+        if (i == (int)Segment::MAX_LINES) {
+            second_offset = content.size();
+        }
         if (i % 4 == 0) {
             // Short line (7 chars): "Line X\n"
             content += "Line " + std::to_string(i) + "\n";
@@ -167,7 +171,7 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     editor->load_file_segments(filename);
 
     // Verify segments were created
-    EXPECT_EQ(editor->wksp_->total_line_count(), 200);
+    EXPECT_EQ(editor->wksp_->total_line_count(), 5000);
 
     // Check segment chain structure
     auto segment_it         = editor->wksp_->get_contents().begin();
@@ -188,9 +192,9 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     segment_count = segments.size();
 
     // Verify Segment 1
-    EXPECT_EQ(segments[0]->line_count, 127);
+    EXPECT_EQ(segments[0]->line_count, Segment::MAX_LINES);
     EXPECT_EQ(segments[0]->file_offset, 0);
-    EXPECT_EQ(segments[0]->line_lengths.size(), 127);
+    EXPECT_EQ(segments[0]->line_lengths.size(), Segment::MAX_LINES);
 
     std::cout << "Segment 1:\n";
     std::cout << "  nlines: " << segments[0]->line_count << "\n";
@@ -199,9 +203,9 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     std::cout << "  data.size(): " << segments[0]->line_lengths.size() << "\n";
 
     // Verify Segment 2
-    EXPECT_EQ(segments[1]->line_count, 73);
-    EXPECT_EQ(segments[1]->file_offset, 3134);
-    EXPECT_EQ(segments[1]->line_lengths.size(), 73);
+    EXPECT_EQ(segments[1]->line_count, 5000 - Segment::MAX_LINES);
+    EXPECT_EQ(segments[1]->file_offset, second_offset);
+    EXPECT_EQ(segments[1]->line_lengths.size(), 5000 - Segment::MAX_LINES);
 
     std::cout << "Segment 2:\n";
     std::cout << "  nlines: " << segments[1]->line_count << "\n";
@@ -215,7 +219,7 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     for (const auto *seg : segments) {
         total_segment_lines += seg->line_count;
         EXPECT_GE(seg->line_count, 0);
-        EXPECT_LE(seg->line_count, 127); // Max lines per segment
+        EXPECT_LE(seg->line_count, Segment::MAX_LINES); // Max lines per segment
 
         // Verify segment data is not empty when there are lines
         if (seg->line_count > 0) {
@@ -228,7 +232,7 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     std::cout << "================================\n\n";
 
     EXPECT_EQ(segment_count, 2);
-    EXPECT_EQ(total_segment_lines, 200);
+    EXPECT_EQ(total_segment_lines, 5000);
 
     // Verify we can read lines from each segment
     // Test various lines across the file - position to each line first
@@ -244,8 +248,110 @@ TEST_F(EditorDriver, SegmentSegmentChainFromVariableLines)
     editor->wksp_->change_current_line(100);
     EXPECT_EQ(editor->wksp_->read_line(100), "Line 100");
 
-    editor->wksp_->change_current_line(199);
-    EXPECT_EQ(editor->wksp_->read_line(199), "This is a very long line number 199 with extra text");
+    editor->wksp_->change_current_line(4096);
+    EXPECT_EQ(editor->wksp_->read_line(4096), "Line 4096");
+
+    editor->wksp_->change_current_line(4999);
+    EXPECT_EQ(editor->wksp_->read_line(4999),
+              "This is a very long line number 4999 with extra text");
+
+    cleanupTestFile(filename);
+}
+
+TEST_F(EditorDriver, SegmentSizeLimitedByBytes)
+{
+    // Long lines: segments are cut by byte size before reaching line limit
+    std::string line(999, 'w');
+    std::string content;
+    for (int i = 0; i < 1000; i++) {
+        content += line + "\n";
+    }
+    std::string filename = createTestFile(content);
+
+    editor->load_file_segments(filename);
+    EXPECT_EQ(editor->wksp_->total_line_count(), 1000);
+
+    int total_lines = 0;
+    for (const auto &seg : editor->wksp_->get_contents()) {
+        EXPECT_LT(seg.total_byte_count(), Segment::MAX_BYTES + 1000);
+        total_lines += seg.line_count;
+    }
+    EXPECT_EQ(total_lines, 1000);
+    EXPECT_EQ(editor->wksp_->get_contents().size(), 4);
+    EXPECT_EQ(editor->wksp_->get_contents().front().line_count, 263);
+
+    editor->wksp_->change_current_line(999);
+    EXPECT_EQ(editor->wksp_->read_line(999), line);
 
     cleanupTestFile(filename);
 }
+
+TEST_F(EditorDriver, SegmentLinesLongerThan64K)
+{
+    // Line lengths above 65535 used to be truncated
+    std::string hugeLine(70000, 'H');
+    std::string filename = createTestFile("Before\n" + hugeLine + "\nAfter\n");
+
+    editor->load_file_segments(filename);
+
+    auto &seg = editor->wksp_->get_contents().front();
+    EXPECT_EQ(seg.line_lengths[1], 70001);
+    EXPECT_EQ(seg.total_byte_count(), 7 + 70001 + 6);
+
+    EXPECT_EQ(editor->wksp_->read_line(1), hugeLine);
+    EXPECT_EQ(editor->wksp_->read_line(2), "After");
+    EXPECT_EQ(editor->wksp_->line_to_offset(2), 7 + 70001);
+    EXPECT_EQ(editor->wksp_->offset_to_line(7 + 70000), 1);
+
+    cleanupTestFile(filename);
+}
+
+TEST_F(EditorDriver, SegmentLineLengthsEncoding)
+{
+    // Mix of one-, two- and three-byte lengths, across several checkpoints
+    LineLengths lengths;
+    std::vector<long> expected;
+    for (int i = 0; i < 300; ++i) {
+        long len = (i % 7 == 0) ? 20000 + i : (i % 3 == 0) ? 200 + i : 1 + i % 100;
+        lengths.push_back(len);
+        expected.push_back(len);
+    }
+    ASSERT_EQ(lengths.size(), expected.size());
+
+    long offset = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(lengths[i], expected[i]);
+        EXPECT_EQ(lengths.offset_of(i), offset);
+        EXPECT_EQ(lengths.line_at(offset), i);
+        EXPECT_EQ(lengths.line_at(offset + expected[i] - 1), i);
+        offset += expected[i];
+    }
+    EXPECT_EQ(lengths.total(), offset);
+    EXPECT_EQ(lengths.line_at(offset), expected.size());
+
+    // Iteration decodes the same values
+    size_t index = 0;
+    for (long len : lengths) {
+        EXPECT_EQ(len, expected[index++]);
+    }
+    EXPECT_EQ(index, expected.size());
+
+    // Truncate in the middle of a block, then extend again
+    lengths.resize(130);
+    EXPECT_EQ(lengths.size(), 130);
+    EXPECT_EQ(lengths.total(), lengths.offset_of(129) + expected[129]);
+    lengths.pop_back();
+    lengths.pop_back();
+    EXPECT_EQ(lengths.size(), 128);
+    lengths.resize(200, 1);
+    EXPECT_EQ(lengths[127], expected[127]);
+    EXPECT_EQ(lengths[128], 1);
+    EXPECT_EQ(lengths[199], 1);
+    EXPECT_EQ(lengths.line_at(lengths.offset_of(150)), 150);
+
+    // Moved-from object is empty
+    LineLengths moved = std::move(lengths);
+    EXPECT_EQ(moved.size(), 200);
+    EXPECT_TRUE(lengths.empty());
+    EXPECT_EQ(lengths.total(), 0);
+}
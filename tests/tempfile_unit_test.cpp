@@ -114,6 +114,9 @@ TEST_F(TempfileDriver, WriteLineToTempVerifyContent)
     ASSERT_EQ(segments.size(), 1);
     const Segment &seg = segments.front();
 
+    // Write buffered data to the file
+    tempfile->flush();
+
     // Seek to the segment position and read the data
     char buffer[256];
     lseek(seg.file_descriptor, seg.file_offset, SEEK_SET);
@@ -136,6 +139,9 @@ TEST_F(TempfileDriver, WriteLineToTempLongLine)
     EXPECT_EQ(seg.line_count, 1);
     EXPECT_EQ(seg.line_lengths[0], 1001); // 1000 'A's + '\n'
 
+    // Write buffered data to the file
+    tempfile->flush();
+
     // Verify content
     char buffer[1002];
     lseek(seg.file_descriptor, seg.file_offset, SEEK_SET);
@@ -312,6 +318,9 @@ TEST_F(TempfileDriver, WriteLinesToTempVerifyContent)
     ASSERT_EQ(segments.size(), 1);
     const Segment &seg = segments.front();
 
+    // Write buffered data to the file
+    tempfile->flush();
+
     // Seek to the segment position and read the data
     char buffer[256];
     lseek(seg.file_descriptor, seg.file_offset, SEEK_SET);
@@ -408,3 +417,102 @@ TEST_F(TempfileDriver, WriteLinesToTempPositionTracking)
     EXPECT_EQ(s2.line_lengths[0], 12); // "Single line\n"
     EXPECT_EQ(s3.line_lengths[0], 13); // "Block2 Line1\n"
 }
+
+// Test that small writes stay in the buffer and are readable from memory
+TEST_F(TempfileDriver, BufferedWritesReadThrough)
+{
+    auto segments = tempfile->write_line_to_temp("Buffered line");
+    ASSERT_EQ(segments.size(), 1);
+    const Segment &seg = segments.front();
+
+    // Nothing written to the file yet
+    EXPECT_EQ(tempfile->unflushed_size(), 14u);
+    EXPECT_EQ(lseek(tempfile->fd(), 0, SEEK_END), 0);
+
+    // Data is served from the buffer
+    const char *data = tempfile->unflushed_bytes(seg.file_offset, 13);
+    ASSERT_NE(data, nullptr);
+    EXPECT_EQ(std::string(data, 13), "Buffered line");
+
+    // After flush, data is in the file and no longer buffered
+    EXPECT_TRUE(tempfile->flush());
+    EXPECT_EQ(tempfile->unflushed_size(), 0u);
+    EXPECT_EQ(tempfile->unflushed_bytes(seg.file_offset, 13), nullptr);
+    EXPECT_EQ(lseek(tempfile->fd(), 0, SEEK_END), 14);
+}
+
+// Test size and time thresholds for flushing the buffer
+TEST_F(TempfileDriver, BufferFlushThresholds)
+{
+    tempfile->set_flush_limits(100, std::chrono::milliseconds(0));
+
+    // Below size threshold: kept in memory until the interval expires
+    tempfile->write_line_to_temp("Short");
+    EXPECT_EQ(tempfile->unflushed_size(), 6u);
+    tempfile->flush_if_expired();
+    EXPECT_EQ(tempfile->unflushed_size(), 0u);
+
+    // Reaching size threshold flushes immediately
+    tempfile->set_flush_limits(100, std::chrono::hours(1));
+    std::vector<std::string> lines(20, "0123456789");
+    auto segments = tempfile->write_lines_to_temp(lines);
+    EXPECT_EQ(tempfile->unflushed_size(), 0u);
+    EXPECT_EQ(lseek(tempfile->fd(), 0, SEEK_END), 6 + 20 * 11);
+
+    // Long interval: data stays buffered
+    tempfile->write_line_to_temp("Pending");
+    tempfile->flush_if_expired();
+    EXPECT_EQ(tempfile->unflushed_size(), 8u);
+}
+
+// Test compaction: only referenced data survives, and segments are redirected
+TEST_F(TempfileDriver, CompactionKeepsLiveData)
+{
+    tempfile->set_compaction_limits(1000, 0.5);
+
+    // Many superseded copies of a line, and a few live ones
+    std::list<Segment> live;
+    for (int i = 0; i < 200; ++i) {
+        auto segs = tempfile->write_line_to_temp("Garbage line number " + std::to_string(i));
+        if (i % 50 == 0) {
+            live.splice(live.end(), segs);
+        }
+    }
+    long old_size = tempfile->size();
+
+    std::vector<Tempfile::Extent> extents;
+    for (const auto &seg : live) {
+        extents.push_back({ seg.file_offset, seg.total_byte_count() });
+    }
+    ASSERT_TRUE(tempfile->compaction_check_due());
+    ASSERT_TRUE(tempfile->begin_compaction(extents));
+    EXPECT_TRUE(tempfile->is_compacting());
+
+    // Copy in small steps; meanwhile new lines are written
+    while (!tempfile->compaction_step(10)) {
+    }
+    auto fresh = tempfile->write_line_to_temp("Written during compaction");
+    live.splice(live.end(), fresh);
+
+    std::vector<Segment *> pointers;
+    for (auto &seg : live) {
+        pointers.push_back(&seg);
+    }
+    tempfile->finish_compaction(pointers);
+    EXPECT_FALSE(tempfile->is_compacting());
+    EXPECT_LT(tempfile->size(), old_size / 10);
+
+    // Read back all live lines from the new file
+    std::vector<std::string> expected = { "Garbage line number 0", "Garbage line number 50",
+                                          "Garbage line number 100", "Garbage line number 150",
+                                          "Written during compaction" };
+    tempfile->flush();
+    size_t index = 0;
+    for (const auto &seg : live) {
+        EXPECT_EQ(seg.file_descriptor, tempfile->fd());
+        EXPECT_EQ(seg.read_line_content(0), expected[index++]);
+    }
+
+    // Compaction is not started when most data is live
+    EXPECT_FALSE(tempfile->begin_compaction({ { 0, tempfile->size() } }));
+}
@@ -26,6 +26,7 @@ TEST_F(EditorDriver, VirtualPositionTypeBeyondLineContents)
     for (char ch : text_to_type) {
         editor->edit_insert_char(ch);
     }
+    editor->put_line(); // Commit line being edited
 
     // Verify the result: should pad with spaces then insert
     std::string result = editor->wksp_->read_line(0);
@@ -57,6 +58,7 @@ TEST_F(EditorDriver, VirtualPositionTypeBeyondFileEnd)
     for (char ch : text_to_type) {
         editor->edit_insert_char(ch);
     }
+    editor->put_line(); // Commit line being edited
 
     // Verify new lines were created with proper content
     // When typing at line 3, it should create blank lines for 1, 2, and content at 3
@@ -92,6 +94,7 @@ TEST_F(EditorDriver, VirtualPositionTypeBeyondLineContentsWithScroll)
     for (char ch : text_to_type) {
         editor->edit_insert_char(ch);
     }
+    editor->put_line(); // Commit line being edited
 
     // Verify the result: should pad with spaces then insert
     std::string result = editor->wksp_->read_line(0);
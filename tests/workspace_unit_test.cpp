@@ -1,9 +1,18 @@
 #include <fcntl.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <fstream>
+#include <regex>
+#include <thread>
 
 #include "WorkspaceDriver.h"
+#include "file_indexer.h"
+#include "filemap.h"
+#include "io_backend.h"
+#include "newline_scanner.h"
+#include "regex_search.h"
+#include "text_search.h"
 
 //
 // Test create_blank_lines - static functions
@@ -19,16 +28,17 @@ TEST_F(WorkspaceDriver, CreateBlankLines)
 
 TEST_F(WorkspaceDriver, CreateBlankLinesLarge)
 {
-    // Test with > 127 lines to verify segment splitting
-    std::list<Segment> seg_list = Workspace::create_blank_lines(200);
+    // Test with more lines than fit in one segment to verify splitting
+    int n                       = Segment::MAX_LINES + 200;
+    std::list<Segment> seg_list = Workspace::create_blank_lines(n);
 
-    EXPECT_FALSE(seg_list.empty());
+    EXPECT_EQ(seg_list.size(), 2);
     // Should split large line counts into multiple segments
     int total_lines = 0;
     for (const auto &seg : seg_list) {
         total_lines += seg.line_count;
     }
-    EXPECT_EQ(total_lines, 200);
+    EXPECT_EQ(total_lines, n);
 }
 
 //
@@ -447,3 +457,1265 @@ TEST_F(WorkspaceDriver, ComplexEditWorkflow)
     bool saved = wksp->write_file("complex_test_out.txt");
     EXPECT_TRUE(saved); // May be false if path issues, but shouldn't crash
 }
+
+//
+// Test segment tree: line lookup with many segments
+//
+TEST_F(WorkspaceDriver, SegmentTreeLineLookup)
+{
+    std::vector<std::string> lines;
+    for (int i = 0; i < 2000; ++i) {
+        lines.push_back("Line " + std::to_string(i));
+    }
+    wksp->load_text(lines);
+
+    // Fragment the file: rewrite every third line, which splits segments
+    for (int i = 0; i < 2000; i += 3) {
+        lines[i] = "Edited " + std::to_string(i);
+        wksp->put_line(i, lines[i]);
+    }
+    EXPECT_GT(wksp->get_contents().size(), 1000u);
+    EXPECT_EQ(wksp->total_line_count(), 2000);
+
+    // Every line must be found in a segment whose base line is consistent
+    for (int i = 1999; i >= 0; i -= 7) {
+        ASSERT_EQ(wksp->change_current_line(i), 0);
+        int base = wksp->current_segment_base_line();
+        EXPECT_LE(base, i);
+        EXPECT_LT(i, base + (int)wksp->cursegm()->line_count);
+        EXPECT_EQ(wksp->read_line(i), lines[i]);
+    }
+
+    // Base lines must agree with a linear walk over the segments
+    int base = 0;
+    for (auto it = wksp->get_contents().begin(); it != wksp->get_contents().end(); ++it) {
+        EXPECT_EQ(wksp->get_contents().base_line(it), base);
+        base += it->line_count;
+    }
+    EXPECT_EQ(base, 2000);
+}
+
+//
+// Test segment tree: random inserts and deletes against a plain vector model
+//
+TEST_F(WorkspaceDriver, SegmentTreeEditsMatchModel)
+{
+    std::vector<std::string> model;
+    for (int i = 0; i < 300; ++i) {
+        model.push_back("L" + std::to_string(i));
+    }
+    wksp->load_text(model);
+
+    unsigned seed = 12345;
+    auto next     = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7fff;
+    };
+    for (int step = 0; step < 200; ++step) {
+        int total = (int)model.size();
+        switch (next() % 3) {
+        case 0: {
+            // Insert blank lines
+            int at     = next() % (total + 1);
+            int n      = 1 + next() % 5;
+            auto blank = Workspace::create_blank_lines(n);
+            wksp->insert_contents(blank, at);
+            model.insert(model.begin() + at, n, "");
+            break;
+        }
+        case 1: {
+            // Delete a range of lines
+            if (total < 10)
+                break;
+            int from = next() % total;
+            int to   = std::min(total - 1, from + (int)(next() % 4));
+            wksp->delete_contents(from, to);
+            model.erase(model.begin() + from, model.begin() + to + 1);
+            break;
+        }
+        default: {
+            // Replace a line
+            int at    = next() % total;
+            model[at] = "S" + std::to_string(step);
+            wksp->put_line(at, model[at]);
+            break;
+        }
+        }
+        ASSERT_EQ(wksp->total_line_count(), (int)model.size());
+    }
+
+    for (int i = 0; i < (int)model.size(); ++i) {
+        EXPECT_EQ(wksp->read_line(i), model[i]);
+    }
+}
+
+//
+// Test byte offset lookups: line_to_offset and offset_to_line agree with prefix sums
+//
+TEST_F(WorkspaceDriver, LineOffsetMapping)
+{
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000; ++i) {
+        lines.push_back(std::string(i % 17, 'x'));
+    }
+    wksp->load_text(lines);
+
+    // Fragment the file, changing line lengths
+    for (int i = 0; i < 1000; i += 5) {
+        lines[i] = "Edited line " + std::to_string(i);
+        wksp->put_line(i, lines[i]);
+    }
+    auto blank = Workspace::create_blank_lines(3);
+    wksp->insert_contents(blank, 500);
+    lines.insert(lines.begin() + 500, 3, "");
+    wksp->delete_contents(100, 109);
+    lines.erase(lines.begin() + 100, lines.begin() + 110);
+
+    long offset = 0;
+    for (int i = 0; i < (int)lines.size(); ++i) {
+        ASSERT_EQ(wksp->line_to_offset(i), offset);
+        EXPECT_EQ(wksp->offset_to_line(offset), i);
+        EXPECT_EQ(wksp->offset_to_line(offset + (long)lines[i].size()), i);
+        offset += lines[i].size() + 1;
+    }
+
+    // Positions past the end
+    EXPECT_EQ(wksp->line_to_offset((int)lines.size()), offset);
+    EXPECT_EQ(wksp->offset_to_line(offset), (int)lines.size());
+    EXPECT_EQ(wksp->offset_to_line(offset + 1000), (int)lines.size());
+    EXPECT_EQ(wksp->offset_to_line(-5), 0);
+}
+
+//
+// Test reading lines of original file through the memory mapping
+//
+TEST_F(WorkspaceDriver, MappedFileRead)
+{
+    std::string filename = "MappedFileRead.txt";
+    std::ofstream f(filename);
+    for (int i = 0; i < 5000; ++i) {
+        f << "Line " << i << " " << std::string(i % 50, '*') << '\n';
+    }
+    f.close();
+
+    wksp->load_file(OpenFile(filename));
+    ASSERT_EQ(wksp->total_line_count(), 5000);
+
+    for (int i = 4999; i >= 0; i -= 13) {
+        EXPECT_EQ(wksp->read_line(i), "Line " + std::to_string(i) + " " + std::string(i % 50, '*'));
+    }
+
+    // Modified lines come from the temp file, neighbours still from the mapping
+    wksp->put_line(100, "Changed");
+    EXPECT_EQ(wksp->read_line(99), "Line 99 " + std::string(49, '*'));
+    EXPECT_EQ(wksp->read_line(100), "Changed");
+    EXPECT_EQ(wksp->read_line(101), "Line 101 " + std::string(1, '*'));
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that truncating the file under the mapping does not crash the editor
+//
+TEST_F(WorkspaceDriver, MappedFileTruncated)
+{
+    std::string filename = "MappedFileTruncated.txt";
+    std::ofstream f(filename);
+    for (int i = 0; i < 2000; ++i) {
+        f << "Line " << i << " " << std::string(40, '-') << '\n';
+    }
+    f.close();
+
+    wksp->load_file(OpenFile(filename));
+    ASSERT_EQ(wksp->total_line_count(), 2000);
+    EXPECT_EQ(wksp->read_line(0), "Line 0 " + std::string(40, '-'));
+
+    // Another process shrinks the file
+    ASSERT_EQ(truncate(filename.c_str(), 10), 0);
+
+    // Lines past the new end read as zeroes instead of raising SIGBUS
+    std::string tail = wksp->read_line(1999);
+    EXPECT_EQ(tail.size(), std::string("Line 1999 ").size() + 40);
+
+    // Remaining bytes of the file are still readable
+    EXPECT_EQ(wksp->read_line(0).substr(0, 6), "Line 0");
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that files mapped by several threads at once get their own slots for the signal guard
+//
+TEST_F(WorkspaceDriver, MappedFileTruncatedOnThreads)
+{
+    const int nthreads = 8;
+    std::vector<std::string> filenames;
+    std::vector<int> fds;
+    for (int t = 0; t < nthreads; ++t) {
+        filenames.push_back("MappedFileTruncatedOnThreads" + std::to_string(t) + ".txt");
+        std::ofstream f(filenames.back());
+        f << std::string(64 * 1024, 'x');
+        f.close();
+        fds.push_back(open(filenames.back().c_str(), O_RDONLY));
+        ASSERT_GE(fds.back(), 0);
+    }
+
+    // All threads map their files at once, and keep them mapped
+    std::atomic<int> ready{ 0 }, truncated{ 0 };
+    std::vector<char> stale(nthreads, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.emplace_back([&, t] {
+            Filemap map;
+            for (int i = 0; i < 1000; ++i) {
+                map.map(fds[t]);
+                map.unmap();
+            }
+            ready++;
+            while (ready < nthreads) {
+                std::this_thread::yield();
+            }
+            bool mapped = map.map(fds[t]);
+            ready++;
+            while (!truncated) {
+                std::this_thread::yield();
+            }
+            if (!mapped)
+                return;
+
+            // Bytes past the new end read as zeroes instead of raising SIGBUS
+            const char *last = map.bytes(map.size() - 1, 1);
+            stale[t]         = (*last == 0) && map.is_stale();
+        });
+    }
+    while (ready < 2 * nthreads) {
+        std::this_thread::yield();
+    }
+    for (auto &filename : filenames) {
+        ASSERT_EQ(truncate(filename.c_str(), 10), 0);
+    }
+    truncated = 1;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < nthreads; ++t) {
+        EXPECT_TRUE(stale[t]) << "thread " << t;
+        close(fds[t]);
+        std::remove(filenames[t].c_str());
+    }
+}
+
+//
+// Test borrowed line views: mapping-backed and scratch-buffer-backed lines
+//
+TEST_F(WorkspaceDriver, ReadLineView)
+{
+    std::string filename = "ReadLineView.txt";
+    std::ofstream f(filename);
+    for (int i = 0; i < 300; ++i) {
+        f << "Original " << i << '\n';
+    }
+    f.close();
+
+    wksp->load_file(OpenFile(filename));
+    wksp->put_line(10, "A rather long modified line number ten");
+    wksp->put_line(20, "Short");
+
+    EXPECT_EQ(wksp->read_line_view(9), "Original 9");
+    EXPECT_EQ(wksp->read_line_view(10), "A rather long modified line number ten");
+    EXPECT_EQ(wksp->read_line_view(20), "Short");
+    EXPECT_EQ(wksp->read_line_view(299), "Original 299");
+    EXPECT_TRUE(wksp->read_line_view(300).empty());
+
+    // Lines in the unwritten tail of temp file are served from memory
+    EXPECT_NE(tempfile->unflushed_bytes(0, 1), nullptr);
+
+    // Lines from temp file are read once, into the line cache
+    tempfile->flush();
+    EXPECT_EQ(wksp->read_line_view(10), "A rather long modified line number ten");
+    const char *cached = wksp->read_line_view(10).data();
+    EXPECT_EQ(wksp->read_line_view(20), "Short");
+    EXPECT_EQ(wksp->read_line_view(10).data(), cached);
+
+    // Without cache, they share one scratch buffer, without reallocation
+    wksp->set_line_cache_capacity(0);
+    EXPECT_EQ(wksp->read_line_view(10), "A rather long modified line number ten");
+    const char *first  = wksp->read_line_view(10).data();
+    const char *second = wksp->read_line_view(20).data();
+    EXPECT_EQ(first, second);
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that all newline scanners find the same positions
+//
+TEST_F(WorkspaceDriver, NewlineScannerMethodsAgree)
+{
+    // Newlines at every alignment, including buffer tail shorter than a vector
+    std::string data;
+    unsigned seed = 12345;
+    for (int i = 0; i < 1000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data += ((seed >> 16) % 5 == 0) ? '\n' : char('a' + i % 26);
+    }
+    data[0] = data[63] = data[64] = '\n';
+
+    NewlineScanner reference(NewlineScanner::SCALAR);
+    for (auto method : { NewlineScanner::MEMCHR, NewlineScanner::SSE2, NewlineScanner::AVX2 }) {
+        if (!NewlineScanner::is_supported(method))
+            continue;
+        NewlineScanner scanner(method);
+        for (size_t start : { 0, 1, 7, 31 }) {
+            for (size_t len : { 0, 15, 33, 500, 969 }) {
+                std::vector<unsigned> expected, actual;
+                reference.scan(data.data() + start, len, expected);
+                scanner.scan(data.data() + start, len, actual);
+                EXPECT_EQ(actual, expected) << "method " << method << " at " << start;
+            }
+        }
+    }
+}
+
+//
+// Test loading lines which span read blocks, and last line without newline
+//
+TEST_F(WorkspaceDriver, LoadFileAcrossReadBlocks)
+{
+    std::string filename = "LoadFileAcrossReadBlocks.txt";
+    std::string big(3 * 1024 * 1024, 'B');
+    std::ofstream f(filename);
+    f << "first\n" << big << "\n\nlast";
+    f.close();
+
+    wksp->load_file(OpenFile(filename));
+    ASSERT_EQ(wksp->total_line_count(), 4);
+
+    EXPECT_EQ(wksp->read_line(0), "first");
+    EXPECT_EQ(wksp->read_line(1), big);
+    EXPECT_EQ(wksp->read_line(2), "");
+    EXPECT_EQ(wksp->read_line(3), "last");
+
+    // Missing newline is counted, as when saved
+    EXPECT_EQ(wksp->get_contents().total_bytes(), 6 + big.size() + 1 + 1 + 5);
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that parallel indexing gives the same segments as sequential one
+//
+TEST_F(WorkspaceDriver, ParallelIndexMatchesSequential)
+{
+    const long stripe = FileIndexer::STRIPE_SIZE;
+    std::string content;
+    content.reserve(2 * stripe + stripe / 2);
+
+    // Short lines up to the middle of first stripe boundary
+    for (int i = 0; (long)content.size() < stripe - 500; ++i) {
+        content += std::string(i % 90, 'a' + i % 26) + '\n';
+    }
+    // Line across the boundary
+    content += std::string(stripe + 1000 - content.size(), 'X') + '\n';
+
+    // Next line starts exactly at the second boundary
+    for (int i = 0; (long)content.size() < 2 * stripe - 200; ++i) {
+        content += std::string(i % 70, 'b') + '\n';
+    }
+    content += std::string(2 * stripe - content.size() - 1, 'Y') + '\n';
+
+    // Tail without final newline
+    for (int i = 0; i < 10000; ++i) {
+        content += "line " + std::to_string(i) + '\n';
+    }
+    content += "no newline";
+
+    std::string filename = "ParallelIndexMatchesSequential.txt";
+    std::ofstream f(filename);
+    f << content;
+    f.close();
+
+    wksp->set_index_threads(1);
+    wksp->load_file(OpenFile(filename));
+    std::vector<Segment> expected(wksp->get_contents().begin(), wksp->get_contents().end());
+
+    wksp->set_index_threads(4);
+    wksp->load_file(OpenFile(filename));
+    std::vector<Segment> actual(wksp->get_contents().begin(), wksp->get_contents().end());
+
+    ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(actual[i].file_offset, expected[i].file_offset) << "segment " << i;
+        EXPECT_EQ(actual[i].line_count, expected[i].line_count) << "segment " << i;
+        EXPECT_TRUE(actual[i].line_lengths == expected[i].line_lengths) << "segment " << i;
+    }
+    EXPECT_EQ(wksp->get_contents().total_bytes(), (long)content.size() + 1);
+    EXPECT_EQ(wksp->read_line(wksp->total_line_count() - 1), "no newline");
+
+    // Segments do not cross stripe boundaries
+    for (const auto &seg : actual) {
+        EXPECT_EQ(seg.file_offset / stripe,
+                  (seg.file_offset + seg.line_lengths.offset_of(seg.line_count - 1)) / stripe);
+    }
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that all I/O backends load and save the same
+//
+TEST_F(WorkspaceDriver, IoBackendsAgree)
+{
+    std::string content;
+    for (int i = 0; content.size() < 3 * 1024 * 1024; ++i) {
+        content += std::to_string(i) + std::string(i % 100, ' ' + i % 90) + '\n';
+    }
+    content += "no newline";
+
+    std::string filename = "IoBackendsAgree.txt";
+    std::ofstream f(filename);
+    f << content;
+    f.close();
+
+    std::vector<Segment> expected;
+    for (const char *name : { "pread", "mmap", "uring" }) {
+        ASSERT_TRUE(IoBackend::select(name));
+        EXPECT_STREQ(IoBackend::get().name(), name);
+
+        // Read a range in blocks
+        int fd = OpenFile(filename);
+        std::string data;
+        EXPECT_TRUE(IoBackend::get().read(fd, 1000, 2500000, [&](const char *ptr, size_t len) {
+            data.append(ptr, len);
+            return true;
+        }));
+        EXPECT_EQ(data, content.substr(1000, 2500000)) << name;
+
+        // Read to end of file, stopping early
+        data.clear();
+        EXPECT_TRUE(IoBackend::get().read(fd, 5, -1, [&](const char *ptr, size_t len) {
+            data.append(ptr, len);
+            return data.size() < 1500000;
+        }));
+        EXPECT_EQ(data, content.substr(5, data.size())) << name;
+        EXPECT_GE(data.size(), 1500000u) << name;
+        EXPECT_LT(data.size(), content.size() - 5) << name;
+
+        // Load
+        wksp->set_index_threads(1);
+        wksp->load_file(fd);
+        std::vector<Segment> actual(wksp->get_contents().begin(), wksp->get_contents().end());
+        if (expected.empty()) {
+            expected = actual;
+        }
+        ASSERT_EQ(actual.size(), expected.size()) << name;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            EXPECT_EQ(actual[i].file_offset, expected[i].file_offset) << name << " segment " << i;
+            EXPECT_TRUE(actual[i].line_lengths == expected[i].line_lengths) << name;
+        }
+
+        // Save
+        std::string outname = std::string("IoBackendsAgree.") + name;
+        EXPECT_TRUE(wksp->write_file(outname));
+        std::ifstream in(outname);
+        std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(saved, content) << name;
+        std::remove(outname.c_str());
+    }
+    IoBackend::select("pread");
+    EXPECT_FALSE(IoBackend::select("bogus"));
+    EXPECT_STREQ(IoBackend::get().name(), "pread");
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that saving edited file copies unchanged ranges intact, in kernel or through buffer
+//
+TEST_F(WorkspaceDriver, WriteFileCopiesUnchangedRanges)
+{
+    std::vector<std::string> lines;
+    std::string content;
+    for (int i = 0; i < 50000; ++i) {
+        lines.push_back("line " + std::to_string(i) + std::string(i % 60, '-'));
+        content += lines.back() + '\n';
+    }
+    std::string filename = "WriteFileCopiesUnchangedRanges.txt";
+    std::ofstream f(filename);
+    f << content;
+    f.close();
+
+    for (bool kernel_copy : { true, false }) {
+        IoBackend::enable_kernel_copy(kernel_copy);
+        wksp->set_index_threads(1);
+        wksp->load_file(OpenFile(filename));
+        ASSERT_GT(wksp->get_contents().size(), 2u);
+
+        // Edit a line in the middle, and add blank lines past the end
+        wksp->put_line(30000, "edited");
+        wksp->split(50010);
+
+        std::string outname = "WriteFileCopiesUnchangedRanges.out";
+        EXPECT_TRUE(wksp->write_file(outname));
+        std::ifstream in(outname);
+        std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        std::string expected;
+        for (int i = 0; i < 50000; ++i) {
+            expected += (i == 30000 ? std::string("edited") : lines[i]) + '\n';
+        }
+        EXPECT_EQ(saved.size(), expected.size()) << "kernel copy " << kernel_copy;
+        EXPECT_TRUE(saved == expected) << "kernel copy " << kernel_copy;
+        std::remove(outname.c_str());
+    }
+    IoBackend::enable_kernel_copy(true);
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that background save writes the snapshot taken at start, while editing continues
+//
+TEST_F(WorkspaceDriver, BackgroundSaveWritesSnapshot)
+{
+    std::string content;
+    for (int i = 0; i < 200000; ++i) {
+        content += "line " + std::to_string(i) + '\n';
+    }
+    std::string filename = "BackgroundSaveWritesSnapshot.txt";
+    std::ofstream f(filename);
+    f << content;
+    f.close();
+
+    wksp->load_file(OpenFile(filename));
+    wksp->put_line(5, "edited before save");
+    content.replace(content.find("line 5\n"), 6, "edited before save");
+
+    std::string outname = "BackgroundSaveWritesSnapshot.out";
+    wksp->start_save(outname);
+    EXPECT_TRUE(wksp->is_saving());
+    EXPECT_EQ(wksp->save_size(), (long)content.size());
+
+    // Edits after the snapshot do not get into the file
+    wksp->put_line(7, "edited during save");
+    wksp->put_line(150000, "edited during save");
+    wksp->delete_contents(1000, 2000);
+
+    EXPECT_TRUE(wksp->wait_save());
+    EXPECT_FALSE(wksp->is_saving());
+    EXPECT_EQ(wksp->save_progress(), wksp->save_size());
+    bool ok = false;
+    EXPECT_FALSE(wksp->poll_save(ok));
+
+    std::ifstream in(outname);
+    std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(saved == content);
+    EXPECT_EQ(wksp->read_line(7), "edited during save");
+
+    // Completion is reported by poll_save()
+    wksp->start_save(outname);
+    while (!wksp->poll_save(ok)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(ok);
+
+    // Failure to create the file
+    wksp->start_save("no/such/dir/file.txt");
+    EXPECT_FALSE(wksp->wait_save());
+
+    // Incomplete last line gets its newline only when followed by more text
+    {
+        std::ofstream g(filename);
+        g << "a\nb";
+    }
+    wksp->load_file(OpenFile(filename));
+    EXPECT_TRUE(wksp->write_file(outname));
+    std::ifstream unchanged(outname);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(unchanged), {}), "a\nb");
+    wksp->put_line(2, "c");
+    EXPECT_TRUE(wksp->write_file(outname));
+    std::ifstream appended(outname);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(appended), {}), "a\nb\nc\n");
+
+    // Full disk fails the save, for blank lines and for copied ranges
+    if (access("/dev/full", W_OK) == 0) {
+        EXPECT_FALSE(wksp->write_file("/dev/full"));
+        wksp->load_text("\n\n\nx\n");
+        EXPECT_FALSE(wksp->write_file("/dev/full"));
+    }
+
+    std::remove(outname.c_str());
+    std::remove(filename.c_str());
+}
+
+//
+// Test that large file is indexed in background, and lines past the frontier wait for it
+//
+TEST_F(WorkspaceDriver, BackgroundIndexing)
+{
+    std::string filename = "BackgroundIndexing.txt";
+    std::ofstream f(filename);
+    const int nlines = 400000;
+    for (int i = 0; i < nlines; ++i) {
+        f << "Line " << i << " " << std::string(i % 80, '.') << '\n';
+    }
+    f.close();
+
+    wksp->set_index_threads(2);
+    wksp->load_file_in_background(OpenFile(filename));
+
+    // Only the beginning is available at once
+    EXPECT_TRUE(wksp->is_indexing());
+    EXPECT_GT(wksp->total_line_count(), 1000);
+    EXPECT_LT(wksp->total_line_count(), nlines);
+    EXPECT_EQ(wksp->read_line(0), "Line 0 ");
+    EXPECT_TRUE(wksp->is_indexed(0));
+    EXPECT_FALSE(wksp->is_indexed(nlines - 1));
+    EXPECT_TRUE(wksp->is_indexing());
+
+    // Reading past the frontier waits for it
+    EXPECT_EQ(wksp->read_line(nlines - 1), "Line 399999 " + std::string(399999 % 80, '.'));
+    EXPECT_TRUE(wksp->has_line(nlines - 1));
+    EXPECT_FALSE(wksp->has_line(nlines));
+    EXPECT_FALSE(wksp->is_indexing());
+    EXPECT_TRUE(wksp->is_indexed(nlines));
+    EXPECT_EQ(wksp->total_line_count(), nlines);
+
+    // Edits while indexing keep the order of lines
+    wksp->load_file_in_background(OpenFile(filename));
+    wksp->put_line(10, "Changed");
+    wksp->finish_indexing();
+    EXPECT_EQ(wksp->total_line_count(), nlines);
+    EXPECT_EQ(wksp->read_line(10), "Changed");
+    EXPECT_EQ(wksp->read_line(200000), "Line 200000 " + std::string(200000 % 80, '.'));
+
+    // Loading another file stops indexing
+    wksp->load_file_in_background(OpenFile(filename));
+    wksp->load_text("Other\n");
+    EXPECT_FALSE(wksp->is_indexing());
+    EXPECT_EQ(wksp->total_line_count(), 1);
+
+    std::remove(filename.c_str());
+}
+
+TEST_F(WorkspaceDriver, DamageTracksChangedLines)
+{
+    long first, last;
+
+    // Loaded text is damaged as a whole
+    wksp->load_text("one\ntwo\nthree\nfour\n");
+    ASSERT_TRUE(wksp->take_damage(first, last));
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, LONG_MAX);
+    EXPECT_FALSE(wksp->take_damage(first, last));
+
+    // Replaced line alone
+    wksp->put_line(2, "THREE");
+    ASSERT_TRUE(wksp->take_damage(first, last));
+    EXPECT_EQ(first, 2);
+    EXPECT_EQ(last, 3);
+
+    // Lines below deletion are shifted
+    wksp->delete_contents(1, 1);
+    ASSERT_TRUE(wksp->take_damage(first, last));
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(last, LONG_MAX);
+
+    // Several changes are combined
+    wksp->undo_checkpoint();
+    wksp->put_line(0, "ONE");
+    wksp->put_line(2, "FOUR");
+    ASSERT_TRUE(wksp->take_damage(first, last));
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 3);
+
+    // Undo of replacements damages the same lines
+    wksp->undo();
+    ASSERT_TRUE(wksp->take_damage(first, last));
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(last, 3);
+
+    // Reading does not damage anything
+    wksp->read_line(1);
+    EXPECT_FALSE(wksp->take_damage(first, last));
+}
+
+TEST_F(WorkspaceDriver, LineCacheCountsHitsAndMisses)
+{
+    wksp->load_text("one\ntwo\nthree\nfour\n");
+    tempfile->flush();
+
+    // Lines in temp file are read once
+    EXPECT_EQ(wksp->read_line(1), "two");
+    EXPECT_EQ(wksp->read_line(1), "two");
+    EXPECT_EQ(wksp->read_line(2), "three");
+    auto stats = wksp->line_cache_stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.size, 2u);
+
+    // Replaced line is read again
+    wksp->put_line(1, "TWO");
+    tempfile->flush();
+    EXPECT_EQ(wksp->read_line(1), "TWO");
+    EXPECT_EQ(wksp->read_line(2), "three");
+    stats = wksp->line_cache_stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 3u);
+
+    // Lines below deletion have moved
+    wksp->delete_contents(0, 0);
+    EXPECT_EQ(wksp->read_line(1), "three");
+    EXPECT_EQ(wksp->read_line(0), "TWO");
+    stats = wksp->line_cache_stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 5u);
+
+    // Least recently used line is evicted
+    wksp->set_line_cache_capacity(2);
+    EXPECT_EQ(wksp->read_line(2), "four");
+    EXPECT_EQ(wksp->read_line(0), "TWO");
+    EXPECT_EQ(wksp->read_line(1), "three");
+    stats = wksp->line_cache_stats();
+    EXPECT_EQ(stats.hits, 3u);
+    EXPECT_EQ(stats.misses, 7u);
+    EXPECT_EQ(stats.evictions, 2u);
+    EXPECT_EQ(stats.size, 2u);
+}
+
+//
+// Test that substring search agrees with std::string
+//
+TEST_F(WorkspaceDriver, SubstringSearchAgrees)
+{
+    std::string data;
+    unsigned seed = 4321;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data += "abc\n"[(seed >> 16) % 4];
+    }
+    const char *needles[] = { "a", "ab", "abc", "cab", "bcab", "aaa", "ca\nb", "abcabcabc" };
+    for (auto method : { SubstringSearch::BMH, SubstringSearch::SSE2, SubstringSearch::AVX2 }) {
+        for (const char *needle : needles) {
+            SubstringSearch pattern(needle, method);
+            for (size_t len : { (size_t)0, (size_t)1, (size_t)7, (size_t)100, data.size() }) {
+                std::string_view block(data.data(), len);
+                size_t first = block.find(needle);
+                size_t last  = block.rfind(needle);
+                EXPECT_EQ(pattern.find(block.data(), len),
+                          first == std::string::npos ? -1 : (long)first)
+                    << needle << " in " << len << " by method " << pattern.method();
+                EXPECT_EQ(pattern.rfind(block.data(), len),
+                          last == std::string::npos ? -1 : (long)last)
+                    << needle << " in " << len << " by method " << pattern.method();
+            }
+        }
+    }
+}
+
+//
+// Test that regular expression search agrees with std::regex, line by line
+//
+TEST_F(WorkspaceDriver, RegexSearchAgrees)
+{
+    std::string data;
+    unsigned seed = 1234;
+    for (int i = 0; i < 3000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data += "abc1 \n"[(seed >> 16) % 6];
+    }
+    const char *patterns[] = {
+        "a",        "abc",       "ab+c",     "^a",         "c$",      "^$",      "a|bc",
+        "(ab)*c",   "[a-b]{2,}", "[^a ]+1",  "\\d\\s\\w", "b.?a",    "^(a|b)*$", "c{2}",
+        "x*",       "a(b|1)c",   "ab{1,2}c", "\\.|c1",     "[1\\]]b",  "\\Wa",     "(^| )a",
+        "[ab]+c1$",
+    };
+
+    // Positions where a match starts
+    for (const char *text : patterns) {
+        std::regex expr(text);
+        std::vector<long> starts;
+        size_t line = 0;
+        for (size_t pos = 0; pos <= data.size(); ++pos) {
+            size_t end = data.find('\n', line);
+            if (end == std::string::npos)
+                end = data.size();
+            auto flags = std::regex_constants::match_continuous;
+            if (pos > line)
+                flags |= std::regex_constants::match_not_bol;
+            if (std::regex_search(data.begin() + pos, data.begin() + end, expr, flags))
+                starts.push_back(pos);
+            if (pos == end)
+                line = end + 1;
+        }
+
+        RegexSearch pattern(text);
+        ASSERT_TRUE(pattern.valid()) << text << ": " << pattern.error();
+        for (size_t from = 0; from < data.size(); from += 97) {
+            auto next = std::lower_bound(starts.begin(), starts.end(), (long)from);
+            auto prev = std::upper_bound(starts.begin(), starts.end(), (long)from);
+            EXPECT_EQ(pattern.find_from(data.data(), data.size(), from),
+                      next == starts.end() ? -1 : *next)
+                << text << " from " << from;
+            EXPECT_EQ(pattern.rfind_upto(data.data(), data.size(), from),
+                      prev == starts.begin() ? -1 : prev[-1])
+                << text << " up to " << from;
+        }
+    }
+}
+
+TEST_F(WorkspaceDriver, RegexSearchSyntax)
+{
+    // Fixed strings which are a part of every match
+    RegexSearch hello("Hello, w[a-z]+d");
+    EXPECT_EQ(hello.literal(), "Hello, w");
+    EXPECT_TRUE(hello.literal_is_prefix());
+    EXPECT_EQ(RegexSearch("^abc*").literal(), "ab");
+    EXPECT_EQ(RegexSearch("ab+c").literal(), "ab");
+    EXPECT_EQ(RegexSearch("a\\.b").literal(), "a.b");
+    EXPECT_EQ(RegexSearch("ab|cd").literal(), "");
+    EXPECT_EQ(RegexSearch("(ab|cd)").literal(), "");
+    EXPECT_EQ(RegexSearch("(ab){2}x").literal(), "x");
+    RegexSearch took("took [0-9]+ ?ms$");
+    EXPECT_EQ(took.literal(), "took ");
+    RegexSearch millis("[0-9]+ms$");
+    EXPECT_EQ(millis.literal(), "ms");
+    EXPECT_FALSE(millis.literal_is_prefix());
+    EXPECT_EQ(RegexSearch("a.bcd(e|f)+g?h").literal(), "bcd");
+    EXPECT_EQ(RegexSearch("\\d+").literal(), "");
+
+    EXPECT_EQ(RegexSearch("(ab").error(), "Unmatched (");
+    EXPECT_EQ(RegexSearch("ab)").error(), "Unmatched )");
+    EXPECT_EQ(RegexSearch("[ab").error(), "Unmatched [");
+    EXPECT_EQ(RegexSearch("*a").error(), "Nothing to repeat");
+    EXPECT_EQ(RegexSearch("a{2,1}").error(), "Bad repetition");
+    EXPECT_EQ(RegexSearch("a{x}").error(), "Bad repetition");
+    EXPECT_EQ(RegexSearch("a\\").error(), "Trailing backslash");
+    EXPECT_EQ(RegexSearch("(a{1000}){1000}").error(), "Pattern too large");
+
+    // Never matches across a line
+    std::string text = "ab\ncd\n";
+    EXPECT_EQ(RegexSearch("b.c").find_from(text.data(), text.size(), 0), -1);
+    EXPECT_EQ(RegexSearch("b[^x]c").find_from(text.data(), text.size(), 0), -1);
+    EXPECT_EQ(RegexSearch("b\\sc").find_from(text.data(), text.size(), 0), -1);
+    EXPECT_EQ(RegexSearch("b$").find_from(text.data(), text.size(), 0), 1);
+    EXPECT_EQ(RegexSearch("^c").rfind_upto(text.data(), text.size(), 5), 3);
+    EXPECT_EQ(RegexSearch("^$").find_from(text.data(), text.size(), 0), -1);
+    EXPECT_EQ(RegexSearch("x*").rfind_upto(text.data(), text.size(), 5), 5);
+
+    // DFA cache is flushed when full, and search goes on
+    std::string words;
+    for (int i = 0; i < 5000; ++i) {
+        words += "abcdefghij"[i * 7 % 10];
+    }
+    words += "a123456789b\n";
+    RegexSearch many("a.........b");
+    EXPECT_EQ(many.find_from(words.data(), words.size(), 0), 5000);
+    EXPECT_LE(many.dfa_states(), 2 * RegexSearch::MAX_DFA_STATES);
+}
+
+//
+// Test that search on worker threads finds the same matches as one thread
+//
+TEST_F(WorkspaceDriver, ParallelSearchMatchesSequential)
+{
+    const long chunk = Workspace::SEARCH_CHUNK_SIZE;
+    std::string filename = "ParallelSearchMatchesSequential.txt";
+    std::ofstream f(filename);
+    std::vector<int> needles;
+    long size = 0;
+    for (int i = 0; size < 3 * chunk; ++i) {
+        std::string line = std::string(i % 90, 'a' + i % 26);
+        if (i % 150000 == 77 || i == 5) {
+            line += "needle";
+            needles.push_back(i);
+        }
+        f << line << '\n';
+        size += line.size() + 1;
+    }
+    f.close();
+    wksp->load_file(OpenFile(filename));
+    ASSERT_GE(needles.size(), 4u);
+
+    RegexSearch pattern("ne+dle$");
+    for (int start : { 0, 6, needles[1], needles[2] + 1, wksp->total_line_count() - 1 }) {
+        for (bool forward : { true, false }) {
+            int expected_line = 0, expected_col = 0;
+            for (unsigned threads : { 1, 4 }) {
+                wksp->set_search_threads(threads);
+                int line = start, col = 0;
+                bool found = forward ? wksp->find_forward(pattern, line, col, true)
+                                     : wksp->find_backward(pattern, line, col, true);
+                ASSERT_TRUE(found);
+                if (threads == 1) {
+                    expected_line = line;
+                    expected_col  = col;
+                } else {
+                    EXPECT_EQ(line, expected_line) << "from " << start << " forward " << forward;
+                    EXPECT_EQ(col, expected_col);
+                }
+            }
+
+            // The nearest needle in search order, with wrap around.
+            // Search starts at column 0, before the needle of that line.
+            auto next = std::lower_bound(needles.begin(), needles.end(), start);
+            if (forward) {
+                EXPECT_EQ(expected_line, next == needles.end() ? needles.front() : *next);
+            } else {
+                EXPECT_EQ(expected_line, next == needles.begin() ? needles.back() : next[-1]);
+            }
+        }
+    }
+
+    // Without wrap, nothing is found past the last needle
+    int line = needles.back() + 1, col = 0;
+    EXPECT_FALSE(wksp->find_forward(pattern, line, col));
+
+    // Cancelled search finds nothing
+    std::atomic<bool> cancel{ true };
+    line = 0;
+    EXPECT_FALSE(wksp->find_forward(pattern, line, col, true, &cancel));
+    line = 0;
+    EXPECT_FALSE(wksp->find_backward(pattern, line, col, true, &cancel));
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that matches in the buffered tail of a temp file segment are counted
+//
+TEST_F(WorkspaceDriver, MatchIndexPartlyBufferedSegment)
+{
+    wksp->load_text(std::vector<std::string>{ "a", "b", "z" });
+    tempfile->flush();
+    wksp->put_line(0, "aaa");
+    tempfile->flush();
+    wksp->put_line(1, "needle");
+
+    SubstringSearch pattern("e");
+    wksp->index_matches(pattern, "l:e");
+    while (!wksp->matches_indexed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    long rank = 0, total = 0;
+    ASSERT_TRUE(wksp->match_rank(1, 2, rank, total));
+    EXPECT_EQ(rank, 2);
+    EXPECT_EQ(total, 3);
+
+    int line = 0, col = 0;
+    ASSERT_TRUE(wksp->next_match(line, col, true));
+    EXPECT_EQ(std::make_pair(line, col), std::make_pair(1, 1));
+}
+
+//
+// Test search in a temp file segment which is partly written and partly buffered
+//
+TEST_F(WorkspaceDriver, SearchSegmentPartlyBuffered)
+{
+    wksp->load_text(std::vector<std::string>{ "a", "b", "z" });
+    tempfile->flush();
+    wksp->put_line(0, "aaa");
+    tempfile->flush();
+    wksp->put_line(1, "needle");
+    ASSERT_EQ(wksp->read_line(1), "needle");
+
+    SubstringSearch pattern("needle");
+    int line = 0, col = 0;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 1);
+    EXPECT_EQ(col, 0);
+    line = 2;
+    ASSERT_TRUE(wksp->find_backward(pattern, line, col));
+    EXPECT_EQ(line, 1);
+}
+
+TEST_F(WorkspaceDriver, MatchIndexSurvivesEdits)
+{
+    std::string filename = "MatchIndexSurvivesEdits.txt";
+    std::ofstream f(filename);
+    for (int i = 0; i < 5000; ++i) {
+        f << std::string(i % 5, 'x') << (i % 3 == 0 ? "ab" : "") << (i % 7 == 0 ? " ab ab" : "")
+          << '\n';
+    }
+    f.close();
+    wksp->load_file(OpenFile(filename));
+
+    SubstringSearch pattern("ab");
+    wksp->index_matches(pattern, "l:ab");
+    while (!wksp->matches_indexed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Every match is visited by next_match() in order, and has its rank
+    auto check = [&]() {
+        std::vector<std::pair<int, int>> expected;
+        for (int i = 0; i < wksp->total_line_count(); ++i) {
+            std::string text = wksp->read_line(i);
+            for (size_t pos = text.find("ab"); pos != std::string::npos;
+                 pos        = text.find("ab", pos + 1)) {
+                expected.push_back({ i, (int)pos });
+            }
+        }
+        ASSERT_FALSE(expected.empty());
+        int line = expected.back().first, col = expected.back().second;
+        for (size_t k = 0; k < expected.size(); ++k) {
+            ASSERT_TRUE(wksp->next_match(line, col, true));
+            ASSERT_EQ(std::make_pair(line, col), expected[k]) << "match " << k;
+            long rank = 0, total = 0;
+            ASSERT_TRUE(wksp->match_rank(line, col, rank, total));
+            EXPECT_EQ(rank, (long)k + 1);
+            EXPECT_EQ(total, (long)expected.size());
+        }
+        line = expected[0].first;
+        col  = expected[0].second;
+        // Backward from the first match wraps to the last one
+        for (size_t k = expected.size(); k-- > 0;) {
+            ASSERT_TRUE(wksp->next_match(line, col, false));
+            ASSERT_EQ(std::make_pair(line, col), expected[k]) << "match " << k;
+        }
+        long rank, total;
+        EXPECT_FALSE(wksp->match_rank(expected[0].first, expected[0].second + 1, rank, total));
+    };
+    check();
+
+    // Edits are seen by the index
+    wksp->put_line(3, "abab");
+    wksp->put_line(4998, "no match");
+    wksp->delete_contents(100, 110);
+    check();
+    wksp->put_line(0, "ab");
+    check();
+
+    // Matches in temp file are found again after it was compacted
+    wksp->forget_temp_matches();
+    check();
+
+    // Index is abandoned when contents are discarded
+    wksp->load_text("ab\n");
+    EXPECT_FALSE(wksp->matches_indexed());
+    int line = 0, col = 0;
+    EXPECT_FALSE(wksp->next_match(line, col, true));
+
+    std::remove(filename.c_str());
+}
+
+TEST_F(WorkspaceDriver, SubstituteChangesOnlyMatchingLines)
+{
+    std::string filename = "SubstituteChangesOnlyMatchingLines.txt";
+    std::ofstream f(filename);
+    std::vector<std::string> lines;
+    for (int i = 0; i < 50000; ++i) {
+        bool apple = (i % 1000 == 7 || i == 8);
+        lines.push_back(apple ? "one apple, two apples" : "line " + std::to_string(i));
+        f << lines.back() << '\n';
+    }
+    f.close();
+    wksp->load_file(OpenFile(filename));
+    auto contents = [&]() {
+        std::vector<std::string> result;
+        for (int i = 0; i < wksp->total_line_count(); ++i)
+            result.push_back(wksp->read_line(i));
+        return result;
+    };
+    auto temp_segments = [&]() {
+        int count = 0;
+        for (const auto &seg : wksp->get_contents())
+            count += (seg.file_descriptor == tempfile->fd());
+        return count;
+    };
+
+    // First match in every line: runs of changed lines are separate segments
+    SubstringSearch apple("apple");
+    long replaced = 0;
+    wksp->undo_checkpoint();
+    EXPECT_EQ(wksp->substitute(apple, "pear", false, 0, 50000, replaced), 51);
+    EXPECT_EQ(replaced, 51);
+    EXPECT_EQ(temp_segments(), 50);
+    auto expected = lines;
+    for (int i = 0; i < 50000; ++i) {
+        if (lines[i][0] == 'o')
+            expected[i] = "one pear, two apples";
+    }
+    EXPECT_TRUE(contents() == expected);
+
+    // All matches in a range
+    wksp->undo_checkpoint();
+    EXPECT_EQ(wksp->substitute(apple, "fig", true, 1000, 3007, replaced), 2);
+    EXPECT_EQ(replaced, 2);
+    expected[1007] = expected[2007] = "one pear, two figs";
+    EXPECT_TRUE(contents() == expected);
+    EXPECT_EQ(wksp->substitute(apple, "fig", true, 1008, 2007, replaced), 0);
+
+    // Every change is undone at once
+    wksp->undo();
+    EXPECT_EQ(wksp->read_line(1007), "one pear, two apples");
+    wksp->undo();
+    EXPECT_TRUE(contents() == lines);
+    EXPECT_EQ(temp_segments(), 0);
+
+    // Empty matches of regular expressions, as in sed
+    wksp->load_text(std::vector<std::string>{ "abc", "xxa", "", "x1x22" });
+    RegexSearch stars("x*");
+    EXPECT_EQ(wksp->substitute(stars, "-", true, 0, 4, replaced), 4);
+    EXPECT_TRUE(contents() ==
+                std::vector<std::string>({ "-a-b-c-", "-a-", "-", "-1-2-2-" }));
+
+    // Replacement is taken literally
+    RegexSearch digits("[0-9]+");
+    EXPECT_EQ(wksp->substitute(digits, "<&>", false, 0, 4, replaced), 1);
+    EXPECT_EQ(wksp->read_line(3), "-<&>-2-2-");
+    wksp->load_text(std::vector<std::string>{ "a1b22", "", "c" });
+    RegexSearch number("[0-9]+");
+    EXPECT_EQ(wksp->substitute(number, "#", true, 0, 3, replaced), 1);
+    EXPECT_EQ(wksp->read_line(0), "a#b#");
+    RegexSearch line_end("$");
+    EXPECT_EQ(wksp->substitute(line_end, ";", true, 0, 3, replaced), 3);
+    EXPECT_TRUE(contents() == std::vector<std::string>({ "a#b#;", ";", "c;" }));
+
+    // Blank lines past end of file are matched by a pattern for empty line
+    wksp->put_line(5, "tail");
+    RegexSearch empty_line("^$");
+    EXPECT_EQ(wksp->substitute(empty_line, "blank", false, 0, 10, replaced), 2);
+    EXPECT_TRUE(contents() ==
+                std::vector<std::string>({ "a#b#;", ";", "c;", "blank", "blank", "tail" }));
+
+    // Interrupted substitute changes nothing
+    std::atomic<bool> cancel{ true };
+    EXPECT_EQ(wksp->substitute(line_end, "!", true, 0, 6, replaced, &cancel), 0);
+    EXPECT_EQ(wksp->read_line(5), "tail");
+
+    std::remove(filename.c_str());
+}
+
+//
+// Test that substitute in a partly buffered temp file segment keeps the lines apart
+//
+TEST_F(WorkspaceDriver, SubstitutePartlyBufferedSegment)
+{
+    wksp->load_text(std::vector<std::string>{ "a", "b", "z" });
+    tempfile->flush();
+    wksp->put_line(0, "aaa");
+    tempfile->flush();
+    wksp->put_line(1, "needle");
+
+    RegexSearch start("^");
+    long replaced = 0;
+    EXPECT_EQ(wksp->substitute(start, "X", false, 0, 3, replaced), 3);
+    EXPECT_EQ(replaced, 3);
+    ASSERT_EQ(wksp->total_line_count(), 3);
+    EXPECT_EQ(wksp->read_line(0), "Xaaa");
+    EXPECT_EQ(wksp->read_line(1), "Xneedle");
+    EXPECT_EQ(wksp->read_line(2), "Xz");
+}
+
+TEST_F(WorkspaceDriver, FindForwardAndBackward)
+{
+    std::string filename = "FindForwardAndBackward.txt";
+    std::ofstream f(filename);
+    for (int i = 0; i < 20000; ++i) {
+        f << "Line " << i << (i % 1000 == 7 ? " needle" : "") << '\n';
+    }
+    f << "needle at end without newline";
+    f.close();
+
+    wksp->load_file(OpenFile(filename));
+    wksp->put_line(5, "needle in temp file, needle twice");
+    tempfile->flush();
+    wksp->put_line(12000, "unflushed needle");
+    auto blanks = Workspace::create_blank_lines(3);
+    wksp->insert_contents(blanks, 100);
+
+    SubstringSearch pattern("needle");
+    int line = 0, col = 0;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 5);
+    EXPECT_EQ(col, 0);
+
+    // Start position is included
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 5);
+    EXPECT_EQ(col, 0);
+    col = 1;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 5);
+    EXPECT_EQ(col, 21);
+    col = 22;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 7);
+    EXPECT_EQ(col, 7);
+
+    // Blank lines shift the rest
+    line = 8;
+    col  = 0;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(wksp->read_line(line), "Line 1007 needle");
+    EXPECT_EQ(line, 1010);
+
+    line = 11000;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 11010);
+    line = 11011;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(wksp->read_line(line), "unflushed needle");
+    EXPECT_EQ(col, 10);
+
+    // Incomplete last line
+    line = 19100;
+    ASSERT_TRUE(wksp->find_forward(pattern, line, col));
+    EXPECT_EQ(line, 20003);
+    EXPECT_EQ(col, 0);
+    col = 1;
+    EXPECT_FALSE(wksp->find_forward(pattern, line, col));
+
+    // Backward: match may start at the given column
+    line = 5;
+    col  = 21;
+    ASSERT_TRUE(wksp->find_backward(pattern, line, col));
+    EXPECT_EQ(line, 5);
+    EXPECT_EQ(col, 21);
+    col = 20;
+    ASSERT_TRUE(wksp->find_backward(pattern, line, col));
+    EXPECT_EQ(line, 5);
+    EXPECT_EQ(col, 0);
+    line = 4;
+    EXPECT_FALSE(wksp->find_backward(pattern, line, col));
+
+    line = 1009;
+    col  = 100;
+    ASSERT_TRUE(wksp->find_backward(pattern, line, col));
+    EXPECT_EQ(line, 7);
+    line = 50000;
+    ASSERT_TRUE(wksp->find_backward(pattern, line, col));
+    EXPECT_EQ(line, 20003);
+    EXPECT_EQ(col, 0);
+
+    SubstringSearch missing("nowhere");
+    line = 0;
+    EXPECT_FALSE(wksp->find_forward(missing, line, col));
+
+    // Regular expression, with and without fixed prefix
+    RegexSearch numbered("^Line 1[0-9]*7 needle$");
+    line = 0;
+    col  = 0;
+    ASSERT_TRUE(wksp->find_forward(numbered, line, col));
+    EXPECT_EQ(wksp->read_line(line), "Line 1007 needle");
+    RegexSearch unflushed("[a-z]+ed needle");
+    ASSERT_TRUE(wksp->find_forward(unflushed, line, col));
+    EXPECT_EQ(wksp->read_line(line), "unflushed needle");
+    EXPECT_EQ(col, 0);
+    line = 20003;
+    col  = 0;
+    ASSERT_TRUE(wksp->find_backward(unflushed, line, col));
+    EXPECT_EQ(wksp->read_line(line), "unflushed needle");
+    RegexSearch tail("(in|at) [a-z]+ (file|without)");
+    line = 7;
+    ASSERT_TRUE(wksp->find_backward(tail, line, col));
+    EXPECT_EQ(line, 5);
+    EXPECT_EQ(col, 7);
+    line = 8;
+    ASSERT_TRUE(wksp->find_forward(tail, line, col));
+    EXPECT_EQ(line, 20003);
+    EXPECT_EQ(col, 7);
+
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,281 @@
+#include "text_search.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+namespace {
+
+#ifdef HAVE_X86_SIMD
+//
+// Filter candidates by the first and the last byte of needle, 16 at a time.
+// Needle has at least two bytes. Sets scanned to the number of positions
+// at the start of data which were checked without a match.
+//
+__attribute__((target("sse2"))) long find_sse2(const char *data, size_t len, const char *needle,
+                                               size_t m, size_t &scanned)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[m - 1]);
+    size_t i            = 0;
+
+    for (; i + m - 1 + 16 <= len; i += 16) {
+        __m128i a     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i b     = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                        _mm_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(data + pos + 1, needle + 1, m - 2) == 0)
+                return pos;
+        }
+    }
+    scanned = i;
+    return -1;
+}
+
+//
+// Same backwards: sets scanned to the number of positions at the end.
+//
+__attribute__((target("sse2"))) long rfind_sse2(const char *data, size_t len, const char *needle,
+                                                size_t m, size_t &scanned)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[m - 1]);
+    size_t i            = len - m + 1; // positions left to check
+
+    for (; i >= 16; i -= 16) {
+        const char *ptr = data + i - 16;
+        __m128i a       = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+        __m128i b       = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + m - 1));
+        unsigned mask   = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first),
+                                                          _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            unsigned bit = 31 - __builtin_clz(mask);
+            if (memcmp(ptr + bit + 1, needle + 1, m - 2) == 0)
+                return ptr + bit - data;
+            mask &= ~(1u << bit);
+        }
+    }
+    scanned = len - m + 1 - i;
+    return -1;
+}
+
+__attribute__((target("avx2"))) long find_avx2(const char *data, size_t len, const char *needle,
+                                               size_t m, size_t &scanned)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[m - 1]);
+    size_t i            = 0;
+
+    for (; i + m - 1 + 32 <= len; i += 32) {
+        __m256i a     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i b     = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + m - 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                              _mm256_cmpeq_epi8(b, last)));
+        for (; mask; mask &= mask - 1) {
+            size_t pos = i + __builtin_ctz(mask);
+            if (memcmp(data + pos + 1, needle + 1, m - 2) == 0)
+                return pos;
+        }
+    }
+    scanned = i;
+    return -1;
+}
+
+__attribute__((target("avx2"))) long rfind_avx2(const char *data, size_t len, const char *needle,
+                                                size_t m, size_t &scanned)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[m - 1]);
+    size_t i            = len - m + 1; // positions left to check
+
+    for (; i >= 32; i -= 32) {
+        const char *ptr = data + i - 32;
+        __m256i a       = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+        __m256i b       = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + m - 1));
+        unsigned mask   = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            unsigned bit = 31 - __builtin_clz(mask);
+            if (memcmp(ptr + bit + 1, needle + 1, m - 2) == 0)
+                return ptr + bit - data;
+            mask &= ~(1u << bit);
+        }
+    }
+    scanned = len - m + 1 - i;
+    return -1;
+}
+#endif // HAVE_X86_SIMD
+
+} // namespace
+
+//
+// Build shift tables.
+// Forward: distance from the last occurrence of byte in needle[0..m-1) to the end.
+// Backward: distance from the start to the first occurrence of byte in needle[1..m).
+//
+SubstringSearch::SubstringSearch(std::string_view needle, Method method)
+    : needle_(needle), method_(method)
+{
+#ifdef HAVE_X86_SIMD
+    if ((method == SSE2 && !__builtin_cpu_supports("sse2")) ||
+        (method == AVX2 && !__builtin_cpu_supports("avx2"))) {
+        method_ = BMH;
+    }
+#else
+    method_ = BMH;
+#endif
+
+    const size_t m = needle_.size();
+    for (size_t c = 0; c < 256; ++c) {
+        shift_[c]  = m;
+        rshift_[c] = m;
+    }
+    for (size_t i = 0; i + 1 < m; ++i) {
+        shift_[(unsigned char)needle_[i]] = m - 1 - i;
+    }
+    for (size_t i = m - 1; m > 0 && i > 0; --i) {
+        rshift_[(unsigned char)needle_[i]] = i;
+    }
+}
+
+//
+// Fastest method supported by this processor.
+//
+SubstringSearch::Method SubstringSearch::best_method()
+{
+#ifdef HAVE_X86_SIMD
+    static const Method best = __builtin_cpu_supports("avx2")   ? AVX2
+                               : __builtin_cpu_supports("sse2") ? SSE2
+                                                                : BMH;
+    return best;
+#else
+    return BMH;
+#endif
+}
+
+//
+// Find the first match.
+//
+long SubstringSearch::find(const char *data, size_t len) const
+{
+    const size_t m = needle_.size();
+    if (m == 0 || len < m)
+        return m == 0 ? 0 : -1;
+
+    if (m == 1) {
+        const void *p = memchr(data, needle_[0], len);
+        return p ? (const char *)p - data : -1;
+    }
+
+    // Bulk of data by SIMD, the tail by BMH
+    size_t scanned = 0;
+#ifdef HAVE_X86_SIMD
+    long pos = -1;
+    if (method_ == AVX2) {
+        pos = find_avx2(data, len, needle_.data(), m, scanned);
+    } else if (method_ == SSE2) {
+        pos = find_sse2(data, len, needle_.data(), m, scanned);
+    }
+    if (pos >= 0)
+        return pos;
+#endif
+    long tail = find_bmh(data + scanned, len - scanned);
+    return tail < 0 ? -1 : tail + (long)scanned;
+}
+
+//
+// Find the last match.
+//
+long SubstringSearch::rfind(const char *data, size_t len) const
+{
+    const size_t m = needle_.size();
+    if (m == 0 || len < m)
+        return m == 0 ? (long)len : -1;
+
+    if (m == 1) {
+        const void *p = memrchr(data, needle_[0], len);
+        return p ? (const char *)p - data : -1;
+    }
+
+    // Bulk of data by SIMD from the end, the head by BMH
+    size_t scanned = 0;
+#ifdef HAVE_X86_SIMD
+    long pos = -1;
+    if (method_ == AVX2) {
+        pos = rfind_avx2(data, len, needle_.data(), m, scanned);
+    } else if (method_ == SSE2) {
+        pos = rfind_sse2(data, len, needle_.data(), m, scanned);
+    }
+    if (pos >= 0)
+        return pos;
+#endif
+    return rfind_bmh(data, len - scanned);
+}
+
+//
+// Find the first match at or after the given offset.
+//
+long SubstringSearch::find_from(const char *data, size_t len, size_t from) const
+{
+    if (from > len)
+        return -1;
+    long pos = find(data + from, len - from);
+    return pos < 0 ? -1 : pos + (long)from;
+}
+
+//
+// Find the last match which starts at or before the given offset.
+//
+long SubstringSearch::rfind_upto(const char *data, size_t len, size_t upto) const
+{
+    if (upto < len) {
+        // Match may extend past the offset
+        len = std::min(len, upto + needle_.size());
+    }
+    return rfind(data, len);
+}
+
+//
+// Horspool: compare the window from its end, then shift by its last byte.
+//
+long SubstringSearch::find_bmh(const char *data, size_t len) const
+{
+    const size_t m           = needle_.size();
+    const char *pat          = needle_.data();
+    const unsigned char tail = pat[m - 1];
+
+    for (size_t pos = 0; pos + m <= len;) {
+        unsigned char last = data[pos + m - 1];
+        if (last == tail && memcmp(data + pos, pat, m - 1) == 0)
+            return pos;
+        pos += shift_[last];
+    }
+    return -1;
+}
+
+//
+// Horspool backwards: compare the window from its start, then shift by its first byte.
+//
+long SubstringSearch::rfind_bmh(const char *data, size_t len) const
+{
+    const size_t m           = needle_.size();
+    const char *pat          = needle_.data();
+    const unsigned char head = pat[0];
+    if (len < m)
+        return -1;
+
+    for (size_t pos = len - m;;) {
+        unsigned char first = data[pos];
+        if (first == head && memcmp(data + pos + 1, pat + 1, m - 1) == 0)
+            return pos;
+        if (pos < rshift_[first])
+            return -1;
+        pos -= rshift_[first];
+    }
+}
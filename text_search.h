@@ -0,0 +1,95 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+//
+// SearchPattern class - what Workspace looks for in raw bytes of segments.
+// Blocks consist of whole lines, with newlines. A match never crosses
+// a newline, so every block is searched alone, possibly by several threads,
+// each with its own copy of the pattern.
+//
+class SearchPattern {
+public:
+    virtual ~SearchPattern() = default;
+
+    // Offset of the first match in data[0..len) which starts at or after offset from,
+    // or -1 when none.
+    virtual long find_from(const char *data, size_t len, size_t from) const = 0;
+
+    // Offset of the last match in data[0..len) which starts at or before offset upto,
+    // or -1 when none.
+    virtual long rfind_upto(const char *data, size_t len, size_t upto) const = 0;
+
+    // Offset past the end of the match which starts at offset pos,
+    // as found by find_from() or rfind_upto().
+    virtual long match_end(const char *data, size_t len, size_t pos) const = 0;
+
+    // Copy of the pattern, for use by another thread.
+    virtual std::unique_ptr<SearchPattern> clone() const = 0;
+};
+
+//
+// SubstringSearch class - finds a fixed string in blocks of raw bytes.
+//
+// On x86 processors, candidates are filtered with SIMD compares of the first
+// and the last byte of needle, 16 or 32 positions per step, and only those
+// are compared in full. Elsewhere, and for short tails of the block,
+// Boyer-Moore-Horspool algorithm is used: the window is compared from its end
+// and shifted by a distance taken from a table, indexed by the last byte of
+// the window. Backward search mirrors it, with a table indexed by the first byte.
+//
+// Search over a file is done by Workspace, segment by segment, on raw bytes
+// with newlines. A needle without newlines never matches across lines.
+//
+class SubstringSearch : public SearchPattern {
+public:
+    enum Method {
+        BMH,  // Boyer-Moore-Horspool
+        SSE2, // 16 positions per step
+        AVX2, // 32 positions per step
+    };
+
+    // Use the fastest method supported by this processor.
+    explicit SubstringSearch(std::string_view needle) : SubstringSearch(needle, best_method()) {}
+
+    // Use given method. Unsupported method falls back to BMH.
+    SubstringSearch(std::string_view needle, Method method);
+
+    // Offset of the first match in data[0..len), or -1 when none.
+    long find(const char *data, size_t len) const;
+
+    // Offset of the last match in data[0..len), or -1 when none.
+    long rfind(const char *data, size_t len) const;
+
+    long find_from(const char *data, size_t len, size_t from) const override;
+    long rfind_upto(const char *data, size_t len, size_t upto) const override;
+    long match_end(const char *, size_t, size_t pos) const override { return pos + size(); }
+    std::unique_ptr<SearchPattern> clone() const override
+    {
+        return std::make_unique<SubstringSearch>(*this);
+    }
+
+    // The string to find.
+    const std::string &needle() const { return needle_; }
+    size_t size() const { return needle_.size(); }
+
+    Method method() const { return method_; }
+
+    // Fastest method supported by this processor.
+    static Method best_method();
+
+private:
+    long find_bmh(const char *data, size_t len) const;
+    long rfind_bmh(const char *data, size_t len) const;
+
+    std::string needle_;
+    Method method_;
+    size_t shift_[256];  // forward shift by last byte of window
+    size_t rshift_[256]; // backward shift by first byte of window
+};
+
+#endif // TEXT_SEARCH_H
@@ -1,12 +1,17 @@
 #include "workspace.h"
 
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 
+#include "file_indexer.h"
+#include "io_backend.h"
 #include "tempfile.h"
+#include "text_search.h"
 
 Workspace::Workspace(Tempfile &tempfile) : tempfile_(tempfile)
 {
@@ -21,10 +26,18 @@ Workspace::~Workspace()
 
 void Workspace::cleanup_contents()
 {
+    // Save in progress reads the original file
+    wait_save();
+    stop_indexing();
+    match_index_.clear();
+    clear_undo();
     contents_.clear();
     cursegm_ = contents_.end();
+    mark_damaged(0);
+    generation_++;
 
     // Close original file.
+    filemap_.unmap();
     if (original_fd_ > 0) {
         close(original_fd_);
         original_fd_ = -1;
@@ -49,18 +62,12 @@ void Workspace::reset()
 
 //
 // Compute line count.
-//
-// TODO: This function can be optimized by caching the computed value,
-// TODO: and invalidating the cached value when contents change.
+// Every node of the segment tree caches the number of lines in its subtree,
+// so the total is available at the root.
 //
 int Workspace::total_line_count() const
 {
-    int total_lines = 0;
-
-    for (auto seg : contents_) {
-        total_lines += seg.line_count;
-    }
-    return total_lines;
+    return contents_.total_lines();
 }
 
 //
@@ -110,17 +117,48 @@ void Workspace::load_text(const std::string &text)
 
 //
 // Compute the line number of the first line in the current segment.
-//
-// TODO: This function can be optimized by caching the computed value,
-// TODO: and invalidating the cached value when contents change.
+// Walks up the segment tree, summing line counts of left siblings.
 //
 int Workspace::current_segment_base_line() const
 {
-    int segmline = 0;
-    for (auto it = contents_.begin(); it != cursegm_; ++it) {
-        segmline += it->line_count;
-    }
-    return segmline;
+    return contents_.base_line(cursegm_);
+}
+
+//
+// Compute byte offset of the first character of the given line.
+// Descends the segment tree by line count, then walks line lengths
+// inside the found segment.
+//
+long Workspace::line_to_offset(int line_no) const
+{
+    if (line_no <= 0)
+        return 0;
+
+    long base_line = 0;
+    auto seg       = contents_.find_line(line_no, base_line);
+    if (seg == contents_.end())
+        return contents_.total_bytes();
+
+    return contents_.base_offset(seg) + seg->line_lengths.offset_of(line_no - base_line);
+}
+
+//
+// Find the line containing the given byte offset.
+// Descends the segment tree by byte count, then walks line lengths
+// inside the found segment.
+//
+int Workspace::offset_to_line(long offset) const
+{
+    if (offset <= 0)
+        return 0;
+
+    long base_line   = 0;
+    long base_offset = 0;
+    auto seg         = contents_.find_offset(offset, base_line, base_offset);
+    if (seg == contents_.end())
+        return contents_.total_lines();
+
+    return base_line + seg->line_lengths.line_at(offset - base_offset);
 }
 
 //
@@ -131,15 +169,15 @@ int Workspace::current_segment_base_line() const
 //   - cursegm_: points to the segment containing the line
 //   - line_: the absolute line number requested
 //
-// The method walks the segment chain forward or backward to find the segment
-// containing the requested line.
+// The method descends the segment tree, using cached line counts of subtrees
+// to find the segment containing the requested line in O(log n) steps.
 //
 // Returns:
 //   0 - success, cursegm_ updated to the correct segment
-//   1 - line number is beyond end of file
+//   1 - line number is beyond end of file, cursegm_ set to the last segment
 //
 // Throws:
-//   std::runtime_error for invalid line numbers or corrupted segment chains
+//   std::runtime_error for invalid line numbers
 //
 int Workspace::change_current_line(int lno)
 {
@@ -147,38 +185,24 @@ int Workspace::change_current_line(int lno)
     if (lno < 0)
         throw std::runtime_error("change_current_line: negative line number");
 
+    wait_index(lno);
+
     if (contents_.empty()) {
         position.line = lno;
         return 1; // empty file
     }
 
-    if (cursegm_ == contents_.end())
-        cursegm_ = contents_.begin();
-
-    int segmline = current_segment_base_line();
-
-    // Move forward to find the segment containing lno
-    while (lno >= segmline + cursegm_->line_count) {
-        segmline += cursegm_->line_count;
-
-        // Check if there's a next segment before moving
-        auto next_it = std::next(cursegm_);
-        if (next_it == contents_.end()) {
-            position.line = lno;
-            return 1;
-        }
-        ++cursegm_;
-    }
-
-    // Move backward to find the segment containing lno
-    while (lno < segmline) {
-        if (cursegm_ == contents_.begin())
-            throw std::runtime_error("change_current_line: null previous segment");
-        --cursegm_;
-        segmline -= cursegm_->line_count;
+    long segmline;
+    auto it = contents_.find_line(lno, segmline);
+    if (it == contents_.end()) {
+        // Beyond end of file: stay at the last segment
+        cursegm_      = std::prev(contents_.end());
+        position.line = lno;
+        return 1;
     }
 
     // Update workspace state
+    cursegm_      = it;
     position.line = lno;
     return 0;
 }
@@ -198,98 +222,134 @@ void Workspace::load_file(int fd)
     // Clear any existing segments list
     contents_.clear();
 
-    char read_buf[8192];
-    int buf_count    = 0;
-    int buf_next     = 0;
-    long file_offset = 0;
-
-    // Temporary segment to build data
-    Segment temp_seg;
-    int lines_in_seg = 0;
-    long seg_seek    = 0;
-
-    for (;;) {
-        // Read buffer if needed
-        if (buf_next >= buf_count) {
-            buf_next  = 0;
-            buf_count = read(fd, read_buf, sizeof(read_buf));
-            if (buf_count <= 0) {
-                // EOF
-                if (lines_in_seg > 0) {
-                    // Create final segment in list
-                    contents_.emplace_back(fd, lines_in_seg, seg_seek,
-                                           std::move(temp_seg.line_lengths));
-                }
-                break;
-            }
-        }
-
-        // Process line - handle lines that span buffer boundaries
-        int line_len = parse_line_from_buffer(read_buf, buf_count, buf_next, fd);
+    FileIndexer indexer(fd);
+    indexer.set_threads(index_threads_);
 
-        // Store line length in segment data
-        if (lines_in_seg == 0) {
-            seg_seek = file_offset;
-        }
+    std::list<Segment> segments;
+    indexer.index(segments);
+    contents_.splice(contents_.end(), segments);
 
-        temp_seg.line_lengths.push_back(line_len);
+    // Position to start of contents
+    cursegm_      = contents_.empty() ? contents_.end() : contents_.begin();
+    position.line = 0;
 
-        ++lines_in_seg;
-        file_offset += line_len;
+    // Serve unmodified lines from memory; special files fall back to pread()
+    filemap_.map(fd);
+}
 
-        // Create new segment if we've hit limits
-        if (lines_in_seg >= 127 || temp_seg.line_lengths.size() >= 4000) {
-            contents_.emplace_back(fd, lines_in_seg, seg_seek, std::move(temp_seg.line_lengths));
+//
+// Build segment chain from file descriptor, indexing the rest of file in background.
+// First megabyte is indexed at once: enough to show the first screen.
+// Special files and small files are loaded completely.
+//
+void Workspace::load_file_in_background(int fd)
+{
+    const long head_size = 1024 * 1024;
 
-            lines_in_seg = 0;
-        }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= head_size) {
+        load_file(fd);
+        return;
     }
 
+    // Clean up old chain
+    cleanup_contents();
+    original_fd_ = fd;
+
+    // Index the beginning of file
+    FileIndexer indexer(fd);
+    std::list<Segment> segments;
+    indexer.index_range(0, head_size, segments);
+    contents_.splice(contents_.end(), segments);
+
+    // Index the rest on background thread
+    indexing_     = true;
+    index_done_   = false;
+    index_thread_ = std::thread([this, fd, file_size = (long)st.st_size]() {
+        FileIndexer background(fd);
+        background.set_threads(index_threads_);
+        background.index_stripes(
+            head_size, file_size,
+            [this](std::list<Segment> &part) {
+                std::lock_guard<std::mutex> lock(index_mutex_);
+                index_pending_.splice(index_pending_.end(), part);
+                index_cv_.notify_all();
+            },
+            &index_cancel_);
+
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        index_done_ = true;
+        index_cv_.notify_all();
+    });
+
     // Position to start of contents
     cursegm_      = contents_.empty() ? contents_.end() : contents_.begin();
     position.line = 0;
+
+    // Serve unmodified lines from memory; special files fall back to pread()
+    filemap_.map(fd);
 }
 
 //
-// Helper for load_file: parse a single line from buffered input.
-// Returns line length including newline, or 0 on EOF.
+// Append segments indexed in background so far.
+// Segment tree is modified only here, on the main thread.
 //
-int Workspace::parse_line_from_buffer(char *read_buf, int &buf_count, int &buf_next, int fd)
+bool Workspace::poll_index()
 {
-    int line_len       = 0;
-    bool line_complete = false;
+    if (!indexing_)
+        return false;
 
-    while (!line_complete) {
-        char *line_start = read_buf + buf_next;
-        char *line_end   = line_start;
+    std::list<Segment> segments;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(index_mutex_);
+        segments.splice(segments.end(), index_pending_);
+        done = index_done_;
+    }
 
-        // Find line end
-        while (buf_next < buf_count && *line_end != '\n') {
-            ++line_end, ++buf_next;
-        }
+    bool added = !segments.empty();
+    if (added) {
+        mark_damaged(total_line_count());
+        contents_.splice(contents_.end(), segments);
+    }
+    if (done) {
+        index_thread_.join();
+        indexing_ = false;
 
-        line_len += (line_end - line_start);
+        // Rows waiting for lines past the end are shown empty now
+        mark_damaged(total_line_count());
+    }
+    return added;
+}
 
-        if (buf_next < buf_count) {
-            // Found newline in current buffer
-            line_len += 1; // include newline
-            ++buf_next;    // skip '\n'
-            line_complete = true;
-        } else {
-            // No newline found - line continues in next buffer
-            // More data to read - reload buffer
-            buf_next  = 0;
-            buf_count = read(fd, read_buf, 8192);
-            if (buf_count <= 0) {
-                // EOF - treat incomplete line as complete
-                line_len += 1; // add trailing newline
-                line_complete = true;
-            }
-            // If buffer was successfully read, continue loop to process next buffer
+//
+// Wait until the given line is indexed, or the whole file is.
+//
+void Workspace::wait_index(long line_no)
+{
+    while (indexing_ && line_no >= contents_.total_lines()) {
+        {
+            std::unique_lock<std::mutex> lock(index_mutex_);
+            index_cv_.wait(lock, [this] { return !index_pending_.empty() || index_done_; });
         }
+        poll_index();
     }
+}
+
+//
+// Stop background indexing and discard its results.
+//
+void Workspace::stop_indexing()
+{
+    if (!indexing_)
+        return;
 
-    return line_len;
+    index_cancel_ = true;
+    index_thread_.join();
+    index_pending_.clear();
+    index_cancel_ = false;
+    index_done_   = false;
+    indexing_     = false;
 }
 
 //
@@ -301,7 +361,7 @@ std::list<Segment> Workspace::create_blank_lines(int n)
     std::list<Segment> segments;
 
     while (n > 0) {
-        int lines_in_seg = (n > 127) ? 127 : n;
+        int lines_in_seg = std::min(n, (int)Segment::MAX_LINES);
 
         segments.push_back(Segment(-1, lines_in_seg));
         n -= lines_in_seg;
@@ -314,21 +374,129 @@ std::list<Segment> Workspace::create_blank_lines(int n)
 //
 std::string Workspace::read_line(int line_no)
 {
+    return std::string(read_line_view(line_no));
+}
+
+//
+// Borrow line content from segment chain at specified index.
+// No heap allocation, unless the cache entry has to grow.
+// Lines which have to be read from file are cached; lines in memory
+// mapping and in unwritten tail of temp file are served directly.
+//
+std::string_view Workspace::read_line_view(int line_no)
+{
+    auto found = cached_index_.find(line_no);
+    if (found != cached_index_.end()) {
+        // Move to front
+        cache_hits_++;
+        cached_lines_.splice(cached_lines_.begin(), cached_lines_, found->second);
+        return found->second->text;
+    }
+
     // Position to the correct segment for this line
     if (change_current_line(line_no) != 0) {
-        return ""; // Line beyond end of file
+        return {}; // Line beyond end of file
     }
 
     // Validate segment is accessible
     if (cursegm_ == contents_.end()) {
-        return "";
+        return {};
     }
 
     // Calculate relative line position within the current segment
     int rel_line = line_no - current_segment_base_line();
 
+    // Take line bytes directly from memory when possible
+    const Segment &seg = *cursegm_;
+    if (seg.file_descriptor >= 0 && rel_line < (int)seg.line_lengths.size()) {
+        size_t len       = seg.line_lengths[rel_line] - 1;
+        long offset      = seg.calculate_line_offset(rel_line);
+        const char *data = nullptr;
+        if (filemap_.covers(seg.file_descriptor)) {
+            // Mapping of original file
+            data = filemap_.bytes(offset, len);
+        } else if (seg.file_descriptor == tempfile_.fd()) {
+            // Tail of temp file, not yet written
+            data = tempfile_.unflushed_bytes(offset, len);
+        }
+        if (data) {
+            return std::string_view(data, len);
+        }
+    }
+    if (seg.file_descriptor < 0 || rel_line >= (int)seg.line_lengths.size() ||
+        seg.line_lengths[rel_line] <= 1) {
+        // Blank or empty line
+        return {};
+    }
+
     // Delegate to segment to read the line content
-    return cursegm_->read_line_content(rel_line);
+    cache_misses_++;
+    return cache_line(line_no, seg.read_line_view(rel_line, line_buf_));
+}
+
+//
+// Add line to cache. When full, the least recently used entry
+// is taken over, so that its string capacity is reused.
+//
+std::string_view Workspace::cache_line(long line_no, std::string_view text)
+{
+    if (cache_capacity_ == 0)
+        return text;
+
+    if (cached_lines_.size() < cache_capacity_) {
+        cached_lines_.push_front({ line_no, std::string() });
+        cached_index_.emplace(line_no, cached_lines_.begin());
+    } else {
+        // Nodes of both the list and the index are reused, without allocation
+        cache_evictions_++;
+        cached_lines_.splice(cached_lines_.begin(), cached_lines_, std::prev(cached_lines_.end()));
+        auto node  = cached_index_.extract(cached_lines_.front().line_no);
+        node.key() = line_no;
+        cached_index_.insert(std::move(node));
+        cached_lines_.front().line_no = line_no;
+    }
+    CachedLine &entry = cached_lines_.front();
+    entry.text.assign(text.data(), text.size());
+    return entry.text;
+}
+
+//
+// Statistics of line cache.
+//
+Workspace::LineCacheStats Workspace::line_cache_stats() const
+{
+    return { cache_hits_, cache_misses_, cache_evictions_, cached_lines_.size(), cache_capacity_ };
+}
+
+//
+// Set maximum number of lines in cache, dropping the least recently used.
+//
+void Workspace::set_line_cache_capacity(size_t lines)
+{
+    cache_capacity_ = lines;
+    while (cached_lines_.size() > cache_capacity_) {
+        cached_index_.erase(cached_lines_.back().line_no);
+        cached_lines_.pop_back();
+    }
+}
+
+//
+// Find location of line bytes in file.
+//
+bool Workspace::locate_line(int line_no, int &fd, long &offset)
+{
+    if (change_current_line(line_no) != 0 || cursegm_ == contents_.end()) {
+        return false;
+    }
+
+    int rel_line       = line_no - current_segment_base_line();
+    const Segment &seg = *cursegm_;
+    if (seg.file_descriptor < 0 || rel_line >= (int)seg.line_lengths.size()) {
+        return false;
+    }
+    fd     = seg.file_descriptor;
+    offset = seg.calculate_line_offset(rel_line);
+    return true;
 }
 
 //
@@ -336,47 +504,145 @@ std::string Workspace::read_line(int line_no)
 //
 bool Workspace::write_file(const std::string &path)
 {
-    if (contents_.empty()) {
-        // No segment chain - write empty file
-        int out_fd = creat(path.c_str(), 0664);
-        if (out_fd >= 0) {
-            close(out_fd);
-        }
-        return out_fd >= 0;
+    // Segments are copied by descriptor: buffered temp data must reach the file
+    tempfile_.flush();
+    finish_indexing();
+
+    std::atomic<long> progress{ 0 };
+    return write_ranges(path, save_ranges(), progress);
+}
+
+//
+// Start writing segment chain content to file on a background thread.
+//
+void Workspace::start_save(const std::string &path)
+{
+    wait_save();
+    tempfile_.flush();
+    finish_indexing();
+
+    std::vector<SaveRange> ranges = save_ranges();
+    save_size_                    = 0;
+    for (const auto &range : ranges) {
+        save_size_ += range.length;
     }
+    save_path_ = path;
+    save_written_.store(0);
+    save_finished_.store(false);
+    saving_ = true;
+
+    save_thread_ = std::thread([this, ranges = std::move(ranges)]() {
+        save_result_ = write_ranges(save_path_, ranges, save_written_);
+        save_finished_.store(true);
+    });
+}
 
-    int out_fd = creat(path.c_str(), 0664);
-    if (out_fd < 0)
+//
+// Finish background save when its thread is done.
+//
+bool Workspace::poll_save(bool &ok)
+{
+    if (!saving_ || !save_finished_.load()) {
         return false;
+    }
+    ok = wait_save();
+    return true;
+}
+
+//
+// Wait for background save to finish.
+//
+bool Workspace::wait_save()
+{
+    if (!saving_) {
+        return true;
+    }
+    save_thread_.join();
+    saving_ = false;
+    return save_result_;
+}
+
+//
+// Capture segment chain as ranges of bytes to save.
+// Adjacent segments of the same file are joined into one range.
+// Blank lines are kept only when followed by text: trailing blank lines
+// are skipped, unless there is no text at all.
+//
+std::vector<Workspace::SaveRange> Workspace::save_ranges() const
+{
+    std::vector<SaveRange> ranges;
+    long blank_bytes = 0; // pending blank lines
+    bool have_text   = false;
 
-    // Find the last non-blank segment (to skip trailing blank lines)
-    auto last_nonblank = contents_.end();
-    for (auto it = contents_.begin(); it != contents_.end(); ++it) {
-        if (it->file_descriptor != -1) {
-            last_nonblank = it;
+    for (const auto &seg : contents_) {
+        long nbytes = seg.total_byte_count();
+        if (seg.file_descriptor == -1) {
+            blank_bytes += nbytes;
+            continue;
+        }
+        if (blank_bytes > 0) {
+            ranges.push_back({ -1, 0, blank_bytes });
+            blank_bytes = 0;
+        }
+        SaveRange *last = ranges.empty() ? nullptr : &ranges.back();
+        if (last && last->fd == seg.file_descriptor &&
+            last->offset + last->length == seg.file_offset) {
+            last->length += nbytes;
+        } else {
+            ranges.push_back({ seg.file_descriptor, seg.file_offset, nbytes });
         }
+        have_text = true;
+    }
+    if (!have_text && blank_bytes > 0) {
+        ranges.push_back({ -1, 0, blank_bytes });
     }
+    return ranges;
+}
 
-    for (auto it = contents_.begin(); it != contents_.end(); ++it) {
-        const auto &seg = *it;
+//
+// Write ranges to file. Large ranges are copied in pieces, to report progress.
+// Stops at the first failed write or copy, and returns false then.
+//
+bool Workspace::write_ranges(const std::string &path, const std::vector<SaveRange> &ranges,
+                             std::atomic<long> &progress)
+{
+    const long PIECE_SIZE = 16 * 1024 * 1024;
+    static const std::string newlines(64 * 1024, '\n');
 
-        // Skip trailing blank lines (blank segments after the last content segment)
-        // Note: Only skip blanks that come AFTER the last non-blank in iterator order
-        if (seg.file_descriptor == -1 && last_nonblank != contents_.end()) {
-            // Check if this blank segment comes after the last non-blank segment
-            // Compare indices directly: if it > last_nonblank, then it comes after
-            if (it != last_nonblank && std::distance(contents_.begin(), it) >
-                                           std::distance(contents_.begin(), last_nonblank)) {
-                continue;
+    int out_fd = creat(path.c_str(), 0664);
+    if (out_fd < 0)
+        return false;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < ranges.size(); ++i) {
+        const SaveRange &range = ranges[i];
+
+        // Bytes past the end of file, like newline of incomplete last line, are blank
+        long avail = (range.fd == -1) ? 0 : range.length;
+        struct stat st;
+        if (range.fd != -1 && fstat(range.fd, &st) == 0)
+            avail = std::max(0L, std::min<long>(range.length, st.st_size - range.offset));
+
+        for (long done = 0; ok && done < range.length;) {
+            long piece;
+            if (done >= avail) {
+                // Missing newline at the end of file is not added
+                piece = std::min<long>(range.length - done, newlines.size());
+                if (range.fd == -1 || i + 1 < ranges.size())
+                    ok = IoBackend::write_all(out_fd, newlines.data(), piece);
+            } else {
+                piece = std::min(avail - done, PIECE_SIZE);
+                ok    = IoBackend::get().copy(range.fd, range.offset + done, piece, out_fd);
             }
+            done += piece;
+            progress += piece;
         }
-
-        // Delegate to segment to write its content
-        seg.write_content(out_fd);
     }
 
-    close(out_fd);
-    return true;
+    // Delayed write errors are reported by close()
+    if (close(out_fd) < 0)
+        ok = false;
+    return ok;
 }
 
 //
@@ -387,6 +653,8 @@ bool Workspace::write_file(const std::string &path)
 //
 int Workspace::split(int line_no)
 {
+    wait_index(line_no);
+
     // Handle empty workspace case
     if (contents_.empty()) {
         return split_empty_workspace(line_no);
@@ -420,7 +688,9 @@ int Workspace::split_empty_workspace(int line_no)
     // Create blank lines up to, but not including, line_no
     // (so total_line_count() becomes line_no)
     if (line_no > 0) {
-        contents_ = create_blank_lines(line_no);
+        mark_damaged(0);
+        auto blank_segments = create_blank_lines(line_no);
+        contents_.splice(contents_.end(), blank_segments);
     }
     // Position logically at requested line (may be just past end)
     cursegm_      = contents_.end();
@@ -442,13 +712,10 @@ int Workspace::split_beyond_end(int line_no)
         return 1; // Already at the right position
     }
 
-    // Get iterator to first blank segment before splicing (since splice will move them)
-    auto blank_segments  = create_blank_lines(num_blank_lines);
-    auto first_blank_seg = blank_segments.begin();
-
-    // Insert blank lines at the end of file
-    contents_.splice(contents_.end(), blank_segments);
-    cursegm_ = first_blank_seg;
+    // Insert blank lines at the end of file, and position at the first of them
+    mark_damaged(current_total);
+    auto blank_segments = create_blank_lines(num_blank_lines);
+    cursegm_            = contents_.splice(contents_.end(), blank_segments);
 
     // Position workspace logically at requested line (may be just past end)
     position.line = line_no;
@@ -467,18 +734,20 @@ void Workspace::split_segment(int rel_line)
     // Find where to insert the new segment (after current segment)
     auto insert_pos = std::next(cursegm_);
 
-    // Walk through the first rel_line lines to calculate offset
+    // Offset of the first line of the new segment
     long offs = 0;
     if (cursegm_->file_descriptor > 0) {
-        for (int i = 0; i < rel_line; ++i) {
-            offs += cursegm_->line_lengths[i];
-        }
+        offs = cursegm_->line_lengths.offset_of(rel_line);
     }
 
-    // Build line_lengths vector for new segment
-    std::vector<unsigned short> new_lengths;
-    for (size_t i = rel_line; i < cursegm_->line_count; ++i) {
-        new_lengths.push_back(cursegm_->line_lengths[i]);
+    // Build line lengths for new segment
+    LineLengths new_lengths;
+    auto len = cursegm_->line_lengths.begin();
+    for (int i = 0; i < rel_line; ++i) {
+        ++len;
+    }
+    for (; len != cursegm_->line_lengths.end(); ++len) {
+        new_lengths.push_back(*len);
     }
 
     // Create new segment in place
@@ -489,6 +758,7 @@ void Workspace::split_segment(int rel_line)
     // Truncate original sizes - keep only first rel_line data
     cursegm_->line_lengths.resize(rel_line);
     cursegm_->line_count = rel_line;
+    contents_.update(cursegm_);
 
     // Update workspace position
     cursegm_ = new_it;
@@ -533,6 +803,7 @@ bool Workspace::merge()
 
         // Erase current segment from list
         contents_.erase(curr_it);
+        contents_.update(prev_it);
         cursegm_ = prev_it;
 
         // Re-position properly using change_current_line logic
@@ -560,6 +831,15 @@ bool Workspace::delete_last_line_fastpath()
     }
 
     if (it->line_count > 0) {
+        // Keep the line for undo
+        unsigned last = it->line_count - 1;
+        LineLengths lengths;
+        lengths.push_back(it->line_lengths[last]);
+        SegmentTree removed;
+        long offset = it->file_offset + it->line_lengths.offset_of(last);
+        removed.emplace_back(it->file_descriptor, 1, offset, std::move(lengths));
+        record_change(contents_.base_line(it) + last, 0, std::move(removed));
+
         // Remove last line metadata
         if (!it->line_lengths.empty())
             it->line_lengths.pop_back();
@@ -567,6 +847,8 @@ bool Workspace::delete_last_line_fastpath()
             it->line_count -= 1;
         if (it->line_count == 0) {
             contents_.erase(it);
+        } else {
+            contents_.update(it);
         }
         return true;
     }
@@ -640,12 +922,14 @@ void Workspace::insert_contents(std::list<Segment> &contents_to_insert, int at)
     // If workspace is empty, simply insert at the end
     if (contents_.empty()) {
         contents_.splice(contents_.end(), contents_to_insert);
+        record_change(0, total_line_count(), SegmentTree());
         cursegm_            = contents_.begin();
         file_state.writable = true;
         return;
     }
 
     // Capture current total to handle end-insert logic
+    wait_index(at);
     int total_before = total_line_count();
 
     // Split at insertion point
@@ -654,14 +938,11 @@ void Workspace::insert_contents(std::list<Segment> &contents_to_insert, int at)
     // Determine correct insertion position
     auto insert_pos = determine_insertion_point(br, at, total_before);
 
-    // Remember the position before splicing so we can find the first inserted segment
-    auto before_size = std::distance(contents_.begin(), insert_pos);
-
-    contents_.splice(insert_pos, contents_to_insert);
-
     // Update workspace position to FIRST inserted segment (not last)
-    cursegm_ = contents_.begin();
-    std::advance(cursegm_, before_size);
+    cursegm_ = contents_.splice(insert_pos, contents_to_insert);
+
+    // Blank lines may have been added before the insertion point
+    record_change(std::min(at, total_before), total_line_count() - total_before, SegmentTree());
 
     file_state.writable = true; // Mark as edited
 }
@@ -676,6 +957,8 @@ void Workspace::delete_contents(int from, int to)
     if (contents_.empty() || from > to)
         return;
 
+    // Need to know whether 'to' is the last line
+    wait_index((long)to + 1);
     auto total = total_line_count();
     if (total == 0)
         return;
@@ -702,15 +985,15 @@ void Workspace::delete_contents(int from, int to)
         return;
     }
 
-    // Erase the range from the list
+    // Move the range from the list into undo history
     if (start_it == end_it) {
         // Special-case: deleting the final region where end == start (e.g., at EOF)
         if (start_it != contents_.end()) {
             auto next_it = std::next(start_it);
-            contents_.erase(start_it, next_it);
+            record_change(from, 0, contents_.extract(start_it, next_it));
         }
     } else {
-        contents_.erase(start_it, end_it);
+        record_change(from, 0, contents_.extract(start_it, end_it));
     }
 
     // Update workspace position
@@ -786,6 +1069,7 @@ void Workspace::goto_line(int target_line, int max_rows)
 
     // Calculate where to position topline to show target_line near middle
     int half_screen = max_rows / 2;
+    wait_index((long)target_line + max_rows);
 
     // Position to show target_line around middle of screen
     scroll_vertical(target_line - view.topline - half_screen, max_rows, total_line_count());
@@ -830,6 +1114,7 @@ void Workspace::put_line(int line_no, const std::string &line_content)
     auto new_seg_it = temp_segments.begin();
 
     // Append beyond EOF (also covers empty workspace via total==0)
+    wait_index(line_no);
     int total = total_line_count();
     if (line_no >= total) {
         // Create blanks as needed
@@ -838,6 +1123,7 @@ void Workspace::put_line(int line_no, const std::string &line_content)
             contents_.splice(contents_.end(), blanks);
         }
         contents_.splice(contents_.end(), temp_segments);
+        record_change(total, line_no - total + 1, SegmentTree());
         cursegm_ = contents_.end();
         --cursegm_;
         position.line       = line_no;
@@ -847,13 +1133,736 @@ void Workspace::put_line(int line_no, const std::string &line_content)
 
     // Overwrite existing line: isolate target line into its own segment, then replace
     isolate_line(line_no);
+    SegmentTree removed;
+    removed.emplace_back(std::move(*cursegm_));
+    record_change(line_no, 1, std::move(removed));
     *cursegm_ = std::move(*new_seg_it);
+    contents_.update(cursegm_);
     merge();
 
     position.line       = line_no;
     file_state.modified = true;
 }
 
+//
+// Revert the last group of changes.
+// Each step takes O(log n), whatever the number of lines it changed.
+//
+int Workspace::undo()
+{
+    if (undo_steps_.empty())
+        return -1;
+
+    long first_line = LONG_MAX;
+    bool joined;
+    do {
+        UndoStep step = std::move(undo_steps_.back());
+        undo_steps_.pop_back();
+        swap_lines(step);
+        first_line = std::min(first_line, step.line);
+        joined     = step.joined;
+        redo_steps_.push_back(std::move(step));
+    } while (joined && !undo_steps_.empty());
+
+    undo_joined_        = false;
+    file_state.modified = true;
+    return first_line;
+}
+
+//
+// Apply again the last reverted group of changes.
+//
+int Workspace::redo()
+{
+    if (redo_steps_.empty())
+        return -1;
+
+    long first_line = LONG_MAX;
+    do {
+        UndoStep step = std::move(redo_steps_.back());
+        redo_steps_.pop_back();
+        swap_lines(step);
+        first_line = std::min(first_line, step.line);
+        undo_steps_.push_back(std::move(step));
+    } while (!redo_steps_.empty() && redo_steps_.back().joined);
+
+    undo_joined_        = false;
+    file_state.modified = true;
+    return first_line;
+}
+
+//
+// Forget all changes.
+//
+void Workspace::clear_undo()
+{
+    undo_steps_.clear();
+    redo_steps_.clear();
+    undo_joined_ = false;
+}
+
+//
+// Add change to undo history. Changes which were undone cannot be redone anymore.
+//
+void Workspace::record_change(long line, long count, SegmentTree &&removed)
+{
+    if (removed.total_lines() == count) {
+        mark_damaged(line, line + count);
+    } else {
+        mark_damaged(line);
+    }
+    redo_steps_.clear();
+    undo_steps_.push_back({ line, count, std::move(removed), undo_joined_ });
+    undo_group_size_ = undo_joined_ ? undo_group_size_ + 1 : 1;
+    undo_joined_     = true;
+
+    // Oldest groups are forgotten as a whole; the current one is kept even when
+    // it's larger than the limit, so that it can be undone completely
+    while (undo_steps_.size() > MAX_UNDO_STEPS && undo_steps_.size() > undo_group_size_) {
+        do {
+            undo_steps_.pop_front();
+        } while (undo_steps_.front().joined);
+    }
+}
+
+//
+// Exchange lines [line, line + count) of the chain with lines saved in the step.
+// Both are moved as whole subtrees; only the segments at the two ends may be split.
+//
+void Workspace::swap_lines(UndoStep &step)
+{
+    wait_index(step.line + step.count);
+
+    auto last           = segment_at(step.line + step.count);
+    auto first          = segment_at(step.line);
+    SegmentTree current = contents_.extract(first, last);
+
+    long count = step.removed.total_lines();
+    if (count == step.count) {
+        mark_damaged(step.line, step.line + count);
+    } else {
+        mark_damaged(step.line);
+    }
+    contents_.splice(segment_at(step.line), step.removed);
+    step.removed = std::move(current);
+    step.count   = count;
+
+    // Current segment might have been moved out
+    cursegm_ = contents_.end();
+    change_current_line(step.line);
+}
+
+//
+// Make a segment start at the given line, and return it.
+// Returns end() for lines past the last one.
+//
+Segment::iterator Workspace::segment_at(long line)
+{
+    if (line >= total_line_count())
+        return contents_.end();
+
+    split(line);
+    return cursegm_;
+}
+
+//
+// Find the first match at or after given position.
+// A match never crosses a line, so every segment is searched alone,
+// and the match is mapped to a line by its offset.
+//
+bool Workspace::find_forward(const SearchPattern &pattern, int &line, int &col, bool wrap,
+                             const std::atomic<bool> *cancel)
+{
+    if (line < 0 || change_current_line(line) != 0 || cursegm_ == contents_.end())
+        return false;
+
+    // Segments from the position to end of file, then from start of file
+    std::vector<SearchItem> items;
+    auto first = cursegm_;
+    long base  = current_segment_base_line();
+    if (first->file_descriptor >= 0) {
+        int rel     = line - base;
+        long offset = first->line_lengths.offset_of(rel) +
+                      std::min<long>(col, first->line_lengths[rel] - 1);
+        items.push_back({ &*first, base, offset });
+    }
+    for (auto it = std::next(first); it != contents_.end(); ++it) {
+        base += std::prev(it)->line_count;
+        if (it->file_descriptor >= 0)
+            items.push_back({ &*it, base, 0 });
+    }
+    if (wrap) {
+        // Segment of the position again: only matches before it are left
+        base = 0;
+        for (auto it = contents_.begin(); it != std::next(first); base += it->line_count, ++it) {
+            if (it->file_descriptor >= 0)
+                items.push_back({ &*it, base, 0 });
+        }
+    }
+
+    size_t index;
+    long pos;
+    if (!search_items(items, pattern, true, cancel, index, pos))
+        return false;
+
+    const Segment &seg = *items[index].seg;
+    size_t rel         = seg.line_lengths.line_at(pos);
+    line               = items[index].base + rel;
+    col                = pos - seg.line_lengths.offset_of(rel);
+    return true;
+}
+
+//
+// Find the last match at or before given position.
+//
+bool Workspace::find_backward(const SearchPattern &pattern, int &line, int &col, bool wrap,
+                              const std::atomic<bool> *cancel)
+{
+    int total = total_line_count();
+    if (line < 0 || total == 0)
+        return false;
+    if (line >= total) {
+        line = total - 1;
+        col  = INT_MAX;
+    }
+    change_current_line(line);
+
+    // Segments from the position to start of file, then from end of file
+    std::vector<SearchItem> items;
+    auto first = cursegm_;
+    long base  = current_segment_base_line();
+    if (first->file_descriptor >= 0) {
+        int rel   = line - base;
+        long len  = first->line_lengths[rel] - 1;
+        long upto = first->line_lengths.offset_of(rel) + std::min<long>(col, len);
+        items.push_back({ &*first, base, upto });
+    }
+    for (auto it = first; it != contents_.begin();) {
+        --it;
+        base -= it->line_count;
+        if (it->file_descriptor >= 0)
+            items.push_back({ &*it, base, LONG_MAX });
+    }
+    if (wrap) {
+        // Segment of the position again: only matches after it are left
+        base = total;
+        for (auto it = contents_.end(); it != first;) {
+            --it;
+            base -= it->line_count;
+            if (it->file_descriptor >= 0)
+                items.push_back({ &*it, base, LONG_MAX });
+        }
+        if (first->file_descriptor >= 0)
+            items.push_back({ &*first, current_segment_base_line(), LONG_MAX });
+    }
+
+    size_t index;
+    long pos;
+    if (!search_items(items, pattern, false, cancel, index, pos))
+        return false;
+
+    const Segment &seg = *items[index].seg;
+    size_t rel         = seg.line_lengths.line_at(pos);
+    line               = items[index].base + rel;
+    col                = pos - seg.line_lengths.offset_of(rel);
+    return true;
+}
+
+//
+// Search segments in the given order, and find the first match.
+// Items are grouped into chunks of about SEARCH_CHUNK_SIZE bytes, and workers
+// take chunks in order. A match in one chunk makes all later chunks useless,
+// so workers drop them, while earlier chunks are still searched to the end.
+// Cancel is checked before every segment.
+//
+bool Workspace::search_items(const std::vector<SearchItem> &items, const SearchPattern &pattern,
+                             bool forward, const std::atomic<bool> *cancel, size_t &found_item,
+                             long &found_pos) const
+{
+    // Chunks start at these items
+    std::vector<size_t> bounds{ 0 };
+    long chunk_bytes = 0;
+    for (size_t i = 0; i < items.size(); ++i) {
+        chunk_bytes += items[i].seg->total_byte_count();
+        if (chunk_bytes >= SEARCH_CHUNK_SIZE && i + 1 < items.size()) {
+            bounds.push_back(i + 1);
+            chunk_bytes = 0;
+        }
+    }
+    bounds.push_back(items.size());
+
+    size_t nchunks   = bounds.size() - 1;
+    unsigned threads = search_threads_ ? search_threads_ : std::thread::hardware_concurrency();
+    threads          = std::max(1u, std::min<unsigned>(threads, nchunks));
+
+    std::atomic<size_t> next_chunk{ 0 };
+    std::atomic<size_t> found_chunk{ nchunks }; // the earliest chunk with a match
+    std::mutex mutex;
+
+    auto worker = [&](const SearchPattern &pat) {
+        std::string buf;
+        for (size_t c = next_chunk++; c < nchunks && c < found_chunk; c = next_chunk++) {
+            for (size_t i = bounds[c]; i < bounds[c + 1]; ++i) {
+                if ((cancel && *cancel) || found_chunk < c)
+                    return;
+
+                std::string_view bytes = segment_bytes(*items[i].seg, buf);
+                long pos;
+                if (forward) {
+                    pos = pat.find_from(bytes.data(), bytes.size(), items[i].offset);
+                } else {
+                    pos = pat.rfind_upto(bytes.data(), bytes.size(),
+                                         std::min<long>(items[i].offset, bytes.size()));
+                }
+                if (pos >= 0) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (c < found_chunk) {
+                        found_chunk = c;
+                        found_item  = i;
+                        found_pos   = pos;
+                    }
+                    break;
+                }
+            }
+        }
+    };
+
+    // Current thread works as well; the others use their own copies of pattern
+    std::vector<std::unique_ptr<SearchPattern>> copies;
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        copies.push_back(pattern.clone());
+        pool.emplace_back(worker, std::cref(*copies.back()));
+    }
+    worker(pattern);
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    if (cancel && *cancel)
+        return false;
+    return found_chunk < nchunks;
+}
+
+//
+// Borrow raw bytes of segment from memory when possible,
+// or read them into the buffer.
+//
+std::string_view Workspace::segment_bytes(const Segment &seg, std::string &buf) const
+{
+    return read_bytes(seg.file_descriptor, seg.file_offset, seg.total_byte_count(), buf);
+}
+
+//
+// Borrow raw bytes of file from memory when possible, or read them.
+// Range of temp file may span its written part and the buffered tail.
+//
+std::string_view Workspace::read_bytes(int fd, long offset, long len, std::string &buf) const
+{
+    if (filemap_.covers(fd)) {
+        if (const char *data = filemap_.bytes(offset, len))
+            return std::string_view(data, len);
+    } else if (fd == tempfile_.fd()) {
+        if (const char *data = tempfile_.unflushed_bytes(offset, len))
+            return std::string_view(data, len);
+
+        // Segments joined by merge() may end in the buffer: written head is read
+        long flushed = tempfile_.size() - (long)tempfile_.unflushed_size();
+        if (offset < flushed && offset + len > flushed) {
+            buf.resize(len);
+            long head = flushed - offset;
+            long nread = std::max<long>(0, pread(fd, &buf[0], head, offset));
+            std::fill(buf.begin() + nread, buf.begin() + head, '\n');
+            std::memcpy(&buf[head], tempfile_.unflushed_bytes(flushed, len - head), len - head);
+            return buf;
+        }
+    }
+
+    // Incomplete last line of file gets its newline here
+    buf.assign(len, '\n');
+    if (pread(fd, &buf[0], len, offset) < len) {
+        // Short read: the rest is left blank
+    }
+    return buf;
+}
+
+//
+// Start indexing all matches of the pattern.
+// Segments of the original file are scanned in background; the rest,
+// made by edits, are scanned when the index is used.
+//
+void Workspace::index_matches(const SearchPattern &pattern, const std::string &name)
+{
+    if (match_index_.name() == name)
+        return;
+
+    std::vector<MatchIndex::Key> keys;
+    for (const auto &seg : contents_) {
+        if (seg.file_descriptor >= 0 && seg.file_descriptor == original_fd_) {
+            keys.push_back({ seg.file_descriptor, seg.file_offset, seg.total_byte_count() });
+        }
+    }
+    match_index_.start(pattern, name, std::move(keys),
+                       [this](const MatchIndex::Key &key, std::string &buf) {
+                           return read_bytes(key.fd, key.offset, key.len, buf);
+                       });
+    match_runs_valid_ = false;
+}
+
+//
+// Check whether all matches are indexed.
+//
+bool Workspace::matches_indexed()
+{
+    if (!match_index_.poll())
+        return false;
+    update_match_runs();
+    return match_index_.count() <= MatchIndex::MAX_MATCHES;
+}
+
+//
+// Forget indexed matches in temp file.
+//
+void Workspace::forget_temp_matches()
+{
+    match_index_.forget_file(tempfile_.fd());
+    match_runs_valid_ = false;
+}
+
+//
+// Build list of segments with matches, and count matches before each of them.
+// Indexed segments are only looked up; those made by edits are scanned now.
+//
+void Workspace::update_match_runs()
+{
+    if (match_runs_valid_)
+        return;
+
+    match_runs_.clear();
+    match_total_ = 0;
+    long base    = 0;
+    std::string buf;
+    for (const auto &seg : contents_) {
+        if (seg.file_descriptor >= 0) {
+            MatchIndex::Key key = { seg.file_descriptor, seg.file_offset,
+                                    seg.total_byte_count() };
+            const MatchIndex::Matches *matches = match_index_.find(key);
+            if (!matches) {
+                matches = &match_index_.scan(key, segment_bytes(seg, buf));
+            }
+            if (!matches->empty()) {
+                match_runs_.push_back({ base, match_total_, matches });
+                match_total_ += matches->size();
+            }
+        }
+        base += seg.line_count;
+    }
+    match_runs_valid_ = true;
+}
+
+//
+// Find the last run which starts at or before given line.
+//
+long Workspace::match_run_at(long line) const
+{
+    auto it = std::upper_bound(match_runs_.begin(), match_runs_.end(), line,
+                               [](long l, const MatchRun &run) { return l < run.base; });
+    return (it - match_runs_.begin()) - 1;
+}
+
+//
+// Find the indexed match next to given position, with wrap around.
+//
+bool Workspace::next_match(int &line, int &col, bool forward)
+{
+    if (!matches_indexed() || match_runs_.empty())
+        return false;
+
+    // Look in the segment of the position
+    long index                     = match_run_at(line);
+    const MatchIndex::Match *found = nullptr;
+    long base                      = 0;
+    if (index >= 0) {
+        const MatchRun &run   = match_runs_[index];
+        const auto &matches   = *run.matches;
+        MatchIndex::Match pos = { (unsigned)(line - run.base), (unsigned)std::max(col, 0) };
+        if (forward) {
+            auto it = std::upper_bound(matches.begin(), matches.end(), pos);
+            if (it != matches.end())
+                found = &*it;
+        } else {
+            auto it = std::lower_bound(matches.begin(), matches.end(), pos);
+            if (it != matches.begin())
+                found = &it[-1];
+        }
+        base = run.base;
+    }
+    if (!found) {
+        // First match of the next run, or last match of the previous run
+        if (forward) {
+            index = (index + 1 < (long)match_runs_.size()) ? index + 1 : 0;
+            found = &match_runs_[index].matches->front();
+        } else {
+            index = (index > 0) ? index - 1 : match_runs_.size() - 1;
+            found = &match_runs_[index].matches->back();
+        }
+        base = match_runs_[index].base;
+    }
+    line = base + found->line;
+    col  = found->col;
+    return true;
+}
+
+//
+// Get number of the indexed match at given position.
+//
+bool Workspace::match_rank(int line, int col, long &rank, long &total)
+{
+    if (!matches_indexed())
+        return false;
+
+    long index = match_run_at(line);
+    if (index < 0)
+        return false;
+
+    const MatchRun &run   = match_runs_[index];
+    const auto &matches   = *run.matches;
+    MatchIndex::Match pos = { (unsigned)(line - run.base), (unsigned)col };
+    auto it               = std::lower_bound(matches.begin(), matches.end(), pos);
+    if (col < 0 || it == matches.end() || pos < *it)
+        return false;
+
+    rank  = run.rank + (it - matches.begin()) + 1;
+    total = match_total_;
+    return true;
+}
+
+//
+// Replace matches in lines [first, last).
+// Changed lines of every segment are written to temp file in one batch,
+// when the scan leaves the segment. Their span in the segment is rebuilt
+// from pieces of the old and the new lines, and put in place after the scan
+// by one splice, so segments without matches are not touched at all.
+//
+long Workspace::substitute(const SearchPattern &pattern, const std::string &text, bool global,
+                           long first, long last, long &replaced,
+                           const std::atomic<bool> *cancel)
+{
+    replaced = 0;
+    wait_index(last);
+    last = std::min<long>(last, total_line_count());
+    if (first < 0 || first >= last || change_current_line(first) != 0)
+        return 0;
+
+    struct Change {
+        long line;                   // first line replaced
+        long count;                  // number of lines replaced
+        std::list<Segment> segments; // new lines, and old lines between them
+    };
+    std::vector<Change> changes;
+    std::vector<unsigned> rels;     // changed lines of the segment being scanned
+    std::vector<std::string> lines; // their new contents
+    long changed = 0;
+
+    // Build the span of segment from its first changed line to the last one.
+    auto replace_lines = [&](const Segment &seg, long base) {
+        if (rels.empty())
+            return;
+        std::list<Segment> written = tempfile_.write_lines_to_temp(lines);
+        if (written.empty())
+            throw std::runtime_error("substitute: failed to write lines to temp file");
+
+        Change change{ base + rels.front(), (long)(rels.back() + 1 - rels.front()), {} };
+        const Segment *source = nullptr; // segment of the last piece
+        unsigned next         = 0;       // line of source which extends the last piece
+        auto append = [&](const Segment &from, unsigned line, long offset, long len) {
+            if (&from != source || line != next) {
+                long file_offset = (from.file_descriptor >= 0) ? from.file_offset + offset : 0;
+                change.segments.emplace_back(from.file_descriptor, 0, file_offset);
+                source = &from;
+            }
+            change.segments.back().line_count++;
+            change.segments.back().line_lengths.push_back(len);
+            next = line + 1;
+        };
+
+        auto old_len     = seg.line_lengths.begin();
+        long old_offset  = 0;
+        auto new_seg     = written.begin();
+        auto new_len     = new_seg->line_lengths.begin();
+        unsigned new_rel = 0;
+        long new_offset  = 0;
+        size_t k         = 0;
+        for (unsigned rel = 0; rel <= rels.back(); ++rel, old_offset += *old_len, ++old_len) {
+            if (rel < rels.front())
+                continue;
+            if (rel != rels[k]) {
+                append(seg, rel, old_offset, *old_len);
+                continue;
+            }
+            if (new_rel == new_seg->line_count) {
+                ++new_seg;
+                new_len    = new_seg->line_lengths.begin();
+                new_rel    = 0;
+                new_offset = 0;
+            }
+            append(*new_seg, new_rel, new_offset, *new_len);
+            new_offset += *new_len;
+            ++new_len;
+            ++new_rel;
+            ++k;
+        }
+        changed += rels.size();
+        changes.push_back(std::move(change));
+        rels.clear();
+        lines.clear();
+    };
+
+    // Blank lines are changed only by a pattern which matches an empty line
+    const bool match_blank = pattern.find_from("\n", 1, 0) == 0;
+
+    std::string buf;
+    long base = current_segment_base_line();
+    for (auto it = cursegm_; it != contents_.end() && base < last; base += it->line_count, ++it) {
+        if (cancel && *cancel)
+            return 0;
+
+        const Segment &seg = *it;
+        long from_line     = std::max(first, base) - base;
+        long to_line       = std::min<long>(last - base, seg.line_count);
+        if (seg.file_descriptor < 0) {
+            for (long rel = from_line; match_blank && rel < to_line; ++rel) {
+                rels.push_back(rel);
+                lines.push_back(text);
+                replaced++;
+            }
+            replace_lines(seg, base);
+            continue;
+        }
+
+        std::string_view bytes = segment_bytes(seg, buf);
+        const char *data       = bytes.data();
+        const long end         = seg.line_lengths.offset_of(to_line);
+
+        // Matches start before the end of the last line in range
+        auto find = [&](long from) {
+            long pos = (from < end) ? pattern.find_from(data, end, from) : -1;
+            return (pos < end) ? pos : -1;
+        };
+        long pos = find(seg.line_lengths.offset_of(from_line));
+        while (pos >= 0) {
+            size_t rel      = seg.line_lengths.line_at(pos);
+            long line_start = seg.line_lengths.offset_of(rel);
+            long line_end   = line_start + seg.line_lengths[rel] - 1; // at newline
+            std::string line;
+            long copied = line_start;
+            long after  = -1; // end of the last match
+            while (pos >= 0 && pos <= line_end) {
+                // Empty match right after the previous one is skipped
+                long match_end = pattern.match_end(data, end, pos);
+                if (match_end > pos || pos != after) {
+                    line.append(data + copied, pos - copied);
+                    line += text;
+                    copied = after = match_end;
+                    replaced++;
+                    if (!global) {
+                        pos = find(line_end + 1);
+                        break;
+                    }
+                }
+                pos = find(match_end > pos ? match_end : pos + 1);
+            }
+            line.append(data + copied, line_end - copied);
+            rels.push_back(rel);
+            lines.push_back(std::move(line));
+        }
+        replace_lines(seg, base);
+    }
+    if (cancel && *cancel)
+        return 0;
+
+    // New spans take place of the old ones; all the rest stays
+    for (Change &change : changes) {
+        auto stop           = segment_at(change.line + change.count);
+        auto start          = segment_at(change.line);
+        SegmentTree removed = contents_.extract(start, stop);
+        contents_.splice(segment_at(change.line), change.segments);
+        record_change(change.line, change.count, std::move(removed));
+    }
+    if (changed > 0)
+        file_state.modified = true;
+
+    // Current segment might have been moved out
+    cursegm_ = contents_.end();
+    change_current_line(first);
+    return changed;
+}
+
+//
+// Add lines to the damaged range, and drop them from line cache.
+//
+void Workspace::mark_damaged(long first, long last)
+{
+    // Counts of matches before and after the change are rebuilt
+    match_runs_valid_ = false;
+
+    // Changed lines, and lines which moved, are read again
+    for (auto it = cached_lines_.begin(); it != cached_lines_.end();) {
+        if (it->line_no >= first && it->line_no < last) {
+            cached_index_.erase(it->line_no);
+            it = cached_lines_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (damage_first_ >= damage_last_) {
+        damage_first_ = first;
+        damage_last_  = last;
+    } else {
+        damage_first_ = std::min(damage_first_, first);
+        damage_last_  = std::max(damage_last_, last);
+    }
+}
+
+//
+// Take the range of changed lines, and start over.
+//
+bool Workspace::take_damage(long &first, long &last)
+{
+    if (damage_first_ >= damage_last_)
+        return false;
+
+    first         = damage_first_;
+    last          = damage_last_;
+    damage_first_ = 0;
+    damage_last_  = 0;
+    return true;
+}
+
+//
+// Append pointers to all segments with data in the given file.
+//
+void Workspace::find_segments(int fd, std::vector<Segment *> &result)
+{
+    for (auto &seg : contents_) {
+        if (seg.file_descriptor == fd) {
+            result.push_back(&seg);
+        }
+    }
+
+    // Undo history refers to the same files
+    for (auto *steps : { &undo_steps_, &redo_steps_ }) {
+        for (auto &step : *steps) {
+            for (auto &seg : step.removed) {
+                if (seg.file_descriptor == fd) {
+                    result.push_back(&seg);
+                }
+            }
+        }
+    }
+}
+
 //
 // Debug routine: print all fields and segment chain.
 //
@@ -862,6 +1871,9 @@ void Workspace::debug_print(std::ostream &out) const
     out << "Workspace line=" << position.line
         << ", modified=" << (file_state.modified ? "true" : "false")
         << ", writable=" << file_state.writable << ", original_fd=" << original_fd_ << "\n";
+    out << "Line cache " << cached_lines_.size() << "/" << cache_capacity_
+        << ", hits=" << cache_hits_ << ", misses=" << cache_misses_
+        << ", evictions=" << cache_evictions_ << "\n";
 
     // Print segment chain
     int seg_idx = 0;
@@ -1,16 +1,28 @@
 #ifndef WORKSPACE_H
 #define WORKSPACE_H
 
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <list>
+#include <mutex>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "filemap.h"
+#include "match_index.h"
 #include "segment.h"
+#include "segment_tree.h"
 
 // Forward declaration
 class Tempfile;
+class SearchPattern;
 
 //
 // View-related state (display and cursor position)
@@ -60,6 +72,41 @@ public:
     // File descriptor is inherited, and closed in destructor
     void load_file(int fd);
 
+    // Build list of segments from file descriptor, like load_file().
+    // Only the beginning of a large file is indexed at once; the rest
+    // is indexed on a background thread, and appended by poll_index().
+    void load_file_in_background(int fd);
+
+    // Set number of threads for indexing of large files; 0 means one per core
+    void set_index_threads(unsigned threads) { index_threads_ = threads; }
+
+    // Check whether background indexing is still in progress.
+    bool is_indexing() const { return indexing_; }
+
+    // Append segments indexed in background so far.
+    // Returns true when any lines were added.
+    bool poll_index();
+
+    // Wait until the given line is indexed, or the whole file is.
+    void wait_index(long line_no);
+
+    // Wait until the whole file is indexed.
+    void finish_indexing() { wait_index(LONG_MAX); }
+
+    // Check whether the line is indexed already, without waiting.
+    // Lines past the end of file count as indexed when indexing is done.
+    bool is_indexed(long line_no) const
+    {
+        return !indexing_ || line_no < contents_.total_lines();
+    }
+
+    // Check whether the line exists, waiting for background indexing when needed.
+    bool has_line(long line_no)
+    {
+        wait_index(line_no);
+        return line_no >= 0 && line_no < contents_.total_lines();
+    }
+
     // Build list of segments from in-memory lines vector
     void load_text(const std::vector<std::string> &lines);
 
@@ -69,21 +116,85 @@ public:
     // Write segment list content to file
     bool write_file(const std::string &path);
 
+    // Start writing segment list content to file on a background thread.
+    // The list is captured as ranges of original and temp file bytes, which
+    // never change, so editing may continue. Previous save is waited for.
+    void start_save(const std::string &path);
+
+    // Check whether background save is in progress.
+    bool is_saving() const { return saving_; }
+
+    // Path of the file being saved in background.
+    const std::string &save_path() const { return save_path_; }
+
+    // Bytes written by background save so far, and bytes in total.
+    long save_progress() const { return save_written_; }
+    long save_size() const { return save_size_; }
+
+    // Finish background save when its thread is done, and set ok to the result.
+    // Returns false when no save was completed.
+    bool poll_save(bool &ok);
+
+    // Wait for background save to finish. Returns its result, or true when none.
+    bool wait_save();
+
     // Compute total line count of all segments.
+    // Taken from the cached total in the root of segment tree, O(1).
+    // While indexing in background, only lines indexed so far are counted.
     int total_line_count() const;
 
-    // Read line content from segment list at specified index
+    // Read line content from segment list at specified index.
+    // Unmodified lines of a regular file come from the memory mapping.
     std::string read_line(int line_no);
 
+    // Borrow line content without copying: the view points into the memory mapping,
+    // the unwritten tail of temp file, or a scratch buffer of the workspace.
+    // It stays valid until the next read or modification of this workspace.
+    std::string_view read_line_view(int line_no);
+
+    // Lines read from file are kept in a cache of limited size, least recently
+    // used are evicted. Changed lines are dropped from it. Lines in memory
+    // mapping or in unwritten tail of temp file are never read, so not cached.
+    struct LineCacheStats {
+        unsigned long hits;      // lines found in cache
+        unsigned long misses;    // lines read from file
+        unsigned long evictions; // lines dropped to make room
+        size_t size;             // lines in cache
+        size_t capacity;         // maximum lines in cache
+    };
+    LineCacheStats line_cache_stats() const;
+
+    // Set maximum number of lines in cache; 0 disables it.
+    void set_line_cache_capacity(size_t lines);
+
+    // Default size of line cache.
+    static constexpr size_t LINE_CACHE_LINES = 1024;
+
+    // Find location of line bytes: file descriptor and offset.
+    // Returns false for blank lines and lines beyond end of file.
+    bool locate_line(int line_no, int &fd, long &offset);
+
+    // Incremented whenever the contents are discarded and the original
+    // file is closed, so that its descriptor may be reused.
+    unsigned generation() const { return generation_; }
+
     // Change cursegm_ to the segment containing the specified line
     // Also updates line_ to position the workspace at line number
-    // Throws std::runtime_error for invalid line numbers or corrupted contents
+    // Throws std::runtime_error for invalid line numbers
     int change_current_line(int lno);
 
     // Compute the line number of the first line in the current segment
-    // by walking backwards from cursegm_ and summing line counts
+    // by walking up the segment tree from cursegm_, O(log n)
     int current_segment_base_line() const;
 
+    // Compute byte offset of the first character of the given line, O(log n).
+    // Line numbers past the end map to the total byte count.
+    long line_to_offset(int line_no) const;
+
+    // Find the line containing the given byte offset, O(log n).
+    // Offsets past the end map to the total line count.
+    int offset_to_line(long offset) const;
+
     // Clean up segment list
     void cleanup_contents();
 
@@ -91,8 +202,8 @@ public:
     void reset();
 
     // Access to segments list for internal operations
-    std::list<Segment> &get_contents() { return contents_; }
-    const std::list<Segment> &get_contents() const { return contents_; }
+    SegmentTree &get_contents() { return contents_; }
+    const SegmentTree &get_contents() const { return contents_; }
 
     // Direct iterator access for segment manipulation
     Segment::iterator cursegm() { return cursegm_; }
@@ -120,6 +231,97 @@ public:
     // Create segments for n empty lines (blanklines from prototype)
     static std::list<Segment> create_blank_lines(int n);
 
+    //
+    // Undo history
+    //
+
+    // Begin a new undo group: changes made until the next checkpoint
+    // are undone and redone together.
+    void undo_checkpoint() { undo_joined_ = false; }
+
+    // Revert the last group of changes.
+    // Returns the first changed line, or -1 when there is nothing to undo.
+    int undo();
+
+    // Apply again the last reverted group of changes.
+    // Returns the first changed line, or -1 when there is nothing to redo.
+    int redo();
+
+    // Forget all changes, so that temp file data of old lines can be reclaimed.
+    void clear_undo();
+
+    // Number of changes which can be undone or redone.
+    size_t undo_depth() const { return undo_steps_.size(); }
+    size_t redo_depth() const { return redo_steps_.size(); }
+
+    // Maximum number of changes kept in undo history.
+    static constexpr size_t MAX_UNDO_STEPS = 10000;
+
+    //
+    // Search
+    //
+
+    // Find the first match which starts at or after given position, up to end of file.
+    // With wrap, the search continues from start of file up to the position.
+    // Raw bytes of segments are scanned, a whole segment at a time; large
+    // ranges are split into chunks, which are searched on worker threads.
+    // Stops early and returns false when cancel is set.
+    // On success, sets line and col to the start of the match.
+    bool find_forward(const SearchPattern &pattern, int &line, int &col, bool wrap = false,
+                      const std::atomic<bool> *cancel = nullptr);
+
+    // Find the last match which starts at or before given position.
+    // With wrap, the search continues from end of file down to the position.
+    // Segments are scanned in reverse order, each from its end.
+    bool find_backward(const SearchPattern &pattern, int &line, int &col, bool wrap = false,
+                       const std::atomic<bool> *cancel = nullptr);
+
+    // Set number of threads for search; 0 means one per core.
+    void set_search_threads(unsigned threads) { search_threads_ = threads; }
+
+    // Start indexing all matches of the pattern in background, unless matches
+    // of a pattern with the same name are indexed already. The index survives
+    // edits: only changed segments are searched again.
+    void index_matches(const SearchPattern &pattern, const std::string &name);
+
+    // Check whether all matches are indexed, so that next_match() and match_rank()
+    // can be used. Takes results of the background thread.
+    bool matches_indexed();
+
+    // Find the first indexed match after given position (or the last one before it,
+    // when searching backward), wrapping around. Returns false when there are none.
+    bool next_match(int &line, int &col, bool forward);
+
+    // Get number of the indexed match at given position, from 1, and the total number
+    // of matches. Returns false when no match starts there.
+    bool match_rank(int line, int col, long &rank, long &total);
+
+    // Forget indexed matches in temp file, after it was compacted.
+    void forget_temp_matches();
+
+    // Replace matches of the pattern in lines [first, last) by the text: the first
+    // match in every line, or all of them when global. Segments are scanned as raw
+    // bytes, and those without matches are left alone. Changed lines are written
+    // to temp file during the scan, one batch per segment, and then replace the old
+    // lines by one splice per segment. Nothing is changed when cancel is set before
+    // the scan ends.
+    // Returns the number of changed lines, and sets replaced to the number of matches.
+    long substitute(const SearchPattern &pattern, const std::string &text, bool global,
+                    long first, long last, long &replaced,
+                    const std::atomic<bool> *cancel = nullptr);
+
+    // Search is split into chunks of about this size.
+    static constexpr long SEARCH_CHUNK_SIZE = 16L * 1024 * 1024;
+
+    //
+    // Damage tracking for display
+    //
+
+    // Take the range of lines [first, last) changed since the previous call,
+    // and start over. Returns false when nothing has changed. When the number
+    // of lines has changed, the range extends to the end of file (last is LONG_MAX).
+    bool take_damage(long &first, long &last);
+
     //
     // View management methods (from prototype)
     //
@@ -139,13 +341,88 @@ public:
     // Update topline when file changes (used by wksp_redraw)
     void update_topline_after_edit(int from, int to, int delta);
 
+    // Append pointers to all segments with data in the given file.
+    // Used by temp file compaction to rewrite segment offsets.
+    void find_segments(int fd, std::vector<Segment *> &result);
+
     // Debug routine: print all fields and segment list
     void debug_print(std::ostream &out) const;
 
 private:
-    // Helper for load_file: parse a single line from buffered input
-    // Returns line length including newline, or 0 on EOF
-    int parse_line_from_buffer(char *read_buf, int &buf_count, int &buf_next, int fd);
+    // Change of the segment chain: lines [line, line + count) took place
+    // of the lines held in removed. Swapping them back and forth implements
+    // undo and redo. Only segments are kept, never the text itself.
+    struct UndoStep {
+        long line;           // first changed line
+        long count;          // number of lines in place of removed ones
+        SegmentTree removed; // segments of replaced lines
+        bool joined;         // undone together with the previous step
+    };
+
+    // Add change to undo history, and forget changes which were undone.
+    void record_change(long line, long count, SegmentTree &&removed);
+
+    // Exchange lines of the chain with lines saved in the step.
+    void swap_lines(UndoStep &step);
+
+    // Make a segment start at the given line, and return it (end() past the last line).
+    Segment::iterator segment_at(long line);
+
+    // Add lines [first, last) to the damaged range, and drop them from line cache.
+    void mark_damaged(long first, long last = LONG_MAX);
+
+    // Borrow raw bytes of segment, with newlines.
+    // Bytes which are not in memory are read into the buffer.
+    // Safe to call from several threads at once.
+    std::string_view segment_bytes(const Segment &seg, std::string &buf) const;
+    std::string_view read_bytes(int fd, long offset, long len, std::string &buf) const;
+
+    // Segments with indexed matches, in file order
+    struct MatchRun {
+        long base;                          // first line of segment
+        long rank;                          // number of matches before the segment
+        const MatchIndex::Matches *matches; // matches in the segment
+    };
+
+    // Build list of segments with matches, when contents changed.
+    void update_match_runs();
+
+    // Find the run which has matches at or before given line, or -1 when none.
+    long match_run_at(long line) const;
+
+    // Segment to search, with the first line number and the offset to start from.
+    struct SearchItem {
+        const Segment *seg;
+        long base;
+        long offset;
+    };
+
+    // Search segments in the given order, by worker threads, and find the first match.
+    // On success, sets index of the segment and offset of the match in it.
+    bool search_items(const std::vector<SearchItem> &items, const SearchPattern &pattern,
+                      bool forward, const std::atomic<bool> *cancel, size_t &found_item,
+                      long &found_pos) const;
+
+    // Add line to cache, reusing the least recently used entry when full.
+    std::string_view cache_line(long line_no, std::string_view text);
+
+    // Range of bytes to save: from file, or blank lines when fd is -1.
+    struct SaveRange {
+        int fd;
+        long offset;
+        long length;
+    };
+
+    // Stop background indexing and discard its results.
+    void stop_indexing();
+
+    // Capture segment list as ranges to save, with trailing blank lines skipped.
+    std::vector<SaveRange> save_ranges() const;
+
+    // Write ranges to file, adding number of bytes written to progress.
+    // Returns false when the file cannot be created or written, like on a full disk.
+    static bool write_ranges(const std::string &path, const std::vector<SaveRange> &ranges,
+                             std::atomic<long> &progress);
 
     // Helper for split: handle empty workspace case
     int split_empty_workspace(int line_no);
@@ -172,10 +449,61 @@ private:
     // Helper for put_line: isolate a single line into its own segment
     void isolate_line(int line_no);
 
-    std::list<Segment> contents_; // list of segments
-    Segment::iterator cursegm_;   // current segment iterator (points into contents_)
-    Tempfile &tempfile_;          // reference to temp file manager
-    int original_fd_{ -1 };       // file descriptor for original file
+    SegmentTree contents_;         // sequence of segments
+    Segment::iterator cursegm_;    // current segment iterator (points into contents_)
+    Tempfile &tempfile_;           // reference to temp file manager
+    int original_fd_{ -1 };        // file descriptor for original file
+    Filemap filemap_;              // memory mapping of original file
+    std::string line_buf_;         // scratch buffer for read_line_view()
+    unsigned index_threads_{ 0 };  // threads for load_file(), 0 for default
+    unsigned search_threads_{ 0 }; // threads for find_forward/backward(), 0 for default
+    unsigned generation_{ 0 };     // number of times contents were discarded
+
+    // Index of matches
+    MatchIndex match_index_;           // matches by segment
+    std::vector<MatchRun> match_runs_; // segments with matches, in order
+    bool match_runs_valid_{ false };   // match_runs_ are up to date
+    long match_total_{ 0 };            // number of matches in file
+
+    // Line cache, most recently used first
+    struct CachedLine {
+        long line_no;
+        std::string text;
+    };
+    std::list<CachedLine> cached_lines_;
+    std::unordered_map<long, std::list<CachedLine>::iterator> cached_index_;
+    size_t cache_capacity_{ LINE_CACHE_LINES };
+    unsigned long cache_hits_{ 0 };
+    unsigned long cache_misses_{ 0 };
+    unsigned long cache_evictions_{ 0 };
+
+    // Background indexing
+    std::thread index_thread_;                // thread of load_file_in_background()
+    std::mutex index_mutex_;                  // protects index_pending_ and index_done_
+    std::condition_variable index_cv_;        // signalled when more segments are indexed
+    std::list<Segment> index_pending_;        // indexed segments, not yet in contents_
+    bool index_done_{ false };                // background thread has finished
+    bool indexing_{ false };                  // index_pending_ may get more segments
+    std::atomic<bool> index_cancel_{ false }; // request to stop background thread
+
+    // Undo history
+    std::deque<UndoStep> undo_steps_; // changes to revert, the last one at back
+    std::deque<UndoStep> redo_steps_; // reverted changes, the last one at back
+    bool undo_joined_{ false };       // next change joins the current group
+    size_t undo_group_size_{ 0 };     // steps in the current group
+
+    // Lines changed since take_damage(); new workspace is damaged as a whole
+    long damage_first_{ 0 };       // first changed line
+    long damage_last_{ LONG_MAX }; // after the last changed line, or LONG_MAX
+
+    // Background save
+    std::thread save_thread_;                  // thread of start_save()
+    std::string save_path_;                    // file being saved
+    std::atomic<long> save_written_{ 0 };      // bytes written so far
+    long save_size_{ 0 };                      // bytes to write
+    std::atomic<bool> save_finished_{ false }; // thread has finished, save_result_ is set
+    bool save_result_{ false };                // save succeeded
+    bool saving_{ false };                     // save_thread_ is running or not joined yet
 };
 
 #endif // WORKSPACE_H